@@ -0,0 +1,38 @@
+/*
+ * bench_alloc.h — Heap allocation counter for the benchmarks (glibc)
+ *
+ * Include from exactly one file of a benchmark: it replaces malloc,
+ * calloc and realloc with versions counting calls in n_allocs.
+ */
+
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include <glib.h>
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t m);
+extern void *__libc_realloc(void *p, size_t n);
+
+static volatile gsize n_allocs = 0;
+
+void *malloc(size_t n)
+{
+    n_allocs++;
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t m)
+{
+    n_allocs++;
+    return __libc_calloc(n, m);
+}
+
+void *realloc(void *p, size_t n)
+{
+    n_allocs++;
+    return __libc_realloc(p, n);
+}
+
+#endif /* BENCH_ALLOC_H */
@@ -0,0 +1,224 @@
+/*
+ * bench_decode.c — Allocations and time per streamed token
+ *
+ * Feeds a synthetic Ollama JSON-lines stream through the old decode path
+ * (line buffer + strstr + GString per token + UI copy) and through the
+ * current one (framing + json_stream + accumulator + UI byte ring drained
+ * like the per-frame tick), counting heap allocations with a glibc malloc
+ * interposer.
+ *
+ * Build and run: make bench
+ */
+
+#include "framing.h"
+#include "json_stream.h"
+#include "byte_ring.h"
+#include "reply.h"
+#include "bench_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_TOKENS 200000
+
+/* --- Input --------------------------------------------------------------- */
+
+static GPtrArray* make_lines(void)
+{
+    static const char *words[] = {
+        "The", " quick", " brown", " fox", " jumps", " over", " the",
+        " lazy", " dog", "."
+    };
+    GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+    for (int i = 0; i < N_TOKENS; i++)
+    {
+        /* One token in ten carries an escape, as code and prose do */
+        const char *tok = words[i % 10];
+        if (i % 10 == 9)
+            tok = (i % 20 == 9) ? "\\n" : "\\\"x\\\"";
+        g_ptr_array_add(lines, g_strdup_printf(
+            "{\"model\":\"llama3\",\"created_at\":\"2025-09-12T10:00:00Z\","
+            "\"message\":{\"role\":\"assistant\",\"content\":\"%s\"},"
+            "\"done\":false}\n", tok));
+    }
+    return lines;
+}
+
+/* --- Previous path ------------------------------------------------------- */
+
+typedef struct
+{
+    GString *carry;
+    GString *accum;
+} OldReq;
+
+static void old_unescape_append(GString *dst, const char *s, const char *e)
+{
+    while (s < e)
+    {
+        if (*s != '\\') { g_string_append_c(dst, *s++); continue; }
+        if (++s >= e) break;
+        switch (*s)
+        {
+            case 'n': g_string_append_c(dst, '\n'); break;
+            case 't': g_string_append_c(dst, '\t'); break;
+            default:  g_string_append_c(dst, *s);   break;
+        }
+        s++;
+    }
+}
+
+static void old_extract(OldReq *req, const char *line, size_t len)
+{
+    const char *c = strstr(line, "\"content\"");
+    if (!c || c >= line + len) return;
+    c = strchr(c, ':');
+    if (!c) return;
+    c++;
+    while (c < line + len && *c == ' ') c++;
+    if (c >= line + len || *c != '"') return;
+    c++;
+    const char *p = c;
+    while (p < line + len && !(*p == '"' && *(p - 1) != '\\'))
+        p++;
+
+    GString *dec = g_string_new(NULL);
+    old_unescape_append(dec, c, p);
+    g_string_append_len(req->accum, dec->str, (gssize)dec->len);
+    g_free(g_strndup(dec->str, dec->len));   /* ui_stream_append copy */
+    g_string_free(dec, TRUE);
+}
+
+static void old_feed(OldReq *req, const char *data, size_t len)
+{
+    g_string_append_len(req->carry, data, (gssize)len);
+    for (;;)
+    {
+        char *nl = memchr(req->carry->str, '\n', req->carry->len);
+        if (!nl) break;
+        size_t linelen = (size_t)(nl - req->carry->str);
+        if (linelen > 0)
+            old_extract(req, req->carry->str, linelen);
+        g_string_erase(req->carry, 0, (gssize)linelen + 1);
+    }
+}
+
+/* --- Current path -------------------------------------------------------- */
+
+typedef struct
+{
+    Framer      framer;
+    JsonStream *parser;
+    GString    *accum;
+    gsize       pushed;
+    ByteRing   *ring;
+    GString    *view;     /* Stands in for the GtkTextBuffer */
+} NewReq;
+
+static void new_chunk(gpointer ud, gint field, const gchar *text, gsize len)
+{
+    NewReq *req = (NewReq *)ud;
+    (void)field;
+    g_string_append_len(req->accum, text, (gssize)len);
+}
+
+static void new_line(gpointer ud, const gchar *line, gsize len)
+{
+    NewReq *req = (NewReq *)ud;
+    json_stream_reset(req->parser);
+    json_stream_feed(req->parser, line, len);
+}
+
+static void new_feed(NewReq *req, const char *data, size_t len)
+{
+    framer_feed_lines(&req->framer, data, len, new_line, req);
+    req->pushed += byte_ring_write(req->ring, req->accum->str + req->pushed,
+                                   req->accum->len - req->pushed);
+
+    /* Frame tick: the view takes everything at once */
+    g_string_truncate(req->view, 0);
+    byte_ring_read_all(req->ring, req->view);
+}
+
+/* --- Driver -------------------------------------------------------------- */
+
+static void report(const char *name, gsize allocs, gint64 us, gsize out_len)
+{
+    printf("  %-7s %8.3f allocs/token  %7.1f ns/token  (%zu bytes out)\n",
+           name, (double)allocs / N_TOKENS, us * 1000.0 / N_TOKENS, out_len);
+}
+
+/* Feed @input in slices of @chunk bytes (0: one line per slice) */
+static int run(GPtrArray *lines, const GString *input, gsize chunk)
+{
+    gsize a0;
+    gint64 t0;
+    int rc = 0;
+
+    if (chunk)
+        printf("bench_decode: %d tokens in %zu byte chunks\n", N_TOKENS, chunk);
+    else
+        printf("bench_decode: %d tokens, one JSON line per chunk\n", N_TOKENS);
+
+    OldReq old = { g_string_new(NULL), g_string_new(NULL) };
+    a0 = n_allocs;
+    t0 = g_get_monotonic_time();
+    if (chunk)
+        for (gsize off = 0; off < input->len; off += chunk)
+            old_feed(&old, input->str + off, MIN(chunk, input->len - off));
+    else
+        for (guint i = 0; i < lines->len; i++)
+        {
+            const char *l = g_ptr_array_index(lines, i);
+            old_feed(&old, l, strlen(l));
+        }
+    report("before", n_allocs - a0, g_get_monotonic_time() - t0, old.accum->len);
+
+    NewReq cur = { { NULL, NULL, FALSE }, NULL, g_string_sized_new(4096), 0,
+                   byte_ring_new(256 * 1024), g_string_sized_new(256 * 1024) };
+    cur.parser = json_stream_new(new_chunk, NULL, &cur);
+    reply_watch(cur.parser, TRUE);
+    a0 = n_allocs;
+    t0 = g_get_monotonic_time();
+    if (chunk)
+        for (gsize off = 0; off < input->len; off += chunk)
+            new_feed(&cur, input->str + off, MIN(chunk, input->len - off));
+    else
+        for (guint i = 0; i < lines->len; i++)
+        {
+            const char *l = g_ptr_array_index(lines, i);
+            new_feed(&cur, l, strlen(l));
+        }
+    report("after", n_allocs - a0, g_get_monotonic_time() - t0, cur.accum->len);
+
+    if (old.accum->len != cur.accum->len ||
+        memcmp(old.accum->str, cur.accum->str, old.accum->len) != 0)
+    {
+        printf("  output mismatch\n");
+        rc = 1;
+    }
+
+    json_stream_free(cur.parser);
+    framer_clear(&cur.framer);
+    g_string_free(cur.accum, TRUE);
+    byte_ring_unref(cur.ring);
+    g_string_free(cur.view, TRUE);
+    g_string_free(old.carry, TRUE);
+    g_string_free(old.accum, TRUE);
+    return rc;
+}
+
+int main(void)
+{
+    GPtrArray *lines = make_lines();
+    GString *input = g_string_new(NULL);
+    for (guint i = 0; i < lines->len; i++)
+        g_string_append(input, g_ptr_array_index(lines, i));
+
+    int rc = run(lines, input, 0);
+    rc |= run(lines, input, 16384);
+
+    g_string_free(input, TRUE);
+    g_ptr_array_free(lines, TRUE);
+    return rc;
+}
@@ -0,0 +1,169 @@
+/*
+ * bench_escape.c — JSON escape / unescape throughput
+ *
+ * Escapes a source-code-like and a prose-like buffer with the previous
+ * byte-at-a-time json_escape() and with json_escape_append(), then decodes
+ * the result back through json_stream (the path streamed replies take)
+ * and through the previous byte-wise unescape loop. The round trip is
+ * checked against the input.
+ *
+ * Build and run: make bench (bench_escape_scalar forces the scalar kernel)
+ */
+
+#include "json_stream.h"
+#include "json_text.h"
+#include <stdio.h>
+#include <string.h>
+
+#define INPUT_SIZE  (4 * 1024 * 1024)
+#define ROUNDS      8
+
+/* --- Input --------------------------------------------------------------- */
+
+static GString* make_input(gboolean code)
+{
+    static const char *code_text =
+        "static int parse(const char *s)\n{\n"
+        "\tif (*s == '\"' || *s == '\\\\')\n"
+        "\t\treturn printf(\"quote: %s\\n\", s);\n"
+        "\treturn 0;\r\n}\n\n";
+    static const char *prose_text =
+        "Streaming keeps the editor responsive while a long answer is "
+        "generated; the text is appended as it arrives and rendered once "
+        "complete, with code blocks highlighted per language.\n";
+    const char *unit = code ? code_text : prose_text;
+    GString *s = g_string_sized_new(INPUT_SIZE + 256);
+    while (s->len < INPUT_SIZE)
+        g_string_append(s, unit);
+    return s;
+}
+
+/* --- Previous implementations -------------------------------------------- */
+
+static gchar* old_json_escape(const gchar *s)
+{
+    GString *g = g_string_new("");
+    for (const gchar *p = s; *p; ++p)
+    {
+        if (*p == '\\' || *p == '\"') g_string_append_c(g, '\\');
+        if (*p == '\n') g_string_append(g, "\\n");
+        else if (*p == '\r') g_string_append(g, "\\r");
+        else g_string_append_c(g, *p);
+    }
+    return g_string_free(g, FALSE);
+}
+
+static void old_unescape_append(GString *dst, const char *s, const char *e)
+{
+    while (s < e)
+    {
+        if (*s != '\\') { g_string_append_c(dst, *s++); continue; }
+        if (++s >= e) break;
+        switch (*s)
+        {
+            case 'n': g_string_append_c(dst, '\n'); break;
+            case 'r': g_string_append_c(dst, '\r'); break;
+            case 't': g_string_append_c(dst, '\t'); break;
+            case 'b': g_string_append_c(dst, '\b'); break;
+            case 'f': g_string_append_c(dst, '\f'); break;
+            default:  g_string_append_c(dst, *s);   break;
+        }
+        s++;
+    }
+}
+
+/* --- Decode through the tokenizer ---------------------------------------- */
+
+static void on_chunk(gpointer ud, gint field, const gchar *text, gsize len)
+{
+    (void)field;
+    g_string_append_len((GString *)ud, text, (gssize)len);
+}
+
+static void stream_decode(GString *out, const GString *escaped)
+{
+    JsonStream *js = json_stream_new(on_chunk, NULL, out);
+    json_stream_watch(js, "content", 0, TRUE);
+    json_stream_feed(js, "{\"content\":\"", 12);
+    for (gsize off = 0; off < escaped->len; off += 16384)
+        json_stream_feed(js, escaped->str + off, MIN(16384, escaped->len - off));
+    json_stream_feed(js, "\"}", 2);
+    json_stream_free(js);
+}
+
+/* --- Driver -------------------------------------------------------------- */
+
+static double mb_per_s(gsize bytes, gint64 us)
+{
+    return us > 0 ? (double)bytes * ROUNDS / us : 0.0;
+}
+
+static int run(const char *name, gboolean code)
+{
+    GString *in = make_input(code);
+    GString *esc = g_string_sized_new(in->len * 2);
+    GString *dec = g_string_sized_new(in->len);
+    gint64 t0, t_old_esc, t_new_esc, t_old_dec, t_new_dec;
+    int rc = 0;
+
+    t0 = g_get_monotonic_time();
+    for (int r = 0; r < ROUNDS; r++)
+        g_free(old_json_escape(in->str));
+    t_old_esc = g_get_monotonic_time() - t0;
+
+    t0 = g_get_monotonic_time();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        g_string_truncate(esc, 0);
+        json_escape_append(esc, in->str, (gssize)in->len);
+    }
+    t_new_esc = g_get_monotonic_time() - t0;
+
+    t0 = g_get_monotonic_time();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        g_string_truncate(dec, 0);
+        old_unescape_append(dec, esc->str, esc->str + esc->len);
+    }
+    t_old_dec = g_get_monotonic_time() - t0;
+
+    t0 = g_get_monotonic_time();
+    for (int r = 0; r < ROUNDS; r++)
+    {
+        g_string_truncate(dec, 0);
+        stream_decode(dec, esc);
+    }
+    t_new_dec = g_get_monotonic_time() - t0;
+
+    printf("  %-6s escape   %8.1f -> %8.1f MB/s\n", name,
+           mb_per_s(in->len, t_old_esc), mb_per_s(in->len, t_new_esc));
+    printf("  %-6s unescape %8.1f -> %8.1f MB/s\n", name,
+           mb_per_s(esc->len, t_old_dec), mb_per_s(esc->len, t_new_dec));
+
+    if (dec->len != in->len || memcmp(dec->str, in->str, in->len) != 0)
+    {
+        printf("  %s: round trip mismatch\n", name);
+        rc = 1;
+    }
+    for (gsize i = 0; i < esc->len; i++)
+        if ((guchar)esc->str[i] < 0x20)
+        {
+            printf("  %s: unescaped control byte at %zu\n", name, i);
+            rc = 1;
+            break;
+        }
+
+    g_string_free(in, TRUE);
+    g_string_free(esc, TRUE);
+    g_string_free(dec, TRUE);
+    return rc;
+}
+
+int main(void)
+{
+    printf("bench_escape: %d MiB x %d rounds, kernel %s (before -> after)\n",
+           INPUT_SIZE / (1024 * 1024), ROUNDS, json_text_kernel());
+    int rc = run("code", TRUE);
+    rc |= run("prose", FALSE);
+    return rc;
+}
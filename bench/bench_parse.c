@@ -0,0 +1,476 @@
+/*
+ * bench_parse.c — Throughput of the response parsers
+ *
+ * Runs Ollama JSON-lines, OpenAI SSE and whole-body corpora through the
+ * decode path of network.c (framer, json_stream with the same watches,
+ * reply accumulator) under several chunkings, and reports MB/s, tokens/s
+ * and heap allocations per token. The adversarial chunkings cut right
+ * after every backslash, inside every multi-byte UTF-8 sequence and
+ * between the halves of every surrogate pair. Every run must rebuild the
+ * reply exactly.
+ *
+ * Recorded streams may be given as arguments: a file starting with '{'
+ * is read as JSON lines, anything else as SSE. Their reference output is
+ * that of the one-piece run.
+ *
+ * Build and run: make bench
+ * Gate:  bench/bench_parse --min-mbps 200 --max-allocs 0.1 [file...]
+ */
+
+#include "framing.h"
+#include "json_stream.h"
+#include "reply.h"
+#include "bench_alloc.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define N_TOKENS 100000
+#define REPEAT_US 200000   /* Repeat each run for at least this long */
+
+/* --- Corpora ------------------------------------------------------------- */
+
+typedef enum { FMT_LINES, FMT_SSE, FMT_BODY } Format;
+
+typedef struct
+{
+    gchar   *name;
+    Format   fmt;
+    gboolean ollama;
+    GString *input;
+    GString *expect;   /* NULL: take the one-piece run as reference */
+    guint    tokens;   /* Documents carrying content */
+} Corpus;
+
+/* A token as sent (JSON-escaped) and as it must come out */
+typedef struct
+{
+    const char *json;
+    const char *text;
+} Token;
+
+static const Token tokens[] = {
+    { "The", "The" }, { " quick", " quick" }, { " brown", " brown" },
+    { " fox", " fox" }, { "\\n", "\n" }, { " \\\"quoted\\\"", " \"quoted\"" },
+    { " C:\\\\path\\\\", " C:\\path\\" }, { "\\tint", "\tint" },
+    { " d\\u00e9j\\u00e0", " d\xc3\xa9j\xc3\xa0" }, { " d\xc3\xa9j\xc3\xa0", " d\xc3\xa9j\xc3\xa0" },
+    { " \\ud83d\\ude00", " \xf0\x9f\x98\x80" }, { " \xf0\x9f\x98\x80", " \xf0\x9f\x98\x80" },
+    { " \\u4e2d\\u6587", " \xe4\xb8\xad\xe6\x96\x87" }, { "\\/", "/" },
+    { " \\u0001", " \x01" }, { ".", "." }
+};
+
+#define N_KINDS (sizeof tokens / sizeof *tokens)
+
+/* Every 1000th token is a large escape run, as a pasted file would be */
+static void large_token(GString *json, GString *text)
+{
+    for (int i = 0; i < 512; i++)
+    {
+        g_string_append(json, "\\\"\\\\\\n\\ud83d\\ude80\\u00e9x");
+        g_string_append(text, "\"\\\n\xf0\x9f\x9a\x80\xc3\xa9x");
+    }
+}
+
+/* Escaped text and decoded text of token @i */
+static void token_at(guint i, GString *json, GString *text)
+{
+    g_string_truncate(json, 0);
+    g_string_truncate(text, 0);
+    if (i % 1000 == 999)
+        large_token(json, text);
+    else
+    {
+        const Token *t = &tokens[(i * 7 + i / N_KINDS) % N_KINDS];
+        g_string_append(json, t->json);
+        g_string_append(text, t->text);
+    }
+}
+
+static Corpus* corpus_new(const gchar *name, Format fmt, gboolean ollama)
+{
+    Corpus *c = g_new0(Corpus, 1);
+    c->name = g_strdup(name);
+    c->fmt = fmt;
+    c->ollama = ollama;
+    c->input = g_string_sized_new(16 << 20);
+    c->expect = g_string_sized_new(4 << 20);
+    return c;
+}
+
+static Corpus* make_ollama(void)
+{
+    Corpus *c = corpus_new("ollama ndjson", FMT_LINES, TRUE);
+    GString *json = g_string_new(NULL), *text = g_string_new(NULL);
+    for (guint i = 0; i < N_TOKENS; i++)
+    {
+        token_at(i, json, text);
+        g_string_append_printf(c->input,
+            "{\"model\":\"llama3\",\"created_at\":\"2025-09-12T10:00:00Z\","
+            "\"message\":{\"role\":\"assistant\",\"content\":\"%s\"},"
+            "\"done\":false}\n", json->str);
+        g_string_append_len(c->expect, text->str, (gssize)text->len);
+    }
+    g_string_append_printf(c->input,
+        "{\"model\":\"llama3\",\"message\":{\"role\":\"assistant\",\"content\":\"\"},"
+        "\"done\":true,\"eval_count\":%d}\n", N_TOKENS);
+    c->tokens = N_TOKENS;
+    g_string_free(json, TRUE);
+    g_string_free(text, TRUE);
+    return c;
+}
+
+static Corpus* make_openai(void)
+{
+    Corpus *c = corpus_new("openai sse", FMT_SSE, FALSE);
+    GString *json = g_string_new(NULL), *text = g_string_new(NULL);
+    g_string_append(c->input, ": connected\r\n\r\n"
+        "data: {\"choices\":[{\"index\":0,\"delta\":{\"role\":\"assistant\"}}]}\r\n\r\n");
+    for (guint i = 0; i < N_TOKENS; i++)
+    {
+        token_at(i, json, text);
+        g_string_append_printf(c->input,
+            "data: {\"id\":\"chatcmpl-1\",\"object\":\"chat.completion.chunk\","
+            "\"choices\":[{\"index\":0,\"delta\":{\"content\":\"%s\"},"
+            "\"finish_reason\":null}]}\r\n\r\n", json->str);
+        g_string_append_len(c->expect, text->str, (gssize)text->len);
+        if (i % 500 == 0)
+            g_string_append(c->input, ": keep-alive\r\n\r\n");
+    }
+    g_string_append(c->input,
+        "data: {\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"}]}\r\n\r\n"
+        "data: [DONE]\r\n\r\n");
+    c->tokens = N_TOKENS;
+    g_string_free(json, TRUE);
+    g_string_free(text, TRUE);
+    return c;
+}
+
+/* A non-streamed reply: one document with one long string */
+static Corpus* make_body(void)
+{
+    Corpus *c = corpus_new("openai body", FMT_BODY, FALSE);
+    GString *json = g_string_new(NULL), *text = g_string_new(NULL);
+    g_string_append(c->input, "{\"id\":\"chatcmpl-1\",\"object\":\"chat.completion\","
+                    "\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"");
+    for (guint i = 0; i < N_TOKENS; i++)
+    {
+        token_at(i, json, text);
+        g_string_append_len(c->input, json->str, (gssize)json->len);
+        g_string_append_len(c->expect, text->str, (gssize)text->len);
+    }
+    g_string_append_printf(c->input, "\"},\"finish_reason\":\"stop\"}],"
+                           "\"usage\":{\"completion_tokens\":%d}}", N_TOKENS);
+    c->tokens = N_TOKENS;
+    g_string_free(json, TRUE);
+    g_string_free(text, TRUE);
+    return c;
+}
+
+static Corpus* load_recording(const gchar *path)
+{
+    gchar *data;
+    gsize len;
+    GError *err = NULL;
+
+    if (!g_file_get_contents(path, &data, &len, &err))
+    {
+        fprintf(stderr, "bench_parse: %s\n", err->message);
+        g_error_free(err);
+        return NULL;
+    }
+    gboolean lines = len > 0 && data[0] == '{';
+    Corpus *c = corpus_new(path, lines ? FMT_LINES : FMT_SSE, lines);
+    g_string_append_len(c->input, data, (gssize)len);
+    g_string_free(c->expect, TRUE);
+    c->expect = NULL;
+    g_free(data);
+    return c;
+}
+
+static void corpus_free(Corpus *c)
+{
+    g_free(c->name);
+    g_string_free(c->input, TRUE);
+    if (c->expect)
+        g_string_free(c->expect, TRUE);
+    g_free(c);
+}
+
+/* --- Chunkings ----------------------------------------------------------- */
+
+/* Piece boundaries: offsets where each piece ends, the last is input->len */
+typedef struct
+{
+    const gchar *name;
+    GArray      *ends;   /* gsize */
+} Chunking;
+
+static GArray* fixed_cuts(gsize len, gsize size)
+{
+    GArray *a = g_array_new(FALSE, FALSE, sizeof(gsize));
+    for (gsize off = size; off < len; off += size)
+        g_array_append_val(a, off);
+    g_array_append_val(a, len);
+    return a;
+}
+
+/*
+ * Cut right after each backslash, after the first byte of each UTF-8
+ * sequence and inside "\uXXXX\uXXXX" pairs: wherever a resumable parser
+ * has to carry state from one piece to the next.
+ */
+static GArray* hostile_cuts(const GString *in)
+{
+    GArray *a = g_array_new(FALSE, FALSE, sizeof(gsize));
+    const guchar *s = (const guchar *)in->str;
+    gsize last = 0;
+    for (gsize i = 0; i + 1 < in->len; i++)
+    {
+        gboolean cut = s[i] == '\\' || s[i] >= 0xC0 ||
+                       (s[i] == 'u' && i > 0 && s[i - 1] == '\\') ||
+                       s[i] == '\r';
+        if (!cut && i - last < 64)
+            continue;
+        gsize end = i + 1;
+        g_array_append_val(a, end);
+        last = end;
+    }
+    g_array_append_val(a, in->len);
+    return a;
+}
+
+/* Sizes 1..32 from a fixed seed */
+static GArray* random_cuts(gsize len)
+{
+    GArray *a = g_array_new(FALSE, FALSE, sizeof(gsize));
+    GRand *r = g_rand_new_with_seed(42);
+    for (gsize off = 0; ;)
+    {
+        off += (gsize)g_rand_int_range(r, 1, 33);
+        if (off >= len)
+            break;
+        g_array_append_val(a, off);
+    }
+    g_array_append_val(a, len);
+    g_rand_free(r);
+    return a;
+}
+
+/* --- Decode path (as network.c) ------------------------------------------ */
+
+typedef struct
+{
+    Framer      framer;
+    JsonStream *parser;
+    GString    *accum;
+    guint       chunks;   /* Documents that carried content */
+    ReplyState  reply;
+} Decoder;
+
+static void on_json_chunk(gpointer ud, gint field, const gchar *text, gsize len)
+{
+    Decoder *d = (Decoder *)ud;
+    (void)field;
+    g_string_append_len(d->accum, text, (gssize)len);
+}
+
+static void on_json_value(gpointer ud, gint field, JsonValueType type,
+                          const gchar *text, gsize len)
+{
+    reply_value(&((Decoder *)ud)->reply, field, type, text, len);
+}
+
+static void decoder_init(Decoder *d, gboolean ollama, GString *accum)
+{
+    memset(d, 0, sizeof *d);
+    d->accum = accum;
+    d->parser = json_stream_new(on_json_chunk, on_json_value, d);
+    reply_watch(d->parser, ollama);
+}
+
+static void decoder_clear(Decoder *d)
+{
+    json_stream_free(d->parser);
+    framer_clear(&d->framer);
+    reply_clear(&d->reply);
+}
+
+static void parse_document(gpointer ud, const gchar *data, gsize len)
+{
+    Decoder *d = (Decoder *)ud;
+    gsize before = d->accum->len;
+    json_stream_reset(d->parser);
+    json_stream_feed(d->parser, data, len);
+    if (d->accum->len > before)
+        d->chunks++;
+}
+
+static void on_sse_event(gpointer ud, const gchar *data, gsize len)
+{
+    if (len == 6 && memcmp(data, "[DONE]", 6) == 0)
+        ((Decoder *)ud)->reply.done = TRUE;
+    else
+        parse_document(ud, data, len);
+}
+
+static void decode(Decoder *d, Format fmt, const gchar *data, gsize len)
+{
+    switch (fmt)
+    {
+        case FMT_LINES: framer_feed_lines(&d->framer, data, len, parse_document, d); break;
+        case FMT_SSE:   framer_feed_sse(&d->framer, data, len, on_sse_event, d);     break;
+        case FMT_BODY:  json_stream_feed(d->parser, data, len);                      break;
+    }
+}
+
+/* --- Driver -------------------------------------------------------------- */
+
+typedef struct
+{
+    gdouble min_mbps;
+    gdouble max_allocs;
+} Gate;
+
+/* One pass over @c cut at @ends, into a fresh *accum; returns µs spent */
+static gint64 pass(const Corpus *c, GArray *ends, GString **accum,
+                   gsize *allocs, guint *chunks)
+{
+    Decoder d;
+    if (*accum)
+        g_string_free(*accum, TRUE);
+
+    gsize a0 = n_allocs;
+    gint64 t0 = g_get_monotonic_time();
+    *accum = g_string_new(NULL);   /* Grows from empty, as in network.c */
+    decoder_init(&d, c->ollama, *accum);
+    gsize off = 0;
+    for (guint i = 0; i < ends->len; i++)
+    {
+        gsize end = g_array_index(ends, gsize, i);
+        decode(&d, c->fmt, c->input->str + off, end - off);
+        off = end;
+    }
+    if (c->fmt == FMT_LINES)
+        framer_flush_lines(&d.framer, parse_document, &d);
+    decoder_clear(&d);
+    gint64 us = g_get_monotonic_time() - t0;
+    *allocs = n_allocs - a0;
+
+    *chunks = c->fmt == FMT_BODY ? c->tokens : d.chunks;
+    return us;
+}
+
+static int run(Corpus *c, const Chunking *ck, const Gate *gate)
+{
+    GString *accum = NULL;
+    gsize allocs;
+    guint chunks;
+    gint64 us = 0;
+    int reps = 0, rc = 0;
+
+    /* Repeat for stable timings and keep the best pass; every pass sets up
+     * a parser and a reply from scratch, so allocations are the same */
+    gint64 best = G_MAXINT64;
+    do
+    {
+        gint64 t = pass(c, ck->ends, &accum, &allocs, &chunks);
+        best = MIN(best, t);
+        us += t;
+        reps++;
+    } while (us < REPEAT_US);
+
+    if (!c->expect)
+        c->expect = g_string_new_len(accum->str, (gssize)accum->len);
+    if (c->tokens == 0)
+        c->tokens = chunks;
+
+    gdouble secs = MAX(best, 1) / 1e6;
+    gdouble mbps = c->input->len / secs / 1e6;
+    gdouble per_token = chunks ? (gdouble)allocs / chunks : 0;
+    printf("  %-10s %8.1f MB/s %10.0f tokens/s %7.3f allocs/token  (%u writes)\n",
+           ck->name, mbps, chunks / secs, per_token, ck->ends->len);
+
+    if (accum->len != c->expect->len ||
+        memcmp(accum->str, c->expect->str, accum->len) != 0 || chunks != c->tokens)
+    {
+        printf("  output mismatch (%zu bytes, %u tokens; expected %zu, %u)\n",
+               accum->len, chunks, c->expect->len, c->tokens);
+        rc = 1;
+    }
+    if (gate->min_mbps > 0 && mbps < gate->min_mbps)
+    {
+        printf("  below --min-mbps %.1f\n", gate->min_mbps);
+        rc = 1;
+    }
+    if (gate->max_allocs >= 0 && per_token > gate->max_allocs)
+    {
+        printf("  above --max-allocs %.3f\n", gate->max_allocs);
+        rc = 1;
+    }
+    g_string_free(accum, TRUE);
+    return rc;
+}
+
+static int bench(Corpus *c, const Gate *gate)
+{
+    Chunking cks[] = {
+        { "whole", NULL },
+        { "16384 B", NULL },
+        { "1500 B", NULL },
+        { "7 B", NULL },
+        { "1-32 B", NULL },
+        { "hostile", NULL },
+        { "1 B", NULL }
+    };
+    gsize len = c->input->len;
+    cks[0].ends = fixed_cuts(len, len);
+    cks[1].ends = fixed_cuts(len, 16384);
+    cks[2].ends = fixed_cuts(len, 1500);
+    cks[3].ends = fixed_cuts(len, 7);
+    cks[4].ends = random_cuts(len);
+    cks[5].ends = hostile_cuts(c->input);
+    cks[6].ends = fixed_cuts(len, 1);
+
+    printf("bench_parse: %s, %.1f MB\n", c->name, len / 1e6);
+    int rc = 0;
+    for (guint i = 0; i < G_N_ELEMENTS(cks); i++)
+    {
+        rc |= run(c, &cks[i], gate);
+        g_array_free(cks[i].ends, TRUE);
+    }
+    return rc;
+}
+
+int main(int argc, char **argv)
+{
+    Gate gate = { 0, -1 };
+    GPtrArray *corpora = g_ptr_array_new_with_free_func((GDestroyNotify)corpus_free);
+    int rc = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--min-mbps") == 0 && i + 1 < argc)
+            gate.min_mbps = g_ascii_strtod(argv[++i], NULL);
+        else if (strcmp(argv[i], "--max-allocs") == 0 && i + 1 < argc)
+            gate.max_allocs = g_ascii_strtod(argv[++i], NULL);
+        else
+        {
+            Corpus *c = load_recording(argv[i]);
+            if (!c)
+                return 2;
+            g_ptr_array_add(corpora, c);
+        }
+    }
+    if (corpora->len == 0)
+    {
+        g_ptr_array_add(corpora, make_ollama());
+        g_ptr_array_add(corpora, make_openai());
+        g_ptr_array_add(corpora, make_body());
+    }
+
+    for (guint i = 0; i < corpora->len; i++)
+        rc |= bench(g_ptr_array_index(corpora, i), &gate);
+
+    g_ptr_array_free(corpora, TRUE);
+    return rc;
+}
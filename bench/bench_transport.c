@@ -0,0 +1,244 @@
+/*
+ * bench_transport.c — Loopback TCP against a Unix domain socket
+ *
+ * Starts tools/mock_llm twice, once on a free port of 127.0.0.1 and once
+ * on a Unix socket, unpaced, and drives both with libcurl set up like netpool.c
+ * (one reused handle, TCP_NODELAY, keep-alive). Reports, per transport:
+ *   - the round trip of a small GET (/api/tags) on a warm connection,
+ *   - the time to the first token of a streamed /api/chat,
+ *   - the streaming rate of the whole reply, in tokens/s and µs/token.
+ *
+ * Build and run: make bench (needs make mock-server, done by the rule)
+ * Options: bench/bench_transport [rounds] [tokens per reply]
+ */
+
+#include <glib.h>
+#include <curl/curl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MOCK      "tools/mock_llm"
+#define CHAT_BODY "{\"model\":\"mock-small\",\"stream\":true," \
+                  "\"messages\":[{\"role\":\"user\",\"content\":\"bench\"}]}"
+
+typedef struct
+{
+    gint64 t0;          /* Request start */
+    gint64 t_first;     /* First body byte, 0 until then */
+    gsize  tokens;      /* JSON lines received */
+} Sink;
+
+static size_t sink_cb(char *data, size_t size, size_t nm, void *ud)
+{
+    Sink *s = (Sink *)ud;
+    size_t n = size * nm;
+
+    if (!s->t_first)
+        s->t_first = g_get_monotonic_time();
+    for (const char *p = data; (p = memchr(p, '\n', (size_t)(data + n - p))); p++)
+        s->tokens++;
+    return n;
+}
+
+/* --- Mock servers -------------------------------------------------------- */
+
+static pid_t spawn_mock(const gchar *where_flag, const gchar *where,
+                        const gchar *tokens, int out_fd)
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        if (out_fd >= 0)
+            dup2(out_fd, STDOUT_FILENO);
+        execl(MOCK, MOCK, where_flag, where, "--rate", "0",
+              "--tokens", tokens, (char *)NULL);
+        perror("bench_transport: " MOCK);
+        _exit(127);
+    }
+    return pid;
+}
+
+/*
+ * Start the mock on a port the kernel picks, so a busy port or another run
+ * of the benchmark cannot get in the way. Returns its base URL, or NULL.
+ */
+static gchar* spawn_mock_tcp(const gchar *tokens, pid_t *pid)
+{
+    int fds[2];
+    char line[16];
+    ssize_t n = 0, got;
+
+    *pid = -1;
+    if (pipe(fds) < 0)
+        return NULL;
+    *pid = spawn_mock("--port", "0", tokens, fds[1]);
+    close(fds[1]);
+    /* One line with the port; end of file if the server failed */
+    while (*pid > 0 && n < (ssize_t)sizeof line - 1 &&
+           (got = read(fds[0], line + n, sizeof line - 1 - (size_t)n)) > 0)
+    {
+        n += got;
+        if (memchr(line, '\n', (size_t)n))
+            break;
+    }
+    close(fds[0]);
+    line[n] = 0;
+
+    int port = atoi(line);
+    return port > 0 ? g_strdup_printf("http://127.0.0.1:%d", port) : NULL;
+}
+
+/* --- Measurements -------------------------------------------------------- */
+
+static CURL* handle_new(const gchar *unix_path)
+{
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, sink_cb);
+    if (unix_path)
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, unix_path);
+    return curl;
+}
+
+static gboolean get_once(CURL *curl, const gchar *url, Sink *s)
+{
+    memset(s, 0, sizeof *s);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, s);
+    s->t0 = g_get_monotonic_time();
+    return curl_easy_perform(curl) == CURLE_OK;
+}
+
+static gboolean chat_once(CURL *curl, const gchar *url, Sink *s)
+{
+    memset(s, 0, sizeof *s);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, CHAT_BODY);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, s);
+    s->t0 = g_get_monotonic_time();
+    return curl_easy_perform(curl) == CURLE_OK;
+}
+
+/* Wait for the server to answer, up to 3 s */
+static gboolean wait_ready(const gchar *base, const gchar *unix_path)
+{
+    CURL *curl = handle_new(unix_path);
+    gchar *url = g_strdup_printf("%s/api/tags", base);
+    Sink s;
+    gboolean ok = FALSE;
+
+    for (int i = 0; i < 300 && !ok; i++)
+    {
+        ok = get_once(curl, url, &s);
+        if (!ok)
+            g_usleep(10000);
+    }
+    g_free(url);
+    curl_easy_cleanup(curl);
+    return ok;
+}
+
+static gint cmp_i64(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+static gint64 pct(GArray *v, gdouble p)
+{
+    g_array_sort(v, cmp_i64);
+    guint i = (guint)(p * (v->len - 1) + 0.5);
+    return g_array_index(v, gint64, i);
+}
+
+static gboolean run(const gchar *name, const gchar *base, const gchar *unix_path,
+                    gint rounds)
+{
+    gchar *tags = g_strdup_printf("%s/api/tags", base);
+    gchar *chat = g_strdup_printf("%s/api/chat", base);
+    GArray *rtt = g_array_new(FALSE, FALSE, sizeof(gint64));
+    GArray *ttft = g_array_new(FALSE, FALSE, sizeof(gint64));
+    gint64 stream_us = 0;
+    gsize tokens = 0;
+    gboolean ok = TRUE;
+    CURL *curl = handle_new(unix_path);
+    Sink s;
+
+    /* Warm the connection; every round after reuses it */
+    ok = get_once(curl, tags, &s);
+    for (gint i = 0; ok && i < rounds; i++)
+    {
+        ok = get_once(curl, tags, &s);
+        gint64 t = g_get_monotonic_time() - s.t0;
+        g_array_append_val(rtt, t);
+    }
+    for (gint i = 0; ok && i < rounds; i++)
+    {
+        ok = chat_once(curl, chat, &s);
+        gint64 t_end = g_get_monotonic_time();
+        gint64 t = s.t_first - s.t0;
+        g_array_append_val(ttft, t);
+        stream_us += t_end - s.t_first;
+        tokens += s.tokens;
+    }
+
+    if (ok && tokens > 0)
+        printf("%-5s  round trip p50 %5" G_GINT64_FORMAT " µs  p99 %5" G_GINT64_FORMAT
+               " µs   first token p50 %5" G_GINT64_FORMAT " µs  p99 %5" G_GINT64_FORMAT
+               " µs   stream %9.0f tok/s  %5.2f µs/tok\n",
+               name, pct(rtt, 0.5), pct(rtt, 0.99), pct(ttft, 0.5), pct(ttft, 0.99),
+               tokens * 1e6 / (gdouble)MAX(stream_us, 1),
+               (gdouble)stream_us / (gdouble)tokens);
+    else
+        fprintf(stderr, "bench_transport: %s transfers failed\n", name);
+
+    curl_easy_cleanup(curl);
+    g_array_free(rtt, TRUE);
+    g_array_free(ttft, TRUE);
+    g_free(tags);
+    g_free(chat);
+    return ok;
+}
+
+int main(int argc, char **argv)
+{
+    gint rounds = argc > 1 ? atoi(argv[1]) : 500;
+    const gchar *tokens = argc > 2 ? argv[2] : "2000";
+    gchar *sock = g_strdup_printf("%s/bench_transport-%d.sock",
+                                  g_get_tmp_dir(), (int)getpid());
+    gboolean ok = FALSE;
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    pid_t tcp;
+    gchar *tcp_base = spawn_mock_tcp(tokens, &tcp);
+    pid_t uds = spawn_mock("--unix", sock, tokens, -1);
+
+    if (tcp_base && uds > 0 &&
+        wait_ready(tcp_base, NULL) &&
+        wait_ready("http://localhost", sock))
+    {
+        printf("mock_llm, %d rounds, %s tokens per reply\n", rounds, tokens);
+        ok = run("tcp", tcp_base, NULL, rounds) &&
+             run("unix", "http://localhost", sock, rounds);
+    }
+    else
+        fprintf(stderr, "bench_transport: mock server did not start (make mock-server)\n");
+
+    if (tcp > 0) kill(tcp, SIGTERM);
+    if (uds > 0) kill(uds, SIGTERM);
+    while (wait(NULL) > 0)
+        ;
+    unlink(sock);
+    g_free(sock);
+    g_free(tcp_base);
+    curl_global_cleanup();
+    return ok ? 0 : 1;
+}
@@ -11,6 +11,7 @@
 #include "prefs.h"
 #include "history.h"
 #include "network.h"
+#include "models.h"
 #include "ui.h"
 
 static GeanyPlugin *g_plugin = NULL;
@@ -23,7 +24,6 @@ static gboolean my_plugin_init(GeanyPlugin *plugin, gpointer data)
     g_plugin = plugin;
     prefs_load();
     if (!prefs.base_url) prefs_set_defaults();
-    history_init();
     network_init();
     ui_build(plugin);
     return TRUE;
@@ -34,7 +34,8 @@ static void my_plugin_cleanup(GeanyPlugin *plugin, gpointer data)
     (void)plugin; (void)data;
     prefs_save();
     network_cleanup();
-    history_free();
+    models_cleanup();
+    ui_cleanup();
     prefs_free();
 }
 
@@ -0,0 +1,82 @@
+/*
+ * byte_ring.c — Lock-free single-producer / single-consumer byte queue
+ *
+ * head and tail only ever grow (modulo 2^32); the producer owns head, the
+ * consumer owns tail, and each reads the other's with an atomic load.
+ * The atomic store that publishes a new head or tail comes after the
+ * bytes were copied, so the other side never sees a half-written range.
+ */
+
+#include "byte_ring.h"
+#include <string.h>
+
+struct ByteRing
+{
+    gchar        *data;
+    guint         mask;   /* capacity - 1 */
+    volatile gint head;   /* Total bytes written (producer) */
+    volatile gint tail;   /* Total bytes read (consumer) */
+    volatile gint ref;
+};
+
+ByteRing* byte_ring_new(gsize capacity)
+{
+    guint cap = 64;
+    while (cap < capacity && cap < (1u << 30))
+        cap <<= 1;
+
+    ByteRing *r = g_new0(ByteRing, 1);
+    r->data = g_malloc(cap);
+    r->mask = cap - 1;
+    r->ref = 1;
+    return r;
+}
+
+ByteRing* byte_ring_ref(ByteRing *r)
+{
+    g_atomic_int_inc(&r->ref);
+    return r;
+}
+
+void byte_ring_unref(ByteRing *r)
+{
+    if (!r || !g_atomic_int_dec_and_test(&r->ref))
+        return;
+    g_free(r->data);
+    g_free(r);
+}
+
+gsize byte_ring_write(ByteRing *r, const gchar *data, gsize len)
+{
+    guint head = (guint)r->head;
+    guint tail = (guint)g_atomic_int_get(&r->tail);
+    guint space = (r->mask + 1) - (head - tail);
+    guint n = (guint)MIN(len, (gsize)space);
+    if (n == 0)
+        return 0;
+
+    guint off = head & r->mask;
+    guint first = MIN(n, r->mask + 1 - off);
+    memcpy(r->data + off, data, first);
+    memcpy(r->data, data + first, n - first);
+
+    g_atomic_int_set(&r->head, (gint)(head + n));
+    return n;
+}
+
+gsize byte_ring_read_all(ByteRing *r, GString *out)
+{
+    guint tail = (guint)r->tail;
+    guint head = (guint)g_atomic_int_get(&r->head);
+    guint n = head - tail;
+    if (n == 0)
+        return 0;
+
+    guint off = tail & r->mask;
+    guint first = MIN(n, r->mask + 1 - off);
+    g_string_append_len(out, r->data + off, first);
+    g_string_append_len(out, r->data, n - first);
+
+    g_atomic_int_set(&r->tail, (gint)(tail + n));
+    return n;
+}
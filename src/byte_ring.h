@@ -0,0 +1,28 @@
+/*
+ * byte_ring.h — Lock-free single-producer / single-consumer byte queue
+ */
+
+#ifndef BYTE_RING_H
+#define BYTE_RING_H
+
+#include <glib.h>
+
+/*
+ * One thread writes, one other thread reads; neither ever blocks. The
+ * ring is reference counted so producer and consumer can drop it in any
+ * order.
+ */
+typedef struct ByteRing ByteRing;
+
+/* Capacity is rounded up to a power of two */
+ByteRing* byte_ring_new(gsize capacity);
+ByteRing* byte_ring_ref(ByteRing *r);
+void byte_ring_unref(ByteRing *r);
+
+/* Producer: copy up to @len bytes in; returns how many fitted */
+gsize byte_ring_write(ByteRing *r, const gchar *data, gsize len);
+
+/* Consumer: append everything queued so far to @out; returns the count */
+gsize byte_ring_read_all(ByteRing *r, GString *out);
+
+#endif /* BYTE_RING_H */
@@ -0,0 +1,186 @@
+/*
+ * capture.c — Raw response recording and replay files
+ */
+
+#include "capture.h"
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+struct Capture
+{
+    FILE   *fp;
+    gint64  t0;   /* Monotonic time of capture_open */
+};
+
+gchar* capture_dir(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "geany",
+                            "ai_chat_captures", NULL);
+}
+
+static gint by_name(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar * const *)a, *(const gchar * const *)b);
+}
+
+/* Keep the newest @keep captures; names sort by date */
+static void prune(const gchar *dir, guint keep)
+{
+    GDir *d = g_dir_open(dir, 0, NULL);
+    if (!d)
+        return;
+
+    GPtrArray *names = g_ptr_array_new_with_free_func(g_free);
+    const gchar *name;
+    while ((name = g_dir_read_name(d)) != NULL)
+        if (g_str_has_suffix(name, ".aicap"))
+            g_ptr_array_add(names, g_strdup(name));
+    g_dir_close(d);
+
+    g_ptr_array_sort(names, by_name);
+    for (guint i = 0; i + keep < names->len; i++)
+    {
+        gchar *path = g_build_filename(dir, g_ptr_array_index(names, i), NULL);
+        g_unlink(path);
+        g_free(path);
+    }
+    g_ptr_array_free(names, TRUE);
+}
+
+Capture* capture_open(ApiMode mode, gboolean streaming, const gchar *model)
+{
+    static guint seq = 0;
+    gchar *dir = capture_dir();
+    g_mkdir_with_parents(dir, 0700);
+    prune(dir, CAPTURE_KEEP - 1);
+
+    GDateTime *now = g_date_time_new_now_local();
+    gchar *stamp = g_date_time_format(now, "%Y%m%d-%H%M%S");
+    g_date_time_unref(now);
+    gchar *name = g_strdup_printf("%s-%03u.aicap", stamp, seq++ % 1000);
+    gchar *path = g_build_filename(dir, name, NULL);
+    g_free(stamp);
+    g_free(name);
+    g_free(dir);
+
+    FILE *fp = g_fopen(path, "wb");
+    g_free(path);
+    if (!fp)
+        return NULL;
+
+    Capture *c = g_new0(Capture, 1);
+    c->fp = fp;
+    c->t0 = g_get_monotonic_time();
+    fprintf(fp, "AICAP 1 %s %d %s\n", mode == API_OPENAI ? "openai" : "ollama",
+            streaming ? 1 : 0, model && *model ? model : "-");
+    return c;
+}
+
+void capture_status(Capture *c, long status)
+{
+    if (!c)
+        return;
+    fprintf(c->fp, "S %" G_GINT64_FORMAT " %ld\n",
+            g_get_monotonic_time() - c->t0, status);
+}
+
+void capture_data(Capture *c, const gchar *data, gsize len)
+{
+    if (!c)
+        return;
+    fprintf(c->fp, "D %" G_GINT64_FORMAT " %" G_GSIZE_FORMAT "\n",
+            g_get_monotonic_time() - c->t0, len);
+    fwrite(data, 1, len, c->fp);
+    fputc('\n', c->fp);
+}
+
+void capture_close(Capture *c)
+{
+    if (!c)
+        return;
+    fclose(c->fp);
+    g_free(c);
+}
+
+/* --- Loading ------------------------------------------------------------- */
+
+static gboolean bad_file(GError **error, const gchar *what)
+{
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+                "capture invalide (%s)", what);
+    return FALSE;
+}
+
+static gboolean parse_records(CaptureFile *f, gsize len, GError **error)
+{
+    const gchar *p = f->contents, *end = f->contents + len;
+
+    /* Header */
+    const gchar *nl = memchr(p, '\n', (gsize)(end - p));
+    if (!nl || !g_str_has_prefix(p, "AICAP 1 "))
+        return bad_file(error, "en-tête");
+    gchar *header = g_strndup(p, (gsize)(nl - p));
+    gchar **fields = g_strsplit(header, " ", 5);
+    g_free(header);
+    if (g_strv_length(fields) < 5)
+    {
+        g_strfreev(fields);
+        return bad_file(error, "en-tête");
+    }
+    f->mode = strcmp(fields[2], "openai") == 0 ? API_OPENAI : API_OLLAMA;
+    f->streaming = strcmp(fields[3], "1") == 0;
+    f->model = g_strdup(fields[4]);
+    g_strfreev(fields);
+    p = nl + 1;
+
+    while (p < end)
+    {
+        CaptureRecord r = { 0 };
+        gchar *q;
+
+        nl = memchr(p, '\n', (gsize)(end - p));
+        if (!nl || (p[0] != 'S' && p[0] != 'D') || p[1] != ' ')
+            return bad_file(error, "enregistrement");
+        r.kind = p[0];
+        r.us = g_ascii_strtoll(p + 2, &q, 10);
+        if (r.kind == 'S')
+            r.status = (long)g_ascii_strtoll(q, NULL, 10);
+        else
+        {
+            r.len = (gsize)g_ascii_strtoull(q, NULL, 10);
+            if (r.len > (gsize)(end - nl - 1))
+                return bad_file(error, "tronquée");
+            r.data = nl + 1;
+            nl += r.len + 1;   /* The '\n' after the bytes */
+        }
+        g_array_append_val(f->records, r);
+        p = nl + 1;
+    }
+    return TRUE;
+}
+
+CaptureFile* capture_load(const gchar *path, GError **error)
+{
+    CaptureFile *f = g_new0(CaptureFile, 1);
+    gsize len;
+
+    f->records = g_array_new(FALSE, FALSE, sizeof(CaptureRecord));
+    if (!g_file_get_contents(path, &f->contents, &len, error) ||
+        !parse_records(f, len, error))
+    {
+        capture_file_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+void capture_file_free(CaptureFile *f)
+{
+    if (!f)
+        return;
+    g_array_free(f->records, TRUE);
+    g_free(f->model);
+    g_free(f->contents);
+    g_free(f);
+}
@@ -0,0 +1,60 @@
+/*
+ * capture.h — Raw response recording and replay files
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <glib.h>
+#include "prefs.h"
+
+/*
+ * A capture holds the bytes of one response exactly as the write callback
+ * got them, each piece with its arrival time since the request was sent,
+ * plus the HTTP status of each response received (retries, redirects).
+ * Files live in ~/.config/geany/ai_chat_captures/, newest CAPTURE_KEEP.
+ *
+ * Format: a header line "AICAP 1 <ollama|openai> <stream 0|1> <model>",
+ * then records "S <µs> <status>\n" and "D <µs> <len>\n<len bytes>\n".
+ */
+
+#define CAPTURE_KEEP 50
+
+typedef struct Capture Capture;
+
+/* Start recording a response (main thread); NULL if the file can't be made */
+Capture* capture_open(ApiMode mode, gboolean streaming, const gchar *model);
+
+/* Record a status line / a piece of body (I/O thread; @c may be NULL) */
+void capture_status(Capture *c, long status);
+void capture_data(Capture *c, const gchar *data, gsize len);
+
+/* Finish the file (any thread, once the transfer is over) */
+void capture_close(Capture *c);
+
+typedef struct
+{
+    gchar        kind;     /* 'S' or 'D' */
+    gint64       us;       /* Since the request was sent */
+    long         status;   /* 'S' */
+    const gchar *data;     /* 'D', points into the loaded file */
+    gsize        len;
+} CaptureRecord;
+
+typedef struct
+{
+    ApiMode   mode;
+    gboolean  streaming;
+    gchar    *model;
+    GArray   *records;   /* CaptureRecord */
+    gchar    *contents;
+} CaptureFile;
+
+/* Read a capture for replay */
+CaptureFile* capture_load(const gchar *path, GError **error);
+void capture_file_free(CaptureFile *f);
+
+/* Directory of the captures (caller frees) */
+gchar* capture_dir(void);
+
+#endif /* CAPTURE_H */
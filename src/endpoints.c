@@ -0,0 +1,254 @@
+/*
+ * endpoints.c — Load balancing over a pool of base URLs for AI Chat plugin
+ *
+ * A backend preset may list more base URLs serving the same models, e.g.
+ * several identical Ollama boxes. Each request goes to the member with
+ * the lowest (outstanding + 1) × EWMA of its time to first byte, which
+ * for a chat includes queueing and prompt evaluation on that box. A
+ * member failing EJECT_AFTER times in a row is taken out of rotation for
+ * a time doubling on each new ejection; once that runs out it is probed
+ * and only comes back when the probe answers. State is per URL, shared
+ * by every preset listing it; picks run on the main thread, outcomes
+ * come from the I/O thread, hence the lock.
+ */
+
+#include "endpoints.h"
+#include <string.h>
+
+/* Weight of the newest time to first byte in the average */
+#define EWMA_ALPHA     0.3
+/* Consecutive failures that eject a member */
+#define EJECT_AFTER    2
+#define EJECT_BASE_US  (15 * G_USEC_PER_SEC)
+#define EJECT_MAX_US   (5 * 60 * G_USEC_PER_SEC)
+
+typedef struct
+{
+    gint    outstanding;
+    guint64 picks;
+    gint64  ewma_us;       /* 0 until a first success */
+    gint    fails;         /* Consecutive */
+    gint64  eject_us;      /* Length of the last ejection, 0 if healthy */
+    gint64  ejected_until; /* Monotonic µs, 0 = in rotation */
+    gboolean probing;
+} Endpoint;
+
+static GMutex      ep_lock;
+static GHashTable *endpoints = NULL;   /* url -> Endpoint* */
+
+/* Caller holds ep_lock */
+static Endpoint* endpoint_get(const gchar *url)
+{
+    if (!endpoints)
+        endpoints = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    Endpoint *e = g_hash_table_lookup(endpoints, url);
+    if (!e)
+    {
+        e = g_new0(Endpoint, 1);
+        g_hash_table_insert(endpoints, g_strdup(url), e);
+    }
+    return e;
+}
+
+/* Caller holds ep_lock */
+static void endpoint_eject(Endpoint *e, gint64 now)
+{
+    e->eject_us = e->eject_us ? MIN(e->eject_us * 2, EJECT_MAX_US) : EJECT_BASE_US;
+    e->ejected_until = now + e->eject_us;
+    e->fails = 0;
+    e->probing = FALSE;
+}
+
+gchar** endpoints_split(const gchar *base_url, const gchar *pool)
+{
+    GPtrArray *urls = g_ptr_array_new();
+
+    if (base_url && *base_url)
+        g_ptr_array_add(urls, g_strdup(base_url));
+
+    gchar **parts = g_strsplit_set(pool ? pool : "", " \t\r\n,;", -1);
+    for (gchar **p = parts; *p; p++)
+    {
+        gsize len = strlen(*p);
+        while (len > 0 && (*p)[len - 1] == '/')
+            (*p)[--len] = '\0';
+        if (len == 0)
+            continue;
+
+        gboolean dup = FALSE;
+        for (guint i = 0; i < urls->len && !dup; i++)
+            dup = g_strcmp0(g_ptr_array_index(urls, i), *p) == 0;
+        if (!dup)
+            g_ptr_array_add(urls, g_strdup(*p));
+    }
+    g_strfreev(parts);
+
+    g_ptr_array_add(urls, NULL);
+    return (gchar **)g_ptr_array_free(urls, FALSE);
+}
+
+gchar* endpoints_pick(const gchar *base_url, const gchar *pool,
+                      const gchar *avoid, GPtrArray *probes)
+{
+    gchar **urls = endpoints_split(base_url, pool);
+    gint64 now = g_get_monotonic_time();
+    const gchar *best = NULL, *fallback = NULL, *avoided = NULL;
+    gdouble best_cost = 0;
+    guint64 best_picks = 0;
+    gint64 fallback_until = 0;
+
+    if (!urls[0])
+    {
+        g_strfreev(urls);
+        return g_strdup(base_url);
+    }
+
+    g_mutex_lock(&ep_lock);
+
+    /* Unknown members are costed like the fastest known one, so a new
+     * member gets its share of requests right away */
+    gint64 known = 0;
+    for (gchar **u = urls; *u; u++)
+    {
+        Endpoint *e = endpoint_get(*u);
+        if (e->ewma_us > 0 && (known == 0 || e->ewma_us < known))
+            known = e->ewma_us;
+    }
+
+    for (gchar **u = urls; *u; u++)
+    {
+        Endpoint *e = endpoint_get(*u);
+
+        if (e->ejected_until)
+        {
+            if (now >= e->ejected_until && !e->probing && probes)
+            {
+                e->probing = TRUE;
+                g_ptr_array_add(probes, g_strdup(*u));
+            }
+            if (!fallback || e->ejected_until < fallback_until)
+            {
+                fallback = *u;
+                fallback_until = e->ejected_until;
+            }
+            continue;
+        }
+        if (avoid && g_strcmp0(*u, avoid) == 0)
+        {
+            avoided = *u;   /* Still better than an ejected member */
+            continue;
+        }
+
+        gdouble lat = (gdouble)(e->ewma_us > 0 ? e->ewma_us : MAX(known, 1));
+        gdouble cost = (e->outstanding + 1) * lat;
+        if (!best || cost < best_cost || (cost == best_cost && e->picks < best_picks))
+        {
+            best = *u;
+            best_cost = cost;
+            best_picks = e->picks;
+        }
+    }
+
+    /* Only @avoid left healthy: take it again. Everything ejected: the
+     * member back soonest, rather than nothing */
+    if (!best)
+        best = avoided ? avoided : fallback ? fallback : urls[0];
+
+    Endpoint *e = endpoint_get(best);
+    e->outstanding++;
+    e->picks++;
+    gchar *url = g_strdup(best);
+
+    g_mutex_unlock(&ep_lock);
+    g_strfreev(urls);
+    return url;
+}
+
+void endpoints_release(const gchar *url)
+{
+    if (!url)
+        return;
+    g_mutex_lock(&ep_lock);
+    Endpoint *e = endpoint_get(url);
+    if (e->outstanding > 0)
+        e->outstanding--;
+    g_mutex_unlock(&ep_lock);
+}
+
+void endpoints_report(const gchar *url, gboolean ok, gint64 ttfb_us)
+{
+    if (!url)
+        return;
+
+    g_mutex_lock(&ep_lock);
+    Endpoint *e = endpoint_get(url);
+    if (ok)
+    {
+        e->fails = 0;
+        e->eject_us = 0;
+        e->ejected_until = 0;
+        if (ttfb_us > 0)
+            e->ewma_us = e->ewma_us ? (gint64)(EWMA_ALPHA * ttfb_us +
+                                               (1 - EWMA_ALPHA) * e->ewma_us)
+                                    : ttfb_us;
+    }
+    else if (!e->ejected_until && ++e->fails >= EJECT_AFTER)
+        endpoint_eject(e, g_get_monotonic_time());
+    g_mutex_unlock(&ep_lock);
+}
+
+void endpoints_probed(const gchar *url, gboolean ok)
+{
+    g_mutex_lock(&ep_lock);
+    Endpoint *e = endpoint_get(url);
+    if (ok)
+    {
+        /* Back in rotation; eject_us stays, so a flapping member is
+         * kept out longer next time until a real request succeeds */
+        e->ejected_until = 0;
+        e->probing = FALSE;
+        e->fails = 0;
+    }
+    else
+        endpoint_eject(e, g_get_monotonic_time());
+    g_mutex_unlock(&ep_lock);
+}
+
+gchar* endpoints_format(const gchar *base_url, const gchar *pool)
+{
+    gchar **urls = endpoints_split(base_url, pool);
+    if (!urls[0] || !urls[1])
+    {
+        g_strfreev(urls);
+        return NULL;
+    }
+
+    GString *gs = g_string_new("Pool :");
+    gint64 now = g_get_monotonic_time();
+
+    g_mutex_lock(&ep_lock);
+    for (gchar **u = urls; *u; u++)
+    {
+        Endpoint *e = endpoint_get(*u);
+        g_string_append_printf(gs, "\n  %s — %d en cours, %" G_GUINT64_FORMAT " envoyée(s)",
+                               *u, e->outstanding, e->picks);
+        if (e->ewma_us > 0)
+            g_string_append_printf(gs, ", premier octet ~%.0f ms", e->ewma_us / 1000.0);
+        if (e->probing)
+            g_string_append(gs, ", écarté (test en cours)");
+        else if (e->ejected_until)
+            g_string_append_printf(gs, ", écarté encore %.0f s",
+                                   (gdouble)MAX(e->ejected_until - now, 0) / G_USEC_PER_SEC);
+    }
+    g_mutex_unlock(&ep_lock);
+
+    g_strfreev(urls);
+    return g_string_free(gs, FALSE);
+}
+
+void endpoints_cleanup(void)
+{
+    g_mutex_lock(&ep_lock);
+    g_clear_pointer(&endpoints, g_hash_table_destroy);
+    g_mutex_unlock(&ep_lock);
+}
@@ -0,0 +1,47 @@
+/*
+ * endpoints.h — Load balancing over a pool of base URLs for AI Chat plugin
+ */
+
+#ifndef ENDPOINTS_H
+#define ENDPOINTS_H
+
+#include <glib.h>
+
+/*
+ * The base URLs of a backend: @base_url first, then those of @pool
+ * (separated by spaces, commas or new lines), without duplicates.
+ * Free with g_strfreev.
+ */
+gchar** endpoints_split(const gchar *base_url, const gchar *pool);
+
+/*
+ * Pick the member of @base_url's pool to send a request to and count it
+ * as outstanding there until endpoints_release(). The cheapest member
+ * wins, cost being (outstanding + 1) × recent time to first byte; @avoid
+ * (a retry moving off a failing member) only when no other member is
+ * healthy, and an ejected member only when all are. When @probes
+ * is given, members whose ejection ran out are added to it (new strings)
+ * and should be probed, with endpoints_probed() told the outcome. Any thread.
+ */
+gchar* endpoints_pick(const gchar *base_url, const gchar *pool,
+                      const gchar *avoid, GPtrArray *probes);
+
+/* A request sent to @url by endpoints_pick() is over */
+void endpoints_release(const gchar *url);
+
+/*
+ * Outcome of a request to @url: @ttfb_us (time to first byte) feeds the
+ * latency average on success; repeated failures eject @url for a while.
+ */
+void endpoints_report(const gchar *url, gboolean ok, gint64 ttfb_us);
+
+/* Outcome of a probe of an ejected member */
+void endpoints_probed(const gchar *url, gboolean ok);
+
+/* State of the members of a pool, one line each, or NULL (caller frees) */
+gchar* endpoints_format(const gchar *base_url, const gchar *pool);
+
+/* Forget every endpoint (plugin unload) */
+void endpoints_cleanup(void);
+
+#endif /* ENDPOINTS_H */
@@ -0,0 +1,202 @@
+/*
+ * framing.c — JSON-lines and SSE framing for streamed responses
+ *
+ * Complete lines are reported straight from the incoming chunk; only the
+ * unterminated tail is copied, so a buffered line is never scanned twice
+ * and nothing is moved when lines are consumed.
+ */
+
+#include "framing.h"
+#include <string.h>
+
+typedef void (*LineFunc)(gpointer ctx, const gchar *line, gsize len);
+
+/* --- Line splitting ------------------------------------------------------ */
+
+static void emit_line(const gchar *line, gsize len, LineFunc fn, gpointer ctx)
+{
+    if (len > 0 && line[len - 1] == '\r')
+        len--;
+    fn(ctx, line, len);
+}
+
+/*
+ * End of the line starting at @p: the next '\n' or, with @cr, a '\r' before
+ * it. *@nl caches the next '\n' (@end if none) so that lone-CR lines do
+ * not rescan the chunk. NULL if the line goes on past @end.
+ */
+static const gchar* line_end(const gchar *p, const gchar *end,
+                             const gchar **nl, gboolean cr)
+{
+    if (!*nl || *nl < p)
+    {
+        *nl = memchr(p, '\n', (gsize)(end - p));
+        if (!*nl)
+            *nl = end;
+    }
+    if (cr)
+    {
+        const gchar *r = memchr(p, '\r', (gsize)(*nl - p));
+        if (r)
+            return r;
+    }
+    return *nl < end ? *nl : NULL;
+}
+
+/* Past the terminator at @eol; a "\r\n" may be cut between two chunks */
+static const gchar* skip_eol(Framer *f, const gchar *eol, const gchar *end)
+{
+    if (*eol == '\r')
+    {
+        if (eol + 1 == end)
+            f->after_cr = TRUE;
+        else if (eol[1] == '\n')
+            return eol + 2;
+    }
+    return eol + 1;
+}
+
+/* With @cr, a lone '\r' ends a line too (SSE); otherwise only '\n' does */
+static void split_lines(Framer *f, const gchar *data, gsize len, gboolean cr,
+                        LineFunc fn, gpointer ctx)
+{
+    const gchar *end = data + len;
+    const gchar *eol, *nl = NULL;
+
+    if (!f->partial)
+        f->partial = g_string_new(NULL);
+
+    /* The '\n' of a "\r\n" whose '\r' ended the previous chunk */
+    if (f->after_cr && data < end)
+    {
+        f->after_cr = FALSE;
+        if (*data == '\n')
+            data++;
+    }
+
+    /* Complete the line left over from the previous chunk */
+    if (f->partial->len > 0)
+    {
+        eol = line_end(data, end, &nl, cr);
+        if (!eol)
+        {
+            g_string_append_len(f->partial, data, end - data);
+            return;
+        }
+        g_string_append_len(f->partial, data, eol - data);
+        emit_line(f->partial->str, f->partial->len, fn, ctx);
+        g_string_truncate(f->partial, 0);
+        data = skip_eol(f, eol, end);
+    }
+
+    /* Whole lines inside this chunk, without copying */
+    while (data < end && (eol = line_end(data, end, &nl, cr)) != NULL)
+    {
+        emit_line(data, (gsize)(eol - data), fn, ctx);
+        data = skip_eol(f, eol, end);
+    }
+
+    if (data < end)
+        g_string_append_len(f->partial, data, end - data);
+}
+
+/* --- JSON lines ---------------------------------------------------------- */
+
+typedef struct
+{
+    FrameFunc cb;
+    gpointer  user_data;
+} FrameCtx;
+
+static void json_line(gpointer ctx, const gchar *line, gsize len)
+{
+    FrameCtx *c = (FrameCtx *)ctx;
+    if (len > 0)
+        c->cb(c->user_data, line, len);
+}
+
+void framer_feed_lines(Framer *f, const gchar *data, gsize len,
+                       FrameFunc cb, gpointer user_data)
+{
+    FrameCtx c = { cb, user_data };
+    split_lines(f, data, len, FALSE, json_line, &c);
+}
+
+void framer_flush_lines(Framer *f, FrameFunc cb, gpointer user_data)
+{
+    if (!f->partial || f->partial->len == 0)
+        return;
+    FrameCtx c = { cb, user_data };
+    emit_line(f->partial->str, f->partial->len, json_line, &c);
+    g_string_truncate(f->partial, 0);
+}
+
+/* --- Server-Sent Events -------------------------------------------------- */
+
+typedef struct
+{
+    Framer   *f;
+    FrameFunc cb;
+    gpointer  user_data;
+} SseCtx;
+
+static void sse_line(gpointer ctx, const gchar *line, gsize len)
+{
+    SseCtx *c = (SseCtx *)ctx;
+    Framer *f = c->f;
+
+    if (len == 0)
+    {
+        /* Blank line: dispatch the event, if it carried data */
+        if (f->has_data)
+            c->cb(c->user_data, f->event->str, f->event->len);
+        g_string_truncate(f->event, 0);
+        f->has_data = FALSE;
+        return;
+    }
+
+    /* Only "data" matters here; ':' comments, event, id, retry are skipped */
+    if (len < 4 || memcmp(line, "data", 4) != 0)
+        return;
+    if (len == 4)
+    {
+        line += 4;
+        len = 0;
+    }
+    else if (line[4] == ':')
+    {
+        line += 5;
+        len -= 5;
+        if (len > 0 && *line == ' ')
+        {
+            line++;
+            len--;
+        }
+    }
+    else
+        return;
+
+    if (f->has_data)
+        g_string_append_c(f->event, '\n');
+    g_string_append_len(f->event, line, (gssize)len);
+    f->has_data = TRUE;
+}
+
+void framer_feed_sse(Framer *f, const gchar *data, gsize len,
+                     FrameFunc cb, gpointer user_data)
+{
+    SseCtx c = { f, cb, user_data };
+    if (!f->event)
+        f->event = g_string_new(NULL);
+    split_lines(f, data, len, TRUE, sse_line, &c);
+}
+
+void framer_clear(Framer *f)
+{
+    if (f->partial) g_string_free(f->partial, TRUE);
+    if (f->event)   g_string_free(f->event, TRUE);
+    f->partial = NULL;
+    f->event = NULL;
+    f->has_data = FALSE;
+    f->after_cr = FALSE;
+}
@@ -0,0 +1,43 @@
+/*
+ * framing.h — JSON-lines and SSE framing for streamed responses
+ */
+
+#ifndef FRAMING_H
+#define FRAMING_H
+
+#include <glib.h>
+
+/* One complete line (without its terminator) or one SSE event's data */
+typedef void (*FrameFunc)(gpointer user_data, const gchar *data, gsize len);
+
+/*
+ * Framing state kept between write callbacks. Zero-initialise it; the
+ * buffers are created on first use.
+ */
+typedef struct
+{
+    GString  *partial;    /* Incomplete trailing line of the last chunk */
+    GString  *event;      /* SSE: data lines of the event being read */
+    gboolean  has_data;   /* SSE: at least one data field seen */
+    gboolean  after_cr;   /* SSE: last chunk ended on '\r', skip a '\n' */
+} Framer;
+
+/* Report each complete '\n' or "\r\n" terminated line */
+void framer_feed_lines(Framer *f, const gchar *data, gsize len,
+                       FrameFunc cb, gpointer user_data);
+
+/* Report a last line that had no terminator (end of body) */
+void framer_flush_lines(Framer *f, FrameFunc cb, gpointer user_data);
+
+/*
+ * Report the data of each complete Server-Sent Event. Lines end with
+ * "\r\n", '\n' or '\r'; multiple data fields are joined with '\n';
+ * comments and other fields are skipped.
+ */
+void framer_feed_sse(Framer *f, const gchar *data, gsize len,
+                     FrameFunc cb, gpointer user_data);
+
+/* Free the buffers */
+void framer_clear(Framer *f);
+
+#endif /* FRAMING_H */
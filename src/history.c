@@ -1,28 +1,42 @@
 /*
  * history.c — Conversation history management for AI Chat plugin
+ *
+ * Messages are kept as a list, each with its raw text and its JSON-escaped
+ * form computed once when added, so a payload is one pass of copies into
+ * a buffer sized up front rather than a rebuilt string per turn. Messages
+ * never change once added and are shared, reference-counted, between a
+ * history and its copies. All on the main thread.
+ *
+ * The list also is the session's transcript: a reset only moves the start
+ * of what is sent to the model, and clearing the view moves the start of
+ * the transcript; messages before both are dropped. Some messages are
+ * only there for the transcript and are never sent.
  */
 
 #include "history.h"
 #include "prefs.h"
+#include "json_text.h"
 #include <string.h>
 
-static gchar *history_json = NULL;
+typedef struct
+{
+    ChatMessage m;
+    gint        refs;
+    gboolean    shown_only;   /* In the transcript, never sent */
+} Msg;
 
-const gchar* history_get_json(void)
+struct ChatHistory
 {
-    return history_json;
-}
+    GPtrArray *msgs;         /* Msg*, oldest first */
+    guint      ctx_start;    /* First message sent to the model */
+    guint      view_start;   /* First message of the transcript */
+};
 
 gchar* json_escape(const gchar *s)
 {
-    GString *g = g_string_new("");
-    for (const gchar *p = s; *p; ++p)
-    {
-        if (*p == '\\' || *p == '\"') g_string_append_c(g, '\\');
-        if (*p == '\n') g_string_append(g, "\\n");
-        else if (*p == '\r') g_string_append(g, "\\r");
-        else g_string_append_c(g, *p);
-    }
+    gsize len = strlen(s);
+    GString *g = g_string_sized_new(len + len / 8 + 16);
+    json_escape_append(g, s, (gssize)len);
     return g_string_free(g, FALSE);
 }
 
@@ -36,32 +50,171 @@ void json_append_double(GString *out, const char *key, double v)
         g_string_append(out, buf);
 }
 
-void history_add(const gchar *role, const gchar *content)
+/* --- Messages ------------------------------------------------------------ */
+
+static void msg_unref(gpointer data)
 {
-    gchar *esc = json_escape(content);
-    gchar *msg = g_strdup_printf("{\"role\":\"%s\",\"content\":\"%s\"}", role, esc);
-    g_free(esc);
+    Msg *msg = (Msg *)data;
+    if (--msg->refs > 0)
+        return;
+    g_free(msg->m.content);
+    g_free(msg->m.escaped);
+    g_free(msg);
+}
 
-    gchar *newhist = NULL;
-    if (g_strcmp0(history_json, "[]") == 0)
-        newhist = g_strdup_printf("[%s]", msg);
-    else
-        newhist = g_strdup_printf("%.*s,%s]", (int)strlen(history_json) - 1, history_json, msg);
+/* Drop what is neither in the context nor in the transcript */
+static void history_compact(ChatHistory *h)
+{
+    guint n = MIN(h->ctx_start, h->view_start);
+    if (n == 0)
+        return;
+    g_ptr_array_remove_range(h->msgs, 0, n);
+    h->ctx_start  -= n;
+    h->view_start -= n;
+}
 
-    g_free(history_json);
-    history_json = newhist;
-    g_free(msg);
+void history_add(ChatHistory *h, const gchar *role, const gchar *content)
+{
+    history_add_escaped(h, role, content, NULL);
+}
+
+static Msg* msg_add(ChatHistory *h, const gchar *role, const gchar *content,
+                    const gchar *escaped)
+{
+    Msg *msg = g_new0(Msg, 1);
+    msg->refs = 1;
+    msg->m.role    = g_intern_string(role);
+    msg->m.content = g_strdup(content);
+    msg->m.escaped = escaped ? g_strdup(escaped) : json_escape(content);
+    msg->m.size    = strlen(msg->m.escaped);
+    g_ptr_array_add(h->msgs, msg);
+    return msg;
 }
 
-void history_init(void)
+void history_add_escaped(ChatHistory *h, const gchar *role,
+                         const gchar *content, const gchar *escaped)
 {
-    g_free(history_json);
-    history_json = g_strdup("[]");
+    msg_add(h, role, content, escaped);
+}
+
+void history_add_shown(ChatHistory *h, const gchar *role,
+                       const gchar *content, const gchar *escaped)
+{
+    msg_add(h, role, content, escaped)->shown_only = TRUE;
+}
+
+/* --- Serialization ------------------------------------------------------- */
+
+#define MSG_HEAD  "{\"role\":\""
+#define MSG_MID   "\",\"content\":\""
+#define MSG_TAIL  "\"}"
+
+static gchar* put(gchar *p, const gchar *s, gsize n)
+{
+    memcpy(p, s, n);
+    return p + n;
+}
+
+void history_append_json(const ChatHistory *h, GString *out)
+{
+    /* Exact size first: one allocation, then plain copies */
+    gsize need = 2, n = 0;
+    for (guint i = h->ctx_start; i < h->msgs->len; i++)
+    {
+        const Msg *msg = g_ptr_array_index(h->msgs, i);
+        if (msg->shown_only)
+            continue;
+        need += (n++ > 0) + sizeof MSG_HEAD - 1 + strlen(msg->m.role) +
+                sizeof MSG_MID - 1 + msg->m.size + sizeof MSG_TAIL - 1;
+    }
+
+    gsize at = out->len;
+    g_string_set_size(out, at + need);
+    gchar *p = out->str + at;
+
+    *p++ = '[';
+    n = 0;
+    for (guint i = h->ctx_start; i < h->msgs->len; i++)
+    {
+        const Msg *msg = g_ptr_array_index(h->msgs, i);
+        const ChatMessage *m = &msg->m;
+        if (msg->shown_only)
+            continue;
+        if (n++ > 0)
+            *p++ = ',';
+        p = put(p, MSG_HEAD, sizeof MSG_HEAD - 1);
+        p = put(p, m->role, strlen(m->role));
+        p = put(p, MSG_MID, sizeof MSG_MID - 1);
+        p = put(p, m->escaped, m->size);
+        p = put(p, MSG_TAIL, sizeof MSG_TAIL - 1);
+    }
+    *p++ = ']';
+    g_assert(p == out->str + out->len);
+}
+
+/* --- Transcript ---------------------------------------------------------- */
+
+guint history_transcript_len(const ChatHistory *h)
+{
+    return h->msgs->len - h->view_start;
+}
+
+const ChatMessage* history_transcript_nth(const ChatHistory *h, guint i)
+{
+    g_return_val_if_fail(i < history_transcript_len(h), NULL);
+    return &((Msg *)g_ptr_array_index(h->msgs, h->view_start + i))->m;
+}
+
+void history_clear_transcript(ChatHistory *h)
+{
+    h->view_start = h->msgs->len;
+    history_compact(h);
+}
+
+/* --- Lifetime ------------------------------------------------------------ */
+
+void history_reset(ChatHistory *h)
+{
+    h->ctx_start = h->msgs->len;
+    history_compact(h);
     if (prefs.system_prompt && *prefs.system_prompt)
-        history_add("system", prefs.system_prompt);
+        history_add(h, "system", prefs.system_prompt);
+}
+
+ChatHistory* history_new(void)
+{
+    ChatHistory *h = g_new0(ChatHistory, 1);
+    h->msgs = g_ptr_array_new_with_free_func(msg_unref);
+    history_reset(h);
+    return h;
+}
+
+ChatHistory* history_copy(const ChatHistory *h)
+{
+    ChatHistory *c = g_new0(ChatHistory, 1);
+    c->msgs = g_ptr_array_new_with_free_func(msg_unref);
+    for (guint i = 0; i < h->msgs->len; i++)
+    {
+        Msg *msg = g_ptr_array_index(h->msgs, i);
+        msg->refs++;
+        g_ptr_array_add(c->msgs, msg);
+    }
+    c->ctx_start  = h->ctx_start;
+    c->view_start = h->view_start;
+    return c;
+}
+
+ChatHistory* history_context_copy(const ChatHistory *h)
+{
+    for (guint i = h->ctx_start; i < h->msgs->len; i++)
+        if (((Msg *)g_ptr_array_index(h->msgs, i))->shown_only)
+            return history_new();
+    return history_copy(h);
 }
 
-void history_free(void)
+void history_free(ChatHistory *h)
 {
-    g_clear_pointer(&history_json, g_free);
+    if (!h) return;
+    g_ptr_array_free(h->msgs, TRUE);
+    g_free(h);
 }
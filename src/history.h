@@ -7,19 +7,60 @@
 
 #include <glib.h>
 
-/* Get current history JSON string (read-only) */
-const gchar* history_get_json(void);
+/* One conversation's message list (each chat session owns one) */
+typedef struct ChatHistory ChatHistory;
 
-/* Initialize/reset history (includes system prompt if set) */
-void history_init(void);
+/* A message, unchanged once added (read-only) */
+typedef struct
+{
+    const gchar *role;      /* "system", "user" or "assistant" (interned) */
+    gchar       *content;   /* Raw text */
+    gchar       *escaped;   /* content JSON-escaped, as sent */
+    gsize        size;      /* strlen(escaped) */
+} ChatMessage;
+
+/* Create a history (includes system prompt if set) */
+ChatHistory* history_new(void);
+
+/* Independent copy of @h (a comparison's requests each answer on one) */
+ChatHistory* history_copy(const ChatHistory *h);
+
+/* Same, for a request that may go to an Ollama backend: when the context
+ * holds user turns that were never sent (OpenAI mode), only a fresh system
+ * prompt is kept rather than answers without their questions */
+ChatHistory* history_context_copy(const ChatHistory *h);
+
+/* Reset the context sent to the model (includes system prompt if set);
+ * earlier messages stay in the transcript */
+void history_reset(ChatHistory *h);
+
+/* Append the context as a JSON messages array to @out */
+void history_append_json(const ChatHistory *h, GString *out);
 
 /* Add a message to history */
-void history_add(const gchar *role, const gchar *content);
+void history_add(ChatHistory *h, const gchar *role, const gchar *content);
+
+/* Same, with @escaped the JSON-escaped @content when already at hand */
+void history_add_escaped(ChatHistory *h, const gchar *role,
+                         const gchar *content, const gchar *escaped);
+
+/* Same, for the transcript only: never part of the context sent (a
+ * prompt the OpenAI mode sends on its own) */
+void history_add_shown(ChatHistory *h, const gchar *role,
+                       const gchar *content, const gchar *escaped);
+
+/* Messages shown in the session since it began or since the last
+ * history_clear_transcript(), across resets, system prompts included */
+guint history_transcript_len(const ChatHistory *h);
+const ChatMessage* history_transcript_nth(const ChatHistory *h, guint i);
+
+/* The view was cleared: start the transcript afresh (context unchanged) */
+void history_clear_transcript(ChatHistory *h);
 
 /* Free history resources */
-void history_free(void);
+void history_free(ChatHistory *h);
 
-/* JSON escape utility (also used by network module) */
+/* JSON escape utility, spec-complete (also used by network module) */
 gchar* json_escape(const gchar *s);
 
 /* Serialize double with ASCII dot (locale-independent) */
@@ -0,0 +1,563 @@
+/*
+ * json_stream.c — Resumable JSON tokenizer for streamed responses
+ *
+ * A byte-at-a-time state machine: all state (container stack, current
+ * path, pending escape) lives in the JsonStream, so a chunk may end
+ * anywhere. Plain runs inside watched streamed strings are handed to the
+ * callback straight from the input, without copying.
+ */
+
+#include "json_stream.h"
+#include "json_text.h"
+#include <string.h>
+
+#define JS_MAX_DEPTH 64
+
+typedef enum
+{
+    S_VALUE,          /* Expecting a value */
+    S_VALUE_OR_END,   /* After '[': value or ']' */
+    S_KEY,            /* After ',' in an object: '"' */
+    S_KEY_OR_END,     /* After '{': '"' or '}' */
+    S_COLON,          /* After a key: ':' */
+    S_AFTER_VALUE,    /* ',' or closing bracket */
+    S_STRING,         /* Inside a string (key or value) */
+    S_ESCAPE,         /* After '\' */
+    S_UNICODE,        /* Reading the 4 hex digits of \uXXXX */
+    S_SURROGATE_BS,   /* High surrogate read, expecting '\' */
+    S_SURROGATE_U,    /* High surrogate read, expecting 'u' */
+    S_SCALAR,         /* Number, true, false or null */
+    S_ERROR           /* Syntax error: ignore input until reset */
+} JsState;
+
+typedef struct
+{
+    gchar    *path;
+    gsize     path_len;
+    gint      field;
+    gboolean  streamed;
+    gboolean  wild;       /* Path contains '*' */
+} Watch;
+
+struct JsonStream
+{
+    JsonChunkFunc on_chunk;
+    JsonValueFunc on_value;
+    gpointer      user_data;
+    GArray       *watches;     /* Watch */
+
+    JsState  state;
+    gint     depth;
+    gchar    kind[JS_MAX_DEPTH];   /* '{' or '[' per open container */
+    gsize    base[JS_MAX_DEPTH];   /* Path length when it was opened */
+    gint     cwatch[JS_MAX_DEPTH]; /* Watch index of the container, or -1 */
+    GString *path;                 /* Path of the current value or key */
+    GString *buf;                  /* Watched string or scalar */
+    GString *scratch;              /* Streamed pieces around escapes */
+    gboolean in_key;
+    const Watch *cur;              /* Watch of the current value, if any */
+
+    guint32  hex;                  /* \uXXXX being read */
+    gint     hex_n;
+    guint32  high;                 /* Pending high surrogate */
+};
+
+/* --- Helpers ------------------------------------------------------------- */
+
+static inline gboolean is_ws(gchar c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static int hexval(gchar c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
+    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
+    return -1;
+}
+
+/* '*' matches any run of bytes; everything else matches itself */
+static gboolean glob_match(const gchar *pat, const gchar *s, gsize n)
+{
+    const gchar *star = NULL;
+    gsize i = 0, back = 0;
+
+    while (i < n)
+    {
+        if (*pat == '*')
+        {
+            star = ++pat;
+            back = i;
+        }
+        else if (*pat && *pat == s[i])
+        {
+            pat++;
+            i++;
+        }
+        else if (star)
+        {
+            pat = star;
+            i = ++back;
+        }
+        else
+            return FALSE;
+    }
+    while (*pat == '*')
+        pat++;
+    return *pat == '\0';
+}
+
+static const Watch* lookup_watch(JsonStream *js)
+{
+    for (guint i = 0; i < js->watches->len; i++)
+    {
+        const Watch *w = &g_array_index(js->watches, Watch, i);
+        if (w->wild ? glob_match(w->path, js->path->str, js->path->len)
+                    : (w->path_len == js->path->len &&
+                       memcmp(w->path, js->path->str, w->path_len) == 0))
+            return w;
+    }
+    return NULL;
+}
+
+/* Decoded string bytes go to the path, the callback, the buffer or nowhere */
+static inline void string_out(JsonStream *js, const gchar *s, gsize n)
+{
+    if (n == 0)
+        return;
+    if (js->in_key)
+        g_string_append_len(js->path, s, (gssize)n);
+    else if (js->cur && js->cur->streamed)
+    {
+        if (js->on_chunk)
+            js->on_chunk(js->user_data, js->cur->field, s, n);
+    }
+    else if (js->cur)
+        g_string_append_len(js->buf, s, (gssize)n);
+}
+
+/* Where decoded bytes of the current string are gathered, if anywhere */
+static inline GString* string_sink(JsonStream *js)
+{
+    if (js->in_key)
+        return js->path;
+    if (js->cur && js->cur->streamed)
+        return js->on_chunk ? js->scratch : NULL;
+    return js->cur ? js->buf : NULL;
+}
+
+/* Byte for a one-letter escape; 0 for \u and anything unexpected */
+static inline gchar short_escape(gchar c)
+{
+    switch (c)
+    {
+        case '"':  return '"';
+        case '\\': return '\\';
+        case '/':  return '/';
+        case 'b':  return '\b';
+        case 'f':  return '\f';
+        case 'n':  return '\n';
+        case 'r':  return '\r';
+        case 't':  return '\t';
+        default:   return 0;
+    }
+}
+
+static void string_out_cp(JsonStream *js, guint32 cp)
+{
+    gchar out[6];
+    if (cp == 0 || cp > 0x10FFFF)
+        cp = 0xFFFD;
+    string_out(js, out, (gsize)g_unichar_to_utf8(cp, out));
+}
+
+static void fail(JsonStream *js)
+{
+    js->state = S_ERROR;
+}
+
+static void push(JsonStream *js, gchar kind)
+{
+    if (js->depth >= JS_MAX_DEPTH)
+    {
+        fail(js);
+        return;
+    }
+    const Watch *w = lookup_watch(js);
+    js->cwatch[js->depth] = w ? (gint)(w - (const Watch *)(gpointer)js->watches->data) : -1;
+    js->kind[js->depth] = kind;
+    js->base[js->depth] = js->path->len;
+    js->depth++;
+    if (kind == '[')
+        g_string_append(js->path, "[]");
+    js->cur = NULL;
+    js->state = (kind == '{') ? S_KEY_OR_END : S_VALUE_OR_END;
+}
+
+/* A value (or a whole container) has ended */
+static void value_done(JsonStream *js)
+{
+    js->cur = NULL;
+    if (js->depth == 0)
+    {
+        /* Top-level document complete; another one may follow */
+        g_string_truncate(js->path, 0);
+        js->state = S_VALUE;
+    }
+    else
+        js->state = S_AFTER_VALUE;
+}
+
+static void pop(JsonStream *js, gchar kind)
+{
+    if (js->depth == 0 || js->kind[js->depth - 1] != kind)
+    {
+        fail(js);
+        return;
+    }
+    js->depth--;
+    g_string_truncate(js->path, js->base[js->depth]);
+    value_done(js);
+
+    gint wi = js->cwatch[js->depth];
+    if (wi >= 0 && js->on_value)
+        js->on_value(js->user_data, g_array_index(js->watches, Watch, wi).field,
+                     kind == '{' ? JSON_VALUE_OBJECT : JSON_VALUE_ARRAY, "", 0);
+}
+
+/* Keys are decoded straight onto the path of their object */
+static void key_start(JsonStream *js)
+{
+    gsize base = js->base[js->depth - 1];
+    g_string_truncate(js->path, base);
+    if (base > 0)
+        g_string_append_c(js->path, '.');
+    js->in_key = TRUE;
+    js->state = S_STRING;
+}
+
+static void string_done(JsonStream *js)
+{
+    if (js->in_key)
+    {
+        js->in_key = FALSE;
+        js->state = S_COLON;
+        return;
+    }
+    if (js->cur && !js->cur->streamed && js->on_value)
+        js->on_value(js->user_data, js->cur->field, JSON_VALUE_STRING,
+                     js->buf->str, js->buf->len);
+    value_done(js);
+}
+
+static void scalar_done(JsonStream *js)
+{
+    if (js->cur && js->on_value)
+    {
+        JsonValueType type;
+        switch (js->buf->str[0])
+        {
+            case 't': type = JSON_VALUE_TRUE;   break;
+            case 'f': type = JSON_VALUE_FALSE;  break;
+            case 'n': type = JSON_VALUE_NULL;   break;
+            default:  type = JSON_VALUE_NUMBER; break;
+        }
+        js->on_value(js->user_data, js->cur->field, type,
+                     js->buf->str, js->buf->len);
+    }
+    value_done(js);
+}
+
+/* Four hex digits of a \u escape have been read */
+static void unicode_done(JsonStream *js)
+{
+    guint32 u = js->hex;
+
+    if (js->high)
+    {
+        guint32 high = js->high;
+        js->high = 0;
+        if (u >= 0xDC00 && u <= 0xDFFF)
+        {
+            string_out_cp(js, 0x10000 + (((high - 0xD800) << 10) | (u - 0xDC00)));
+            js->state = S_STRING;
+            return;
+        }
+        string_out_cp(js, 0xFFFD);
+    }
+
+    if (u >= 0xD800 && u <= 0xDBFF)
+    {
+        js->high = u;
+        js->state = S_SURROGATE_BS;
+        return;
+    }
+    string_out_cp(js, (u >= 0xDC00 && u <= 0xDFFF) ? 0xFFFD : u);
+    js->state = S_STRING;
+}
+
+/* --- Tokenizer ----------------------------------------------------------- */
+
+void json_stream_feed(JsonStream *js, const gchar *data, gsize len)
+{
+    gsize i = 0;
+
+    while (i < len)
+    {
+        gchar c = data[i];
+
+        switch (js->state)
+        {
+            case S_ERROR:
+                return;
+
+            case S_VALUE_OR_END:
+                if (is_ws(c)) { i++; break; }
+                if (c == ']') { i++; pop(js, '['); break; }
+                js->state = S_VALUE;
+                /* fall through */
+            case S_VALUE:
+                if (is_ws(c)) { i++; break; }
+                i++;
+                if (c == '{')
+                    push(js, '{');
+                else if (c == '[')
+                    push(js, '[');
+                else if (c == '"')
+                {
+                    js->cur = lookup_watch(js);
+                    if (js->cur)
+                        g_string_truncate(js->buf, 0);
+                    js->state = S_STRING;
+                }
+                else if (c == '-' || (c >= '0' && c <= '9') ||
+                         c == 't' || c == 'f' || c == 'n')
+                {
+                    js->cur = lookup_watch(js);
+                    if (js->cur)
+                    {
+                        g_string_truncate(js->buf, 0);
+                        g_string_append_c(js->buf, c);
+                    }
+                    js->state = S_SCALAR;
+                }
+                else
+                    fail(js);
+                break;
+
+            case S_KEY_OR_END:
+                if (is_ws(c)) { i++; break; }
+                if (c == '}') { i++; pop(js, '{'); break; }
+                js->state = S_KEY;
+                /* fall through */
+            case S_KEY:
+                if (is_ws(c)) { i++; break; }
+                i++;
+                if (c != '"') { fail(js); break; }
+                key_start(js);
+                break;
+
+            case S_COLON:
+                i++;
+                if (is_ws(c)) break;
+                if (c == ':') js->state = S_VALUE;
+                else fail(js);
+                break;
+
+            case S_AFTER_VALUE:
+                i++;
+                if (is_ws(c)) break;
+                if (c == ',')
+                    js->state = (js->kind[js->depth - 1] == '{') ? S_KEY : S_VALUE;
+                else if (c == '}' || c == ']')
+                    pop(js, c == '}' ? '{' : '[');
+                else
+                    fail(js);
+                break;
+
+            case S_STRING:
+            {
+                /* Runs without quote or backslash go out as they are. When
+                 * short escapes sit between runs they are decoded inline
+                 * and a streamed string is gathered in the scratch buffer,
+                 * so the callback still runs once. */
+                const gchar *run = data + i;
+                gsize n = json_scan_string(run, len - i);
+                gchar e;
+                if (i + n + 1 < len && run[n] == '\\' &&
+                    (e = short_escape(run[n + 1])) != 0)
+                {
+                    GString *dst = string_sink(js);
+                    do
+                    {
+                        if (dst)
+                        {
+                            g_string_append_len(dst, run, (gssize)n);
+                            g_string_append_c(dst, e);
+                        }
+                        i += n + 2;
+                        run = data + i;
+                        n = json_scan_string(run, len - i);
+                    } while (i + n + 1 < len && run[n] == '\\' &&
+                             (e = short_escape(run[n + 1])) != 0);
+                    if (dst)
+                        g_string_append_len(dst, run, (gssize)n);
+                    if (dst == js->scratch && dst)
+                    {
+                        js->on_chunk(js->user_data, js->cur->field,
+                                     dst->str, dst->len);
+                        g_string_truncate(dst, 0);
+                    }
+                }
+                else
+                    string_out(js, run, n);
+                i += n;
+                if (i == len)
+                    break;
+                if (data[i++] == '"')
+                    string_done(js);
+                else
+                    js->state = S_ESCAPE;
+                break;
+            }
+
+            case S_ESCAPE:
+            {
+                gchar out;
+                i++;
+                if (c == 'u')
+                {
+                    js->hex = 0;
+                    js->hex_n = 0;
+                    js->state = S_UNICODE;
+                    break;
+                }
+                out = short_escape(c);
+                if (!out)
+                    out = c;   /* Lenient on unknown escapes */
+                string_out(js, &out, 1);
+                js->state = S_STRING;
+                break;
+            }
+
+            case S_UNICODE:
+            {
+                int h = hexval(c);
+                if (h < 0)
+                {
+                    /* Broken escape: replace it and rescan this byte */
+                    js->high = 0;
+                    string_out_cp(js, 0xFFFD);
+                    js->state = S_STRING;
+                    break;
+                }
+                i++;
+                js->hex = (js->hex << 4) | (guint32)h;
+                if (++js->hex_n == 4)
+                    unicode_done(js);
+                break;
+            }
+
+            case S_SURROGATE_BS:
+                if (c == '\\') { i++; js->state = S_SURROGATE_U; break; }
+                js->high = 0;
+                string_out_cp(js, 0xFFFD);
+                js->state = S_STRING;
+                break;
+
+            case S_SURROGATE_U:
+                if (c == 'u')
+                {
+                    i++;
+                    js->hex = 0;
+                    js->hex_n = 0;
+                    js->state = S_UNICODE;
+                    break;
+                }
+                /* Lone high surrogate followed by another escape */
+                js->high = 0;
+                string_out_cp(js, 0xFFFD);
+                js->state = S_ESCAPE;
+                break;
+
+            case S_SCALAR:
+            {
+                gsize start = i;
+                while (i < len && (g_ascii_isalnum(data[i]) || data[i] == '.' ||
+                                   data[i] == '+' || data[i] == '-'))
+                    i++;
+                if (js->cur)
+                    g_string_append_len(js->buf, data + start, (gssize)(i - start));
+                if (i == len)
+                    break;
+                c = data[i];
+                if (c == ',' || c == '}' || c == ']' || is_ws(c))
+                    scalar_done(js);   /* Delimiter is handled next round */
+                else
+                    fail(js);
+                break;
+            }
+        }
+    }
+}
+
+/* --- Public API ---------------------------------------------------------- */
+
+JsonStream* json_stream_new(JsonChunkFunc on_chunk, JsonValueFunc on_value,
+                            gpointer user_data)
+{
+    JsonStream *js = g_new0(JsonStream, 1);
+    js->on_chunk = on_chunk;
+    js->on_value = on_value;
+    js->user_data = user_data;
+    js->watches = g_array_new(FALSE, TRUE, sizeof(Watch));
+    js->path = g_string_sized_new(64);
+    js->buf = g_string_sized_new(64);
+    js->scratch = g_string_sized_new(256);
+    js->state = S_VALUE;
+    return js;
+}
+
+void json_stream_free(JsonStream *js)
+{
+    if (!js) return;
+    for (guint i = 0; i < js->watches->len; i++)
+        g_free(g_array_index(js->watches, Watch, i).path);
+    g_array_free(js->watches, TRUE);
+    g_string_free(js->path, TRUE);
+    g_string_free(js->buf, TRUE);
+    g_string_free(js->scratch, TRUE);
+    g_free(js);
+}
+
+void json_stream_watch(JsonStream *js, const gchar *path, gint field,
+                       gboolean streamed)
+{
+    Watch w;
+    w.path = g_strdup(path);
+    w.path_len = strlen(path);
+    w.field = field;
+    w.streamed = streamed;
+    w.wild = strchr(path, '*') != NULL;
+    g_array_append_val(js->watches, w);
+    js->cur = NULL;   /* The array may have moved */
+}
+
+void json_stream_reset(JsonStream *js)
+{
+    js->state = S_VALUE;
+    js->depth = 0;
+    js->in_key = FALSE;
+    js->cur = NULL;
+    js->hex = 0;
+    js->hex_n = 0;
+    js->high = 0;
+    g_string_truncate(js->path, 0);
+    g_string_truncate(js->buf, 0);
+}
+
+gboolean json_stream_failed(const JsonStream *js)
+{
+    return js->state == S_ERROR;
+}
@@ -0,0 +1,63 @@
+/*
+ * json_stream.h — Resumable JSON tokenizer for streamed responses
+ *
+ * Bytes can be fed in arbitrary chunks (a token, an escape sequence or a
+ * surrogate pair may be split anywhere). Only values at watched paths are
+ * reported; everything else is skipped in the same single pass.
+ *
+ * Path syntax: object keys joined with '.', "[]" for any array element,
+ * e.g. "message.content", "choices[].delta.content", "done". A '*' in a
+ * watched path matches any run of characters, so "model_info.*.ctx"
+ * catches keys that themselves contain dots.
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include <glib.h>
+
+typedef enum
+{
+    JSON_VALUE_STRING,
+    JSON_VALUE_NUMBER,
+    JSON_VALUE_TRUE,
+    JSON_VALUE_FALSE,
+    JSON_VALUE_NULL,
+    JSON_VALUE_OBJECT,   /* Watched container closed; text is empty */
+    JSON_VALUE_ARRAY
+} JsonValueType;
+
+/* Decoded piece of a streamed string value (may be called many times) */
+typedef void (*JsonChunkFunc)(gpointer user_data, gint field,
+                              const gchar *text, gsize len);
+
+/* Complete scalar (or non-streamed string, decoded) value */
+typedef void (*JsonValueFunc)(gpointer user_data, gint field,
+                              JsonValueType type, const gchar *text, gsize len);
+
+typedef struct JsonStream JsonStream;
+
+JsonStream* json_stream_new(JsonChunkFunc on_chunk, JsonValueFunc on_value,
+                            gpointer user_data);
+void json_stream_free(JsonStream *js);
+
+/*
+ * Report the value at @path as @field. String values of streamed fields go
+ * to on_chunk as they are decoded; all other values go to on_value once
+ * complete. Objects and arrays at a watched path are reported when they
+ * close, after their members: watching "models[]" marks the end of each
+ * element.
+ */
+void json_stream_watch(JsonStream *js, const gchar *path, gint field,
+                       gboolean streamed);
+
+/* Feed the next bytes; several top-level values may follow each other */
+void json_stream_feed(JsonStream *js, const gchar *data, gsize len);
+
+/* Forget any partial document (keeps watches), e.g. after a syntax error */
+void json_stream_reset(JsonStream *js);
+
+/* TRUE if a syntax error was hit since the last reset */
+gboolean json_stream_failed(const JsonStream *js);
+
+#endif /* JSON_STREAM_H */
@@ -0,0 +1,201 @@
+/*
+ * json_text.c — Vectorized JSON string escaping and scanning
+ *
+ * Both operations come down to "find the next byte that is special" and
+ * copy everything before it in one go. The search looks at 32 (AVX2) or
+ * 16 (SSE2) bytes per step; the AVX2 kernel is picked at run time, SSE2
+ * is always there on x86-64, and other targets use the scalar loop.
+ * Build with -DJSON_TEXT_SCALAR to force the scalar kernel.
+ */
+
+#include "json_text.h"
+#include <string.h>
+
+#if !defined(JSON_TEXT_SCALAR) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define JSON_TEXT_X86 1
+#include <immintrin.h>
+#endif
+
+/* Scan for '"', '\' and, when @ctl, bytes below 0x20 */
+typedef gsize (*ScanFunc)(const guchar *s, gsize n, gboolean ctl);
+
+/* --- Scalar kernel ------------------------------------------------------- */
+
+static inline gboolean is_special(guchar c, gboolean ctl)
+{
+    return c == '"' || c == '\\' || (ctl && c < 0x20);
+}
+
+static gsize scan_scalar(const guchar *s, gsize n, gboolean ctl)
+{
+    gsize i = 0;
+    while (i < n && !is_special(s[i], ctl))
+        i++;
+    return i;
+}
+
+/* --- SSE2 / AVX2 kernels ------------------------------------------------- */
+
+#ifdef JSON_TEXT_X86
+
+static gsize scan_sse2(const guchar *s, gsize n, gboolean ctl)
+{
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i bslash = _mm_set1_epi8('\\');
+    const __m128i ctl_max = _mm_set1_epi8(0x1F);
+    gsize i = 0;
+
+    for (; i + 16 <= n; i += 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(s + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                 _mm_cmpeq_epi8(v, bslash));
+        if (ctl)   /* v <= 0x1F, unsigned: max(v, 0x1F) == 0x1F */
+            m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctl_max),
+                                               ctl_max));
+        int mask = _mm_movemask_epi8(m);
+        if (mask)
+            return i + (gsize)__builtin_ctz((unsigned)mask);
+    }
+    return i + scan_scalar(s + i, n - i, ctl);
+}
+
+__attribute__((target("avx2")))
+static gsize scan_avx2_long(const guchar *s, gsize n, gboolean ctl)
+{
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i bslash = _mm256_set1_epi8('\\');
+    const __m256i ctl_max = _mm256_set1_epi8(0x1F);
+    gsize i = 0;
+
+    for (; i + 32 <= n; i += 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(s + i));
+        __m256i m = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote),
+                                    _mm256_cmpeq_epi8(v, bslash));
+        if (ctl)
+            m = _mm256_or_si256(m, _mm256_cmpeq_epi8(_mm256_max_epu8(v, ctl_max),
+                                                     ctl_max));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(m);
+        if (mask)
+            return i + (gsize)__builtin_ctz(mask);
+    }
+    return i + scan_sse2(s + i, n - i, ctl);
+}
+
+/*
+ * Most JSON strings (keys, tokens) end within a few bytes, and entering
+ * 256-bit code has a fixed cost: stay on SSE2 for the head and only hand
+ * long runs to AVX2.
+ */
+static gsize scan_avx2(const guchar *s, gsize n, gboolean ctl)
+{
+    gsize head = MIN(n, 64);
+    gsize i = scan_sse2(s, head, ctl);
+    if (i < head || head == n)
+        return i;
+    return head + scan_avx2_long(s + head, n - head, ctl);
+}
+
+#endif /* JSON_TEXT_X86 */
+
+/* --- Dispatch ------------------------------------------------------------ */
+
+static ScanFunc     scan_impl = NULL;
+static const gchar *scan_name = "scalar";
+
+static ScanFunc pick_kernel(void)
+{
+    static gsize once = 0;
+    if (g_once_init_enter(&once))
+    {
+        ScanFunc f = scan_scalar;
+#ifdef JSON_TEXT_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+        {
+            f = scan_avx2;
+            scan_name = "avx2";
+        }
+        else
+        {
+            f = scan_sse2;
+            scan_name = "sse2";
+        }
+#endif
+        scan_impl = f;
+        g_once_init_leave(&once, 1);
+    }
+    return scan_impl;
+}
+
+static inline gsize scan(const gchar *s, gsize n, gboolean ctl)
+{
+    ScanFunc f = g_atomic_pointer_get(&scan_impl);
+    if (G_UNLIKELY(!f))
+        f = pick_kernel();
+    return f((const guchar *)s, n, ctl);
+}
+
+const gchar* json_text_kernel(void)
+{
+    pick_kernel();
+    return scan_name;
+}
+
+/* --- Public API ---------------------------------------------------------- */
+
+gsize json_scan_string(const gchar *s, gsize len)
+{
+    return scan(s, len, FALSE);
+}
+
+void json_escape_append(GString *out, const gchar *s, gssize len)
+{
+    static const gchar hex[] = "0123456789abcdef";
+    gsize n = len < 0 ? strlen(s) : (gsize)len;
+
+    while (n > 0)
+    {
+        /* Work in blocks so the worst case (6 bytes per input byte) can be
+         * reserved up front and written without per-escape bound checks */
+        gsize block = MIN(n, 4096);
+        gsize base = out->len;
+        g_string_set_size(out, base + block * 6);
+        gchar *w = out->str + base;
+        const gchar *end = s + block;
+
+        while (s < end)
+        {
+            gsize run = scan(s, (gsize)(end - s), TRUE);
+            memcpy(w, s, run);
+            w += run;
+            s += run;
+            if (s == end)
+                break;
+
+            guchar c = (guchar)*s++;
+            *w++ = '\\';
+            switch (c)
+            {
+                case '"':  *w++ = '"';  break;
+                case '\\': *w++ = '\\'; break;
+                case '\n': *w++ = 'n';  break;
+                case '\r': *w++ = 'r';  break;
+                case '\t': *w++ = 't';  break;
+                case '\b': *w++ = 'b';  break;
+                case '\f': *w++ = 'f';  break;
+                default:
+                    *w++ = 'u';
+                    *w++ = '0';
+                    *w++ = '0';
+                    *w++ = hex[c >> 4];
+                    *w++ = hex[c & 0xF];
+                    break;
+            }
+        }
+        g_string_truncate(out, (gsize)(w - out->str));
+        n -= block;
+    }
+}
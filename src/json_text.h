@@ -0,0 +1,23 @@
+/*
+ * json_text.h — Vectorized JSON string escaping and scanning
+ */
+
+#ifndef JSON_TEXT_H
+#define JSON_TEXT_H
+
+#include <glib.h>
+
+/*
+ * Append @s (@len bytes, or NUL-terminated if @len < 0) to @out as the
+ * body of a JSON string: '"' and '\' are backslash-escaped, \n \r \t \b \f
+ * use their short forms and other control characters become \u00XX.
+ */
+void json_escape_append(GString *out, const gchar *s, gssize len);
+
+/* Length of the leading run of @s without '"' or '\' */
+gsize json_scan_string(const gchar *s, gsize len);
+
+/* Kernel picked for this CPU: "avx2", "sse2" or "scalar" */
+const gchar* json_text_kernel(void);
+
+#endif /* JSON_TEXT_H */
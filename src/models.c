@@ -1,20 +1,28 @@
 /*
- * models.c — Model list fetching for AI Chat plugin
+ * models.c — Model catalog for AI Chat plugin
+ *
+ * One catalog per backend (API and base URL), kept in memory and in
+ * ai_chat_models.conf next to the settings, so the model list is there
+ * at startup before any request. A catalog is revalidated once it is
+ * older than MODELS_TTL_US, with If-None-Match when the backend gave an
+ * ETag; callers asking while a fetch runs wait for that fetch. Ollama
+ * models are then described one by one with /api/show (context length),
+ * and those results are kept for as long as the model's digest holds.
+ * A backend with a pool of base URLs gets the union of its members'
+ * catalogs, each member's kept and revalidated on its own.
  */
 
 #include "models.h"
+#include "endpoints.h"
+#include "netpool.h"
+#include "netloop.h"
+#include "stats.h"
+#include "json_stream.h"
+#include "json_text.h"
 #include <curl/curl.h>
 #include <string.h>
 
-/* --- Request context ----------------------------------------------------- */
-
-typedef struct {
-    ApiMode mode;
-    gchar *base_url;
-    gchar *api_key;
-    ModelsFetchedCallback callback;
-    gpointer user_data;
-} FetchCtx;
+#define MODELS_TTL_US (10 * 60 * G_USEC_PER_SEC)
 
 /* --- Memory buffer for curl ---------------------------------------------- */
 
@@ -36,194 +44,749 @@ static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *ud)
     return realsize;
 }
 
-/* --- Simple JSON parsing for model names --------------------------------- */
+/* --- Model info ---------------------------------------------------------- */
 
-/*
- * Parse Ollama response: {"models": [{"name": "llama3:8b", ...}, ...]}
- * Returns GList of model names (gchar*)
- */
-static GList* parse_ollama_models(const char *json)
+static void model_info_free(gpointer p)
 {
-    GList *list = NULL;
-    if (!json) return NULL;
+    ModelInfo *m = (ModelInfo *)p;
+    if (!m) return;
+    g_free(m->name);
+    g_free(m->parameter_size);
+    g_free(m->quantization);
+    g_free(m->digest);
+    g_free(m);
+}
 
-    /* Find "models" array */
-    const char *models = strstr(json, "\"models\"");
-    if (!models) return NULL;
+static GPtrArray* model_list_new(void)
+{
+    return g_ptr_array_new_with_free_func(model_info_free);
+}
 
-    const char *arr_start = strchr(models, '[');
-    if (!arr_start) return NULL;
+/* --- Catalogs (main thread) ---------------------------------------------- */
 
-    const char *p = arr_start + 1;
-    while (*p)
-    {
-        /* Find "name" field */
-        const char *name_key = strstr(p, "\"name\"");
-        if (!name_key) break;
+/* Catalogs of a pool being refreshed for one caller */
+typedef struct
+{
+    ModelsFetchedCallback cb;
+    gpointer              user_data;
+    ApiMode               mode;
+    gchar               **urls;      /* Members, base URL first */
+    gint                  pending;   /* Members still fetching */
+    gboolean              served;    /* Caller already had the union */
+    gboolean              changed;   /* Some member's list changed */
+} Merge;
+
+typedef struct
+{
+    ModelsFetchedCallback cb;
+    gpointer              user_data;
+    gboolean              served;   /* Already had the cached list */
+    Merge                *merge;    /* Member of a pool: report there instead */
+} Waiter;
 
-        const char *colon = strchr(name_key + 6, ':');
-        if (!colon) break;
+typedef struct
+{
+    gchar     *key;        /* "<mode> <base_url>" */
+    ApiMode    mode;
+    gchar     *base_url;
+    gchar     *unix_socket; /* From the last fetch request, "" = TCP */
+    GPtrArray *models;     /* ModelInfo*, NULL until known */
+    gchar     *etag;
+    gint64     fetched;    /* Real time of the last answer, µs */
+    gboolean   fetching;
+    GSList    *waiters;    /* Waiter* */
+    gboolean   showing;    /* /api/show walk in progress */
+    guint      show_pos;   /* Next model it looks at */
+} Catalog;
+
+static GHashTable *catalogs = NULL;   /* key -> Catalog* */
+
+static void catalog_free(gpointer p)
+{
+    Catalog *cat = (Catalog *)p;
+    g_free(cat->key);
+    g_free(cat->base_url);
+    g_free(cat->unix_socket);
+    if (cat->models) g_ptr_array_unref(cat->models);
+    g_free(cat->etag);
+    g_slist_free_full(cat->waiters, g_free);
+    g_free(cat);
+}
 
-        /* Skip whitespace and find opening quote */
-        const char *q = colon + 1;
-        while (*q == ' ' || *q == '\t') q++;
-        if (*q != '"') { p = q; continue; }
+static gchar* catalog_key(ApiMode mode, const gchar *base_url)
+{
+    return g_strdup_printf("%d %s", (gint)mode, base_url);
+}
+
+static gchar* cache_path(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "geany",
+                            "ai_chat_models.conf", NULL);
+}
+
+static Catalog* catalog_add(ApiMode mode, const gchar *base_url)
+{
+    Catalog *cat = g_new0(Catalog, 1);
+    cat->key = catalog_key(mode, base_url);
+    cat->mode = mode;
+    cat->base_url = g_strdup(base_url);
+    g_hash_table_insert(catalogs, cat->key, cat);
+    return cat;
+}
+
+static void load_catalog(GKeyFile *kf, const gchar *group)
+{
+    gchar *url = g_key_file_get_string(kf, group, "url", NULL);
+    if (!url)
+        return;
+    ApiMode mode = (ApiMode)g_key_file_get_integer(kf, group, "mode", NULL);
+    Catalog *cat = catalog_add(mode, url);
+    g_free(url);
 
-        q++; /* skip opening quote */
-        const char *end = strchr(q, '"');
-        if (!end) break;
+    cat->etag = g_key_file_get_string(kf, group, "etag", NULL);
+    cat->fetched = g_key_file_get_int64(kf, group, "fetched", NULL);
 
-        gchar *name = g_strndup(q, end - q);
-        list = g_list_append(list, name);
+    gint count = g_key_file_get_integer(kf, group, "count", NULL);
+    cat->models = model_list_new();
+    for (gint i = 0; i < count; i++)
+    {
+        gchar *k_name = g_strdup_printf("model_%d_name", i);
+        gchar *k_size = g_strdup_printf("model_%d_size", i);
+        gchar *k_params = g_strdup_printf("model_%d_params", i);
+        gchar *k_quant = g_strdup_printf("model_%d_quant", i);
+        gchar *k_ctx = g_strdup_printf("model_%d_ctx", i);
+        gchar *k_digest = g_strdup_printf("model_%d_digest", i);
+
+        ModelInfo *m = g_new0(ModelInfo, 1);
+        m->name = g_key_file_get_string(kf, group, k_name, NULL);
+        m->size = g_key_file_get_int64(kf, group, k_size, NULL);
+        m->parameter_size = g_key_file_get_string(kf, group, k_params, NULL);
+        m->quantization = g_key_file_get_string(kf, group, k_quant, NULL);
+        m->context_length = g_key_file_get_int64(kf, group, k_ctx, NULL);
+        m->digest = g_key_file_get_string(kf, group, k_digest, NULL);
+        if (m->name)
+            g_ptr_array_add(cat->models, m);
+        else
+            model_info_free(m);
+
+        g_free(k_name);
+        g_free(k_size);
+        g_free(k_params);
+        g_free(k_quant);
+        g_free(k_ctx);
+        g_free(k_digest);
+    }
+}
 
-        p = end + 1;
+static void catalogs_load(void)
+{
+    if (catalogs)
+        return;
+    catalogs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, catalog_free);
 
-        /* Check for end of array or next object */
-        while (*p && *p != ',' && *p != ']') p++;
-        if (*p == ']') break;
-        if (*p == ',') p++;
+    GKeyFile *kf = g_key_file_new();
+    gchar *path = cache_path();
+    if (g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, NULL))
+    {
+        gchar **groups = g_key_file_get_groups(kf, NULL);
+        for (gchar **g = groups; g && *g; g++)
+            load_catalog(kf, *g);
+        g_strfreev(groups);
     }
+    g_free(path);
+    g_key_file_free(kf);
+}
 
-    return list;
+static void set_opt_string(GKeyFile *kf, const gchar *group,
+                           const gchar *key, const gchar *value)
+{
+    if (value)
+        g_key_file_set_string(kf, group, key, value);
 }
 
-/*
- * Parse OpenAI response: {"data": [{"id": "gpt-4", ...}, ...]}
- * Returns GList of model IDs (gchar*)
- */
-static GList* parse_openai_models(const char *json)
+static void catalogs_save(void)
 {
-    GList *list = NULL;
-    if (!json) return NULL;
+    GKeyFile *kf = g_key_file_new();
+    GHashTableIter it;
+    gpointer v;
+    guint n = 0;
+
+    g_hash_table_iter_init(&it, catalogs);
+    while (g_hash_table_iter_next(&it, NULL, &v))
+    {
+        Catalog *cat = (Catalog *)v;
+        if (!cat->models)
+            continue;
+
+        /* URLs may hold characters a group name cannot ("[::1]") */
+        gchar *group = g_strdup_printf("catalog_%u", n++);
+        g_key_file_set_string(kf, group, "url", cat->base_url);
+        g_key_file_set_integer(kf, group, "mode", (gint)cat->mode);
+        set_opt_string(kf, group, "etag", cat->etag);
+        g_key_file_set_int64(kf, group, "fetched", cat->fetched);
+        g_key_file_set_integer(kf, group, "count", (gint)cat->models->len);
+
+        for (guint i = 0; i < cat->models->len; i++)
+        {
+            const ModelInfo *m = g_ptr_array_index(cat->models, i);
+            gchar *k_name = g_strdup_printf("model_%u_name", i);
+            gchar *k_size = g_strdup_printf("model_%u_size", i);
+            gchar *k_params = g_strdup_printf("model_%u_params", i);
+            gchar *k_quant = g_strdup_printf("model_%u_quant", i);
+            gchar *k_ctx = g_strdup_printf("model_%u_ctx", i);
+            gchar *k_digest = g_strdup_printf("model_%u_digest", i);
+
+            g_key_file_set_string(kf, group, k_name, m->name);
+            if (m->size)
+                g_key_file_set_int64(kf, group, k_size, m->size);
+            set_opt_string(kf, group, k_params, m->parameter_size);
+            set_opt_string(kf, group, k_quant, m->quantization);
+            if (m->context_length)
+                g_key_file_set_int64(kf, group, k_ctx, m->context_length);
+            set_opt_string(kf, group, k_digest, m->digest);
+
+            g_free(k_name);
+            g_free(k_size);
+            g_free(k_params);
+            g_free(k_quant);
+            g_free(k_ctx);
+            g_free(k_digest);
+        }
+        g_free(group);
+    }
 
-    /* Find "data" array */
-    const char *data = strstr(json, "\"data\"");
-    if (!data) return NULL;
+    gsize len = 0;
+    gchar *txt = g_key_file_to_data(kf, &len, NULL);
+    gchar *path = cache_path();
+    gchar *dir = g_path_get_dirname(path);
+    g_mkdir_with_parents(dir, 0700);
+    g_file_set_contents(path, txt, (gssize)len, NULL);
+    g_free(dir);
+    g_free(path);
+    g_free(txt);
+    g_key_file_free(kf);
+}
 
-    const char *arr_start = strchr(data, '[');
-    if (!arr_start) return NULL;
+static Catalog* catalog_get(ApiMode mode, const gchar *base_url)
+{
+    catalogs_load();
+    gchar *key = catalog_key(mode, base_url);
+    Catalog *cat = g_hash_table_lookup(catalogs, key);
+    g_free(key);
+    return cat ? cat : catalog_add(mode, base_url);
+}
 
-    const char *p = arr_start + 1;
-    while (*p)
+static ModelInfo* catalog_find(const Catalog *cat, const gchar *name)
+{
+    for (guint i = 0; cat->models && i < cat->models->len; i++)
     {
-        /* Find "id" field */
-        const char *id_key = strstr(p, "\"id\"");
-        if (!id_key) break;
+        ModelInfo *m = g_ptr_array_index(cat->models, i);
+        if (g_strcmp0(m->name, name) == 0)
+            return m;
+    }
+    return NULL;
+}
 
-        const char *colon = strchr(id_key + 4, ':');
-        if (!colon) break;
+/* --- Parsing (I/O thread) ------------------------------------------------ */
 
-        const char *q = colon + 1;
-        while (*q == ' ' || *q == '\t') q++;
-        if (*q != '"') { p = q; continue; }
+enum
+{
+    F_NAME,
+    F_SIZE,
+    F_PARAMS,
+    F_QUANT,
+    F_CTX,
+    F_DIGEST,
+    F_END      /* End of one model object */
+};
 
-        q++;
-        const char *end = strchr(q, '"');
-        if (!end) break;
+typedef struct
+{
+    GPtrArray *list;
+    ModelInfo *cur;
+} ParseCtx;
 
-        gchar *id = g_strndup(q, end - q);
-        list = g_list_append(list, id);
+static void set_string(gchar **dst, JsonValueType type, const gchar *text, gsize len)
+{
+    if (type != JSON_VALUE_STRING || len == 0)
+        return;
+    g_free(*dst);
+    *dst = g_strndup(text, len);
+}
+
+static void on_model_value(gpointer ud, gint field, JsonValueType type,
+                           const gchar *text, gsize len)
+{
+    ParseCtx *p = (ParseCtx *)ud;
+
+    if (field == F_END)
+    {
+        if (p->cur && p->cur->name && p->list)
+            g_ptr_array_add(p->list, p->cur);
+        else
+            model_info_free(p->cur);
+        p->cur = NULL;
+        return;
+    }
+
+    if (!p->cur)
+        p->cur = g_new0(ModelInfo, 1);
+    ModelInfo *m = p->cur;
+    switch (field)
+    {
+        case F_NAME:   set_string(&m->name, type, text, len);           break;
+        case F_PARAMS: set_string(&m->parameter_size, type, text, len); break;
+        case F_QUANT:  set_string(&m->quantization, type, text, len);   break;
+        case F_DIGEST: set_string(&m->digest, type, text, len);         break;
+        case F_SIZE:
+            if (type == JSON_VALUE_NUMBER)
+                m->size = g_ascii_strtoll(text, NULL, 10);
+            break;
+        case F_CTX:
+            if (type == JSON_VALUE_NUMBER)
+                m->context_length = g_ascii_strtoll(text, NULL, 10);
+            break;
+    }
+}
+
+/*
+ * One pass over a model list: {"models":[{"name":…,"size":…,"details":
+ * {…}}]} (Ollama) or {"data":[{"id":…}]} (OpenAI). The optional fields
+ * of the OpenAI list are what OpenRouter, vLLM and llama.cpp add.
+ */
+static GPtrArray* parse_models(ApiMode mode, const gchar *json, gsize len)
+{
+    ParseCtx p = { model_list_new(), NULL };
+    JsonStream *js = json_stream_new(NULL, on_model_value, &p);
 
-        p = end + 1;
+    if (mode == API_OLLAMA)
+    {
+        json_stream_watch(js, "models[].name", F_NAME, FALSE);
+        json_stream_watch(js, "models[].size", F_SIZE, FALSE);
+        json_stream_watch(js, "models[].digest", F_DIGEST, FALSE);
+        json_stream_watch(js, "models[].details.parameter_size", F_PARAMS, FALSE);
+        json_stream_watch(js, "models[].details.quantization_level", F_QUANT, FALSE);
+        json_stream_watch(js, "models[]", F_END, FALSE);
+    }
+    else
+    {
+        json_stream_watch(js, "data[].id", F_NAME, FALSE);
+        json_stream_watch(js, "data[].context_length", F_CTX, FALSE);
+        json_stream_watch(js, "data[].max_model_len", F_CTX, FALSE);
+        json_stream_watch(js, "data[].meta.n_ctx_train", F_CTX, FALSE);
+        json_stream_watch(js, "data[].meta.size", F_SIZE, FALSE);
+        json_stream_watch(js, "data[]", F_END, FALSE);
+    }
+    json_stream_feed(js, json, len);
 
-        while (*p && *p != ',' && *p != ']') p++;
-        if (*p == ']') break;
-        if (*p == ',') p++;
+    gboolean bad = json_stream_failed(js);
+    json_stream_free(js);
+    model_info_free(p.cur);
+    if (bad)
+    {
+        g_ptr_array_unref(p.list);
+        return NULL;
     }
+    return p.list;
+}
 
-    return list;
+/* Ollama /api/show: the parts of its answer we keep */
+static ModelInfo* parse_show(const gchar *json, gsize len)
+{
+    ParseCtx p = { NULL, NULL };
+    JsonStream *js = json_stream_new(NULL, on_model_value, &p);
+
+    json_stream_watch(js, "details.parameter_size", F_PARAMS, FALSE);
+    json_stream_watch(js, "details.quantization_level", F_QUANT, FALSE);
+    /* Keys are "<architecture>.context_length", e.g. "llama.…" */
+    json_stream_watch(js, "model_info.*.context_length", F_CTX, FALSE);
+    json_stream_feed(js, json, len);
+    json_stream_free(js);
+    return p.cur;
 }
 
-/* --- Idle callback to deliver results on main thread --------------------- */
+/* --- Transfers ----------------------------------------------------------- */
+
+typedef enum { FETCH_LIST, FETCH_SHOW } FetchKind;
 
 typedef struct {
-    GList *models;
-    ModelsFetchedCallback callback;
-    gpointer user_data;
-} DeliverCtx;
+    FetchKind kind;
+    gchar *key;                /* Catalog this answers for */
+    ApiMode mode;
+    gchar *base_url;
+    gchar *unix_socket;        /* NULL = TCP */
+    gchar *url;
+    gchar *model;              /* FETCH_SHOW: model described */
+    gchar *body;               /* FETCH_SHOW: POST body */
+    struct curl_slist *headers;
+    struct MemBuf mem;
+
+    CURLcode rc;               /* Filled in on the I/O thread */
+    long status;
+    gchar *etag;
+    GPtrArray *models;         /* FETCH_LIST, 2xx */
+    ModelInfo *info;           /* FETCH_SHOW, 2xx */
+} FetchCtx;
 
-static gboolean deliver_idle_cb(gpointer data)
+static void fetch_free(FetchCtx *ctx)
 {
-    DeliverCtx *ctx = (DeliverCtx *)data;
-    if (ctx->callback)
-        ctx->callback(ctx->models, ctx->user_data);
+    curl_slist_free_all(ctx->headers);
+    g_free(ctx->mem.data);
+    g_free(ctx->key);
+    g_free(ctx->base_url);
+    g_free(ctx->unix_socket);
+    g_free(ctx->url);
+    g_free(ctx->model);
+    g_free(ctx->body);
+    g_free(ctx->etag);
+    if (ctx->models) g_ptr_array_unref(ctx->models);
+    model_info_free(ctx->info);
     g_free(ctx);
-    return FALSE;
 }
 
-/* --- Fetch thread -------------------------------------------------------- */
+static size_t header_cb(char *buf, size_t size, size_t nm, void *ud)
+{
+    FetchCtx *ctx = (FetchCtx *)ud;
+    size_t r = size * nm;
+
+    if (r > 5 && memcmp(buf, "HTTP/", 5) == 0)
+        g_clear_pointer(&ctx->etag, g_free);   /* New response */
+    else if (r > 5 && g_ascii_strncasecmp(buf, "ETag:", 5) == 0)
+    {
+        g_free(ctx->etag);
+        ctx->etag = g_strstrip(g_strndup(buf + 5, r - 5));
+    }
+    return r;
+}
 
-static gpointer fetch_thread(gpointer data)
+static gboolean fetch_finish_idle(gpointer data);
+
+/* Runs on the I/O thread */
+static void fetch_done(CURL *curl, CURLcode res, gpointer data)
 {
     FetchCtx *ctx = (FetchCtx *)data;
-    GList *models = NULL;
 
-    CURL *curl = curl_easy_init();
-    if (!curl)
-        goto done;
+    ctx->rc = res;
+    if (curl)
+    {
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &ctx->status);
 
-    gchar *url = NULL;
-    struct curl_slist *headers = NULL;
-    struct MemBuf mem = {0};
+        curl_off_t wire = 0;
+        if (res == CURLE_OK && ctx->mem.data &&
+            curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire) == CURLE_OK)
+            stats_add_response(ctx->mem.size, (gsize)wire);
+    }
 
-    if (ctx->mode == API_OLLAMA)
+    if (res == CURLE_OK && ctx->status >= 200 && ctx->status < 300 && ctx->mem.data)
     {
-        url = g_strdup_printf("%s/api/tags", ctx->base_url);
+        if (ctx->kind == FETCH_LIST)
+            ctx->models = parse_models(ctx->mode, ctx->mem.data, ctx->mem.size);
+        else
+            ctx->info = parse_show(ctx->mem.data, ctx->mem.size);
     }
+
+    netpool_release(ctx->base_url, curl);
+
+    /* Apply on the main thread (not while the plugin unloads) */
+    if (netloop_stopping())
+        fetch_free(ctx);
     else
+        g_idle_add(fetch_finish_idle, ctx);
+}
+
+static void fetch_start(FetchCtx *ctx, const gchar *api_key)
+{
+    CURL *curl = netpool_acquire(ctx->base_url);
+    if (!curl)
     {
-        url = g_strdup_printf("%s/v1/models", ctx->base_url);
-        if (ctx->api_key && *ctx->api_key)
-        {
-            gchar *auth = g_strdup_printf("Authorization: Bearer %s", ctx->api_key);
-            headers = curl_slist_append(headers, auth);
-            g_free(auth);
-        }
+        fetch_done(NULL, CURLE_FAILED_INIT, ctx);
+        return;
     }
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    if (api_key && *api_key)
+    {
+        gchar *auth = g_strdup_printf("Authorization: Bearer %s", api_key);
+        ctx->headers = curl_slist_append(ctx->headers, auth);
+        g_free(auth);
+    }
+    if (ctx->body)
+    {
+        ctx->headers = curl_slist_append(ctx->headers, "Content-Type: application/json");
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, ctx->body);
+    }
+
+    curl_easy_setopt(curl, CURLOPT_URL, ctx->url);
+    if (ctx->unix_socket)
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, ctx->unix_socket);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, ctx->headers);
+    curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, ctx);
     curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &mem);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &ctx->mem);
     curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
     curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
 
-    CURLcode res = curl_easy_perform(curl);
+    netloop_add(curl, fetch_done, ctx);
+}
 
-    if (res == CURLE_OK && mem.data)
+static FetchCtx* fetch_new(FetchKind kind, const Catalog *cat)
+{
+    FetchCtx *ctx = g_new0(FetchCtx, 1);
+    ctx->kind = kind;
+    ctx->key = g_strdup(cat->key);
+    ctx->mode = cat->mode;
+    ctx->base_url = g_strdup(cat->base_url);
+    if (cat->unix_socket && *cat->unix_socket)
+        ctx->unix_socket = g_strdup(cat->unix_socket);
+    return ctx;
+}
+
+static void list_start(Catalog *cat, const gchar *api_key)
+{
+    FetchCtx *ctx = fetch_new(FETCH_LIST, cat);
+
+    if (cat->mode == API_OLLAMA)
+        ctx->url = g_strdup_printf("%s/api/tags", cat->base_url);
+    else
+        ctx->url = g_strdup_printf("%s/v1/models", cat->base_url);
+
+    /* A 304 keeps the list we have; only worth asking if we have one */
+    if (cat->etag && cat->models)
     {
-        long http_code = 0;
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        gchar *inm = g_strdup_printf("If-None-Match: %s", cat->etag);
+        ctx->headers = curl_slist_append(ctx->headers, inm);
+        g_free(inm);
+    }
+
+    cat->fetching = TRUE;
+    fetch_start(ctx, cat->mode == API_OPENAI ? api_key : NULL);
+}
 
-        if (http_code >= 200 && http_code < 300)
+/* Describe the next Ollama model that lacks a context length */
+static void show_next(Catalog *cat)
+{
+    while (cat->models && cat->show_pos < cat->models->len)
+    {
+        const ModelInfo *m = g_ptr_array_index(cat->models, cat->show_pos);
+        if (m->context_length == 0)
         {
-            if (ctx->mode == API_OLLAMA)
-                models = parse_ollama_models(mem.data);
-            else
-                models = parse_openai_models(mem.data);
+            FetchCtx *ctx = fetch_new(FETCH_SHOW, cat);
+            /* "name" for servers older than the "model" spelling */
+            GString *body = g_string_new("{\"model\":\"");
+            json_escape_append(body, m->name, -1);
+            g_string_append(body, "\",\"name\":\"");
+            json_escape_append(body, m->name, -1);
+            g_string_append(body, "\"}");
+            ctx->url = g_strdup_printf("%s/api/show", cat->base_url);
+            ctx->model = g_strdup(m->name);
+            ctx->body = g_string_free(body, FALSE);
+            cat->showing = TRUE;
+            fetch_start(ctx, NULL);
+            return;
         }
+        cat->show_pos++;
     }
+    if (cat->showing)
+    {
+        cat->showing = FALSE;
+        catalogs_save();
+    }
+}
 
-    g_free(mem.data);
-    g_free(url);
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
+/* Keep what /api/show told us about models whose digest did not change */
+static void carry_over(const Catalog *cat, GPtrArray *fresh)
+{
+    for (guint i = 0; i < fresh->len; i++)
+    {
+        ModelInfo *m = g_ptr_array_index(fresh, i);
+        const ModelInfo *old = catalog_find(cat, m->name);
+        if (old && m->context_length == 0 && g_strcmp0(old->digest, m->digest) == 0)
+            m->context_length = old->context_length;
+    }
+}
+
+static void merge_member_done(Merge *mg, gboolean changed);
+
+static void notify_waiters(Catalog *cat, gboolean changed)
+{
+    GSList *waiters = cat->waiters;
+    GPtrArray *none = cat->models ? NULL : model_list_new();
 
-done:
-    /* Deliver results on main thread */
+    cat->waiters = NULL;
+    for (GSList *l = waiters; l; l = l->next)
     {
-        DeliverCtx *dctx = g_new0(DeliverCtx, 1);
-        dctx->models = models;
-        dctx->callback = ctx->callback;
-        dctx->user_data = ctx->user_data;
-        g_idle_add(deliver_idle_cb, dctx);
+        Waiter *w = (Waiter *)l->data;
+        if (w->merge)
+            merge_member_done(w->merge, changed);
+        else if (!w->served || changed)
+            w->cb(cat->models ? cat->models : none, w->user_data);
     }
+    g_slist_free_full(waiters, g_free);
+    if (none) g_ptr_array_unref(none);
+}
 
-    g_free(ctx->base_url);
-    g_free(ctx->api_key);
-    g_free(ctx);
+static void list_finished(Catalog *cat, FetchCtx *ctx)
+{
+    gboolean changed = FALSE;
 
-    return NULL;
+    cat->fetching = FALSE;
+    if (ctx->rc == CURLE_OK && ctx->status == 304)
+    {
+        cat->fetched = g_get_real_time();
+        catalogs_save();
+    }
+    else if (ctx->models)
+    {
+        carry_over(cat, ctx->models);
+        if (cat->models) g_ptr_array_unref(cat->models);
+        cat->models = ctx->models;
+        ctx->models = NULL;
+        g_free(cat->etag);
+        cat->etag = g_steal_pointer(&ctx->etag);
+        cat->fetched = g_get_real_time();
+        cat->show_pos = 0;
+        changed = TRUE;
+        catalogs_save();
+    }
+
+    notify_waiters(cat, changed);
+
+    if (changed && cat->mode == API_OLLAMA && !cat->showing)
+        show_next(cat);
+}
+
+static void show_finished(Catalog *cat, FetchCtx *ctx)
+{
+    ModelInfo *m = catalog_find(cat, ctx->model);
+    if (m && ctx->info)
+    {
+        m->context_length = ctx->info->context_length;
+        if (!m->parameter_size)
+            m->parameter_size = g_steal_pointer(&ctx->info->parameter_size);
+        if (!m->quantization)
+            m->quantization = g_steal_pointer(&ctx->info->quantization);
+    }
+
+    /* One attempt per model and fetch: older servers lack model_info */
+    cat->show_pos++;
+    show_next(cat);
+}
+
+static gboolean fetch_finish_idle(gpointer data)
+{
+    FetchCtx *ctx = (FetchCtx *)data;
+    Catalog *cat = catalogs ? g_hash_table_lookup(catalogs, ctx->key) : NULL;
+
+    if (cat)
+    {
+        if (ctx->kind == FETCH_LIST)
+            list_finished(cat, ctx);
+        else
+            show_finished(cat, ctx);
+    }
+    fetch_free(ctx);
+    return FALSE;
+}
+
+/* --- Pools (main thread) ------------------------------------------------ */
+
+/*
+ * The models of every member, each name once, in member order; the
+ * ModelInfo are borrowed from the catalogs. NULL if no member is known.
+ */
+static GPtrArray* merged_models(ApiMode mode, gchar **urls)
+{
+    GPtrArray *all = NULL;
+    GHashTable *seen = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (gchar **u = urls; *u; u++)
+    {
+        gchar *key = catalog_key(mode, *u);
+        Catalog *cat = g_hash_table_lookup(catalogs, key);
+        g_free(key);
+        if (!cat || !cat->models)
+            continue;
+        if (!all)
+            all = g_ptr_array_new();
+        for (guint i = 0; i < cat->models->len; i++)
+        {
+            ModelInfo *m = g_ptr_array_index(cat->models, i);
+            if (g_hash_table_add(seen, m->name))
+                g_ptr_array_add(all, m);
+        }
+    }
+    g_hash_table_destroy(seen);
+    return all;
+}
+
+/* Hand the union to the caller if it has something new for it, then free */
+static void merge_finish(Merge *mg)
+{
+    if (!mg->served || mg->changed)
+    {
+        GPtrArray *all = merged_models(mg->mode, mg->urls);
+        if (!all)
+            all = g_ptr_array_new();
+        mg->cb(all, mg->user_data);
+        g_ptr_array_unref(all);
+    }
+    g_strfreev(mg->urls);
+    g_free(mg);
+}
+
+static void merge_member_done(Merge *mg, gboolean changed)
+{
+    mg->changed |= changed;
+    if (--mg->pending == 0)
+        merge_finish(mg);
+}
+
+/*
+ * Like models_fetch_async for each member of a pool, reporting the union
+ * once: right away if some member is known, then again when the members
+ * that needed a fetch have all answered and one of them changed.
+ */
+static void fetch_pool(ApiMode mode, gchar **urls, const gchar *api_key,
+                       gboolean force, ModelsFetchedCallback callback,
+                       gpointer user_data)
+{
+    Merge *mg = g_new0(Merge, 1);
+    mg->cb = callback;
+    mg->user_data = user_data;
+    mg->mode = mode;
+    mg->urls = urls;
+
+    catalogs_load();
+    GPtrArray *known = merged_models(mode, urls);
+    if (known)
+    {
+        callback(known, user_data);
+        g_ptr_array_unref(known);
+        mg->served = TRUE;
+    }
+
+    /* Counted up front so a member answering at once cannot finish it */
+    mg->pending = 1;
+    for (gchar **u = urls; *u; u++)
+    {
+        Catalog *cat = catalog_get(mode, *u);
+        if (cat->models && !force && !cat->fetching &&
+            g_get_real_time() - cat->fetched < MODELS_TTL_US)
+            continue;
+
+        Waiter *w = g_new0(Waiter, 1);
+        w->merge = mg;
+        mg->pending++;
+        cat->waiters = g_slist_append(cat->waiters, w);
+        if (!cat->fetching)
+        {
+            /* Members are reached over TCP */
+            g_clear_pointer(&cat->unix_socket, g_free);
+            list_start(cat, api_key);
+        }
+    }
+    merge_member_done(mg, FALSE);
 }
 
 /* --- Public API ---------------------------------------------------------- */
@@ -231,15 +794,89 @@ done:
 void models_fetch_async(ApiMode mode,
                         const gchar *base_url,
                         const gchar *api_key,
+                        const gchar *unix_socket,
+                        const gchar *pool,
+                        gboolean force,
                         ModelsFetchedCallback callback,
                         gpointer user_data)
 {
-    FetchCtx *ctx = g_new0(FetchCtx, 1);
-    ctx->mode = mode;
-    ctx->base_url = g_strdup(base_url);
-    ctx->api_key = g_strdup(api_key ? api_key : "");
-    ctx->callback = callback;
-    ctx->user_data = user_data;
+    if (!base_url || !*base_url)
+        return;
 
-    g_thread_new("models_fetch", fetch_thread, ctx);
+    /* A Unix socket names one server: no pool then */
+    if (pool && *pool && !(unix_socket && *unix_socket))
+    {
+        gchar **urls = endpoints_split(base_url, pool);
+        if (urls[1])
+        {
+            fetch_pool(mode, urls, api_key, force, callback, user_data);
+            return;
+        }
+        g_strfreev(urls);
+    }
+
+    Catalog *cat = catalog_get(mode, base_url);
+    if (g_strcmp0(cat->unix_socket, unix_socket) != 0)
+    {
+        g_free(cat->unix_socket);
+        cat->unix_socket = g_strdup(unix_socket);
+    }
+    gboolean served = FALSE;
+
+    if (cat->models)
+    {
+        callback(cat->models, user_data);
+        served = TRUE;
+        if (!force && !cat->fetching &&
+            g_get_real_time() - cat->fetched < MODELS_TTL_US)
+            return;
+    }
+
+    Waiter *w = g_new0(Waiter, 1);
+    w->cb = callback;
+    w->user_data = user_data;
+    w->served = served;
+    cat->waiters = g_slist_append(cat->waiters, w);
+
+    if (!cat->fetching)
+        list_start(cat, api_key);
+}
+
+const ModelInfo* models_lookup(ApiMode mode, const gchar *base_url,
+                               const gchar *name)
+{
+    if (!base_url || !name)
+        return NULL;
+    catalogs_load();
+    gchar *key = catalog_key(mode, base_url);
+    Catalog *cat = g_hash_table_lookup(catalogs, key);
+    g_free(key);
+    return cat ? catalog_find(cat, name) : NULL;
+}
+
+gchar* models_describe(const ModelInfo *m)
+{
+    if (!m)
+        return NULL;
+
+    GPtrArray *parts = g_ptr_array_new_with_free_func(g_free);
+    if (m->parameter_size)
+        g_ptr_array_add(parts, g_strdup(m->parameter_size));
+    if (m->quantization)
+        g_ptr_array_add(parts, g_strdup(m->quantization));
+    if (m->size > 0)
+        g_ptr_array_add(parts, g_format_size((guint64)m->size));
+    if (m->context_length > 0)
+        g_ptr_array_add(parts, g_strdup_printf("contexte %" G_GINT64_FORMAT " tokens",
+                                               m->context_length));
+    g_ptr_array_add(parts, NULL);
+
+    gchar *desc = parts->len > 1 ? g_strjoinv(" · ", (gchar **)parts->pdata) : NULL;
+    g_ptr_array_free(parts, TRUE);
+    return desc;
+}
+
+void models_cleanup(void)
+{
+    g_clear_pointer(&catalogs, g_hash_table_destroy);
 }
@@ -1,5 +1,5 @@
 /*
- * models.h — Model list fetching for AI Chat plugin
+ * models.h — Model catalog for AI Chat plugin
  */
 
 #ifndef MODELS_H
@@ -8,25 +8,59 @@
 #include <glib.h>
 #include "prefs.h"
 
-/* Callback when models are fetched (called on main thread) */
-typedef void (*ModelsFetchedCallback)(GList *models, gpointer user_data);
+/* What a backend tells about one of its models (unknown: 0 / NULL) */
+typedef struct
+{
+    gchar  *name;
+    gint64  size;             /* Bytes on disk */
+    gchar  *parameter_size;   /* e.g. "8.0B" */
+    gchar  *quantization;     /* e.g. "Q4_K_M" */
+    gint64  context_length;   /* Tokens (Ollama /api/show, some OpenAI servers) */
+    gchar  *digest;           /* Ollama: /api/show results are kept per digest */
+} ModelInfo;
 
 /*
- * Fetch available models asynchronously.
+ * Callback with the catalog (main thread): @models is a GPtrArray of
+ * ModelInfo*, only borrowed for the duration of the call.
+ */
+typedef void (*ModelsFetchedCallback)(const GPtrArray *models, gpointer user_data);
+
+/*
+ * Get the models of a backend.
  * @param mode: API_OLLAMA or API_OPENAI
  * @param base_url: Base URL of the API
  * @param api_key: API key (for OpenAI, can be NULL for Ollama)
+ * @param unix_socket: Unix socket to connect through, NULL or "" for TCP
+ * @param pool: more base URLs serving the same models (see endpoints.h),
+ *              NULL or "" for none; their lists are merged
+ * @param force: revalidate even if the cached list is still fresh
  * @param callback: Function to call when models are ready
  * @param user_data: User data passed to callback
  *
- * The callback receives a GList of gchar* model names.
- * The caller must free the list and strings with:
- *   g_list_free_full(models, g_free);
+ * A known catalog (from memory or the disk cache) is passed to @callback
+ * before this returns. It is then revalidated if stale or @force, with
+ * If-None-Match when the backend sent an ETag; @callback runs again only
+ * if the list changed, or if nothing was known before. Concurrent calls
+ * for one backend share a single request.
  */
 void models_fetch_async(ApiMode mode,
                         const gchar *base_url,
                         const gchar *api_key,
+                        const gchar *unix_socket,
+                        const gchar *pool,
+                        gboolean force,
                         ModelsFetchedCallback callback,
                         gpointer user_data);
 
+/* Metadata of @name in the known catalog of @base_url, or NULL */
+const ModelInfo* models_lookup(ApiMode mode, const gchar *base_url,
+                               const gchar *name);
+
+/* One-line summary of what is known, e.g. "8.0B · Q4_K_M · 4,7 Go"
+ * (NULL if nothing) */
+gchar* models_describe(const ModelInfo *m);
+
+/* Free the in-memory catalogs */
+void models_cleanup(void);
+
 #endif /* MODELS_H */
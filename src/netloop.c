@@ -0,0 +1,249 @@
+/*
+ * netloop.c — Single curl_multi I/O thread for AI Chat plugin
+ *
+ * All chat streams and model fetches run as transfers on one multi handle
+ * driven by one long-lived thread. Other threads hand work over through a
+ * queue and wake the loop with curl_multi_wakeup(). A transfer added with
+ * a cancel flag is torn down as soon as the loop sees the flag set, so a
+ * Stop does not wait for libcurl's progress callback, which an idle
+ * connection (a model still reading a long prompt) only gets once a
+ * second.
+ */
+
+#include "netloop.h"
+
+typedef struct
+{
+    CURL          *curl;
+    NetDoneFunc    done;
+    gpointer       user_data;
+    gint64         due;      /* Monotonic start time, 0 = now */
+    volatile gint *cancel;   /* Abort once set (may be NULL) */
+} Transfer;
+
+static CURLM       *multi    = NULL;
+static GThread     *thread   = NULL;
+static GAsyncQueue *incoming = NULL;  /* Transfer* waiting to be added */
+static GList       *active   = NULL;  /* Transfer* owned by the I/O thread */
+static GList       *waiting  = NULL;  /* Transfer* whose start is delayed */
+static volatile gint quit    = 0;
+
+/* --- I/O thread ---------------------------------------------------------- */
+
+static void transfer_finish(Transfer *t, CURLcode rc)
+{
+    active = g_list_remove(active, t);
+    curl_multi_remove_handle(multi, t->curl);
+    if (t->done)
+        t->done(t->curl, rc, t->user_data);
+    g_free(t);
+}
+
+static void start_transfer(Transfer *t)
+{
+    curl_easy_setopt(t->curl, CURLOPT_PRIVATE, t);
+    CURLMcode mc = curl_multi_add_handle(multi, t->curl);
+    if (mc != CURLM_OK)
+    {
+        if (t->done)
+            t->done(t->curl, CURLE_FAILED_INIT, t->user_data);
+        g_free(t);
+        return;
+    }
+    active = g_list_prepend(active, t);
+}
+
+static gboolean transfer_due(const Transfer *t, gint64 now)
+{
+    return t->due <= now;
+}
+
+static gboolean transfer_cancelled(const Transfer *t)
+{
+    return t->cancel && g_atomic_int_get(t->cancel);
+}
+
+/*
+ * Finish cancelled transfers now. Removing a handle mid-transfer closes
+ * its connection (HTTP/1.1) or resets its stream (HTTP/2), which is what
+ * tells the backend to stop generating.
+ */
+static void abort_cancelled(void)
+{
+    GList *l = active;
+    while (l)
+    {
+        GList *next = l->next;
+        Transfer *t = (Transfer *)l->data;
+        if (transfer_cancelled(t))
+            transfer_finish(t, CURLE_ABORTED_BY_CALLBACK);
+        l = next;
+    }
+
+    l = waiting;
+    while (l)
+    {
+        GList *next = l->next;
+        Transfer *t = (Transfer *)l->data;
+        if (transfer_cancelled(t))
+        {
+            waiting = g_list_delete_link(waiting, l);
+            if (t->done)
+                t->done(t->curl, CURLE_ABORTED_BY_CALLBACK, t->user_data);
+            g_free(t);
+        }
+        l = next;
+    }
+}
+
+static void drain_incoming(void)
+{
+    Transfer *t;
+    gint64 now = g_get_monotonic_time();
+    while ((t = g_async_queue_try_pop(incoming)) != NULL)
+    {
+        if (transfer_due(t, now))
+            start_transfer(t);
+        else
+            waiting = g_list_prepend(waiting, t);
+    }
+}
+
+/* Start delayed transfers that are due; returns ms until the next one */
+static int start_waiting(void)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 next = G_MAXINT64;
+    GList *l = waiting;
+
+    while (l)
+    {
+        GList *next_l = l->next;
+        Transfer *t = (Transfer *)l->data;
+        if (transfer_due(t, now))
+        {
+            waiting = g_list_delete_link(waiting, l);
+            start_transfer(t);
+        }
+        else
+            next = MIN(next, t->due);
+        l = next_l;
+    }
+    if (next == G_MAXINT64)
+        return 1000;
+    return (int)CLAMP((next - now + 999) / 1000, 1, 1000);
+}
+
+static void reap_finished(void)
+{
+    CURLMsg *msg;
+    int left = 0;
+    while ((msg = curl_multi_info_read(multi, &left)) != NULL)
+    {
+        if (msg->msg != CURLMSG_DONE)
+            continue;
+        Transfer *t = NULL;
+        curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&t);
+        if (t)
+            transfer_finish(t, msg->data.result);
+    }
+}
+
+static gpointer loop_thread(gpointer data)
+{
+    (void)data;
+    while (!g_atomic_int_get(&quit))
+    {
+        drain_incoming();
+        abort_cancelled();
+        int timeout_ms = start_waiting();
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        reap_finished();
+
+        /* Until the next delayed start, at most 1 s; netloop_interrupt()
+         * ends the wait early */
+        curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+    }
+    return NULL;
+}
+
+/* --- Public API ---------------------------------------------------------- */
+
+void netloop_start(void)
+{
+    if (thread) return;
+    multi = curl_multi_init();
+    /* Several streams to one HTTP/2 backend share its connection */
+    curl_multi_setopt(multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    incoming = g_async_queue_new();
+    g_atomic_int_set(&quit, 0);
+    thread = g_thread_new("ai_chat_io", loop_thread, NULL);
+}
+
+void netloop_stop(void)
+{
+    if (!thread) return;
+
+    g_atomic_int_set(&quit, 1);
+    curl_multi_wakeup(multi);
+    g_thread_join(thread);
+    thread = NULL;
+
+    /* The loop is gone: complete what is left from this thread */
+    drain_incoming();
+    while (active)
+        transfer_finish((Transfer *)active->data, CURLE_ABORTED_BY_CALLBACK);
+    while (waiting)
+    {
+        Transfer *t = (Transfer *)waiting->data;
+        waiting = g_list_delete_link(waiting, waiting);
+        if (t->done)
+            t->done(t->curl, CURLE_ABORTED_BY_CALLBACK, t->user_data);
+        g_free(t);
+    }
+
+    g_async_queue_unref(incoming);
+    incoming = NULL;
+    curl_multi_cleanup(multi);
+    multi = NULL;
+}
+
+gboolean netloop_stopping(void)
+{
+    return g_atomic_int_get(&quit) != 0;
+}
+
+void netloop_add(CURL *curl, NetDoneFunc done, gpointer user_data)
+{
+    netloop_add_delayed(curl, 0, NULL, done, user_data);
+}
+
+void netloop_interrupt(void)
+{
+    if (multi && !g_atomic_int_get(&quit))
+        curl_multi_wakeup(multi);
+}
+
+void netloop_add_delayed(CURL *curl, gint64 delay_us, volatile gint *cancel,
+                         NetDoneFunc done, gpointer user_data)
+{
+    Transfer *t = g_new0(Transfer, 1);
+    t->curl = curl;
+    t->done = done;
+    t->user_data = user_data;
+    t->due = delay_us > 0 ? g_get_monotonic_time() + delay_us : 0;
+    t->cancel = cancel;
+
+    if (!incoming || g_atomic_int_get(&quit))
+    {
+        if (done)
+            done(curl, CURLE_FAILED_INIT, user_data);
+        g_free(t);
+        return;
+    }
+
+    g_async_queue_push(incoming, t);
+    curl_multi_wakeup(multi);
+}
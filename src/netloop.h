@@ -0,0 +1,45 @@
+/*
+ * netloop.h — Single curl_multi I/O thread for AI Chat plugin
+ */
+
+#ifndef NETLOOP_H
+#define NETLOOP_H
+
+#include <glib.h>
+#include <curl/curl.h>
+
+/*
+ * Called on the I/O thread once a transfer has finished (or was aborted
+ * at shutdown with CURLE_ABORTED_BY_CALLBACK). The easy handle has already
+ * been removed from the multi handle and belongs to the callee again.
+ */
+typedef void (*NetDoneFunc)(CURL *curl, CURLcode rc, gpointer user_data);
+
+/* Start the I/O thread */
+void netloop_start(void);
+
+/* Stop the I/O thread; pending transfers are aborted and completed */
+void netloop_stop(void);
+
+/* TRUE while netloop_stop() is draining transfers */
+gboolean netloop_stopping(void);
+
+/*
+ * Queue a configured easy handle (thread-safe). The handle's
+ * CURLOPT_PRIVATE is reserved for the loop.
+ */
+void netloop_add(CURL *curl, NetDoneFunc done, gpointer user_data);
+
+/*
+ * Same, but start the transfer @delay_us from now (0: at once) and abort
+ * it, running or still waiting, with CURLE_ABORTED_BY_CALLBACK once
+ * @cancel (may be NULL) is non-zero and the loop looks at it: on its
+ * next pass, at once after netloop_interrupt().
+ */
+void netloop_add_delayed(CURL *curl, gint64 delay_us, volatile gint *cancel,
+                         NetDoneFunc done, gpointer user_data);
+
+/* Wake the loop to act on cancel flags just set (thread-safe) */
+void netloop_interrupt(void);
+
+#endif /* NETLOOP_H */
@@ -0,0 +1,149 @@
+/*
+ * netpool.c — Shared curl state and reusable handles for AI Chat plugin
+ */
+
+#include "netpool.h"
+#include "stats.h"
+#include <string.h>
+
+/* Idle handles kept per backend; extra ones are freed on release */
+#define NETPOOL_MAX_IDLE 4
+
+static CURLSH     *share = NULL;
+static GMutex      share_locks[CURL_LOCK_DATA_LAST];
+static GMutex      pool_lock;
+static GHashTable *pool = NULL;   /* base_url -> GQueue of idle CURL* */
+
+/* --- Share locking ------------------------------------------------------- */
+
+static void share_lock_cb(CURL *h, curl_lock_data data,
+                          curl_lock_access access, void *ud)
+{
+    (void)h; (void)access; (void)ud;
+    g_mutex_lock(&share_locks[data]);
+}
+
+static void share_unlock_cb(CURL *h, curl_lock_data data, void *ud)
+{
+    (void)h; (void)ud;
+    g_mutex_unlock(&share_locks[data]);
+}
+
+/* --- Pool ---------------------------------------------------------------- */
+
+static void idle_queue_free(gpointer data)
+{
+    GQueue *q = (GQueue *)data;
+    CURL *curl;
+    while ((curl = g_queue_pop_head(q)) != NULL)
+        curl_easy_cleanup(curl);
+    g_queue_free(q);
+}
+
+static void apply_common_opts(CURL *curl)
+{
+    if (share)
+        curl_easy_setopt(curl, CURLOPT_SHARE, share);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+
+    /* HTTP/2 through ALPN on https, HTTP/1.1 otherwise or when refused;
+     * wait for a connection being set up rather than open a second one,
+     * so concurrent requests to one backend multiplex over it */
+    curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+}
+
+void netpool_init(void)
+{
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        g_mutex_init(&share_locks[i]);
+    g_mutex_init(&pool_lock);
+
+    pool = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                 g_free, idle_queue_free);
+
+    share = curl_share_init();
+    if (!share)
+        return;
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock_cb);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock_cb);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+void netpool_cleanup(void)
+{
+    /* Handles must go before the share they point to */
+    g_mutex_lock(&pool_lock);
+    g_clear_pointer(&pool, g_hash_table_destroy);
+    g_mutex_unlock(&pool_lock);
+
+    if (share)
+    {
+        curl_share_cleanup(share);
+        share = NULL;
+    }
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        g_mutex_clear(&share_locks[i]);
+    g_mutex_clear(&pool_lock);
+}
+
+CURL* netpool_acquire(const gchar *base_url)
+{
+    CURL *curl = NULL;
+
+    g_mutex_lock(&pool_lock);
+    if (pool && base_url)
+    {
+        GQueue *q = g_hash_table_lookup(pool, base_url);
+        if (q)
+            curl = g_queue_pop_head(q);
+    }
+    g_mutex_unlock(&pool_lock);
+
+    if (!curl)
+        curl = curl_easy_init();
+    if (curl)
+        apply_common_opts(curl);
+    return curl;
+}
+
+void netpool_release(const gchar *base_url, CURL *curl)
+{
+    if (!curl) return;
+
+    long version = 0, conns = 0;
+    curl_easy_getinfo(curl, CURLINFO_HTTP_VERSION, &version);
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &conns);
+    stats_add_transfer(base_url, version, conns);
+
+    /* Drop per-request options but keep the live connection and caches */
+    curl_easy_reset(curl);
+
+    g_mutex_lock(&pool_lock);
+    if (pool && base_url)
+    {
+        GQueue *q = g_hash_table_lookup(pool, base_url);
+        if (!q)
+        {
+            q = g_queue_new();
+            g_hash_table_insert(pool, g_strdup(base_url), q);
+        }
+        if (g_queue_get_length(q) < NETPOOL_MAX_IDLE)
+        {
+            g_queue_push_head(q, curl);
+            curl = NULL;
+        }
+    }
+    g_mutex_unlock(&pool_lock);
+
+    if (curl)
+        curl_easy_cleanup(curl);
+}
@@ -0,0 +1,27 @@
+/*
+ * netpool.h — Shared curl state and reusable handles for AI Chat plugin
+ */
+
+#ifndef NETPOOL_H
+#define NETPOOL_H
+
+#include <glib.h>
+#include <curl/curl.h>
+
+/* Create the shared DNS / TLS session / connection cache */
+void netpool_init(void);
+
+/* Free pooled handles and the shared cache (call before curl_global_cleanup) */
+void netpool_cleanup(void);
+
+/*
+ * Get an easy handle for a backend, reusing an idle one when possible.
+ * The handle comes with the shared cache, TCP keep-alive and TCP_NODELAY
+ * already set; other options are in their default state.
+ */
+CURL* netpool_acquire(const gchar *base_url);
+
+/* Return a handle to the pool once the transfer is finished */
+void netpool_release(const gchar *base_url, CURL *curl);
+
+#endif /* NETPOOL_H */
@@ -5,32 +5,100 @@
 #include "network.h"
 #include "history.h"
 #include "prefs.h"
+#include "netpool.h"
+#include "netloop.h"
+#include "framing.h"
+#include "stats.h"
+#include "json_text.h"
+#include "respcache.h"
+#include "capture.h"
+#include "endpoints.h"
 #include <curl/curl.h>
+#include <zlib.h>
 #include <string.h>
+#include <time.h>
 
-Req *current_req = NULL;
+/* Request bodies smaller than this are not worth a gzip header */
+#define GZIP_MIN_BODY 1024
+
+/* libcurl drops idle connections after CURLOPT_MAXAGE_CONN (118 s by
+ * default); a backend used within this window is assumed still warm */
+#define PREWARM_FRESH_US (60 * G_USEC_PER_SEC)
+
+/* Retry backoff: 1 s doubling up to this; longer Retry-After gives up */
+#define RETRY_BACKOFF_MAX_US (30 * G_USEC_PER_SEC)
+#define RETRY_AFTER_MAX_US   (120 * G_USEC_PER_SEC)
+
+/* Hedging delay when not fixed: this quantile of the model's recent
+ * first-token times, or the default until there are enough of them */
+#define HEDGE_QUANTILE    0.95
+#define HEDGE_LEARN_LAST  50
+#define HEDGE_LEARN_MIN   5
+#define HEDGE_DEFAULT_MS  4000
+#define HEDGE_MIN_MS      250
 
 /* Callbacks set by UI module */
 static StreamAppendFunc g_stream_append = NULL;
 static ReplaceRowFunc   g_replace_row   = NULL;
 static SetBusyFunc      g_set_busy      = NULL;
+static RowStatusFunc    g_row_status    = NULL;
+static RestartRowFunc   g_restart_row   = NULL;
+
+static GHashTable *last_use = NULL;   /* base_url -> gint64*, main thread */
+static GHashTable *inflight = NULL;   /* cache key -> leader Req*, main thread */
+static GPtrArray  *replays  = NULL;   /* Replay* running, main thread */
+static GPtrArray  *hedges   = NULL;   /* Hedge* armed, main thread */
+
+/* Guards leaders' follower lists, read by the I/O thread while streaming */
+static GMutex follow_lock;
 
 void network_set_callbacks(StreamAppendFunc stream_append,
                            ReplaceRowFunc replace_row,
-                           SetBusyFunc set_busy)
+                           SetBusyFunc set_busy,
+                           RowStatusFunc row_status,
+                           RestartRowFunc restart_row)
 {
     g_stream_append = stream_append;
     g_replace_row   = replace_row;
     g_set_busy      = set_busy;
+    g_row_status    = row_status;
+    g_restart_row   = restart_row;
 }
 
+static void replays_stop(void);
+static GMutex        replay_lock;           /* Held while a replay feeds its row */
+static volatile gint replay_stopping = 0;   /* Set under replay_lock at unload */
+static void hedges_stop(void);
+
 void network_init(void)
 {
     curl_global_init(CURL_GLOBAL_DEFAULT);
+    netpool_init();
+    netloop_start();
 }
 
 void network_cleanup(void)
 {
+    /* No UI updates from transfers aborted during shutdown; replay
+       threads only feed their rows while holding replay_lock */
+    g_mutex_lock(&replay_lock);
+    g_atomic_int_set(&replay_stopping, 1);
+    g_stream_append = NULL;
+    g_replace_row   = NULL;
+    g_set_busy      = NULL;
+    g_row_status    = NULL;
+    g_restart_row   = NULL;
+    g_mutex_unlock(&replay_lock);
+
+    netloop_stop();
+    replays_stop();
+    hedges_stop();
+    endpoints_cleanup();
+    netpool_cleanup();
+    stats_cleanup();
+    respcache_cleanup();
+    g_clear_pointer(&last_use, g_hash_table_destroy);
+    g_clear_pointer(&inflight, g_hash_table_destroy);
     curl_global_cleanup();
 }
 
@@ -51,160 +119,214 @@ static size_t collect_cb(void *ptr, size_t size, size_t nm, void *ud)
     return r;
 }
 
-/* --- JSON string unescape (UTF-8) ---------------------------------------- */
+/* --- Row notes ----------------------------------------------------------- */
 
-static void gstring_append_utf8_cp(GString *dst, guint32 cp)
+/*
+ * Add @note (taken) to the status line shown under the row of @req once
+ * it is finished. Errors and cancellations go there rather than into the
+ * stream, where a full ring would drop them. Only the thread owning @req
+ * calls this.
+ */
+static void add_row_note(Req *req, gchar *note)
 {
-    if (cp <= 0x7F)
-        g_string_append_c(dst, (gchar)cp);
-    else if (cp <= 0x7FF)
+    if (req->row_note)
     {
-        g_string_append_c(dst, (gchar)(0xC0 | ((cp >> 6) & 0x1F)));
-        g_string_append_c(dst, (gchar)(0x80 | (cp & 0x3F)));
+        gchar *both = g_strdup_printf("%s\n%s", req->row_note, note);
+        g_free(req->row_note);
+        g_free(note);
+        note = both;
     }
-    else if (cp <= 0xFFFF)
+    req->row_note = note;
+}
+
+/* --- Response fields ---------------------------------------------------- */
+
+/*
+ * Decoded content, straight from the tokenizer (I/O thread). Escape-free
+ * runs point into the receive buffer and escapes into a few stack bytes,
+ * so this is the only copy; the accumulator doubles as the UI scratch.
+ */
+static void on_json_chunk(gpointer ud, gint field, const gchar *text, gsize len)
+{
+    Req *req = (Req *)ud;
+    if (field != REPLY_CONTENT || len == 0)
+        return;
+    /* A stopped leader's text is read from the main thread (leader_detach) */
+    if (req->shared)
+        g_mutex_lock(&follow_lock);
+    if (!req->accum) req->accum = g_string_sized_new(4096);
+    g_string_append_len(req->accum, text, (gssize)len);
+    if (req->shared)
+        g_mutex_unlock(&follow_lock);
+}
+
+static void push_text(Req *req)
+{
+    if (!req->accum || req->accum->len == req->pushed)
+        return;
+    /* Old text may still be in the ring: wait for the row to be cleared */
+    if (g_atomic_int_get(&req->restarting))
+        return;
+    if (!g_stream_append || g_atomic_int_get(&req->row_gone))
     {
-        g_string_append_c(dst, (gchar)(0xE0 | ((cp >> 12) & 0x0F)));
-        g_string_append_c(dst, (gchar)(0x80 | ((cp >> 6) & 0x3F)));
-        g_string_append_c(dst, (gchar)(0x80 | (cp & 0x3F)));
+        req->pushed = req->accum->len;
+        return;
     }
-    else
+    req->pushed += g_stream_append(req, req->accum->str + req->pushed,
+                                   (gssize)(req->accum->len - req->pushed));
+}
+
+/*
+ * Hand text decoded since the last call to the UI, once per chunk. What
+ * the UI could not take yet is offered again with the next chunk. The
+ * text goes to the rows of requests sharing this stream as well.
+ */
+static void push_new_text(Req *req)
+{
+    push_text(req);
+    if (!req->shared || !req->accum)
+        return;
+
+    g_mutex_lock(&follow_lock);
+    for (guint i = 0; req->followers && i < req->followers->len; i++)
     {
-        g_string_append_c(dst, (gchar)(0xF0 | ((cp >> 18) & 0x07)));
-        g_string_append_c(dst, (gchar)(0x80 | ((cp >> 12) & 0x3F)));
-        g_string_append_c(dst, (gchar)(0x80 | ((cp >> 6) & 0x3F)));
-        g_string_append_c(dst, (gchar)(0x80 | (cp & 0x3F)));
+        Req *f = g_ptr_array_index(req->followers, i);
+        if (!f->accum)
+            f->accum = g_string_new(NULL);
+        if (req->accum->len > f->accum->len)
+            g_string_append_len(f->accum, req->accum->str + f->accum->len,
+                                (gssize)(req->accum->len - f->accum->len));
+        push_text(f);
     }
+    g_mutex_unlock(&follow_lock);
+}
+
+static void on_json_value(gpointer ud, gint field, JsonValueType type,
+                          const gchar *text, gsize len)
+{
+    Req *req = (Req *)ud;
+    reply_value(&req->reply, field, type, text, len);
+    if (field == REPLY_ERROR && type == JSON_VALUE_STRING)
+        add_row_note(req, g_strdup_printf("[Erreur] %.*s", (int)len, text));
 }
 
-static int hexval(int c)
+static JsonStream* response_parser_new(Req *req)
 {
-    if (c >= '0' && c <= '9') return c - '0';
-    if (c >= 'a' && c <= 'f') return 10 + (c - 'a');
-    if (c >= 'A' && c <= 'F') return 10 + (c - 'A');
-    return -1;
+    JsonStream *js = json_stream_new(on_json_chunk, on_json_value, req);
+    reply_watch(js, req->mode == API_OLLAMA);
+    return js;
 }
 
-static void json_unescape_append(GString *dst, const char *s, const char *e)
+static void hedge_claim(Req *req);
+static gboolean hedge_lost(Req *req);
+
+/* A document carried content: one token, as far as timing goes */
+static void note_chunk(Req *req)
 {
-    const char *p = s;
-    while (p < e)
+    gint64 now = g_get_monotonic_time();
+
+    if (req->t_first == 0)
     {
-        if (*p != '\\')
-        {
-            g_string_append_c(dst, *p++);
-            continue;
-        }
-        p++; if (p >= e) break;
-        switch (*p)
-        {
-            case '\"': g_string_append_c(dst, '\"'); p++; break;
-            case '\\': g_string_append_c(dst, '\\'); p++; break;
-            case '/':  g_string_append_c(dst, '/');  p++; break;
-            case 'b':  g_string_append_c(dst, '\b'); p++; break;
-            case 'f':  g_string_append_c(dst, '\f'); p++; break;
-            case 'n':  g_string_append_c(dst, '\n'); p++; break;
-            case 'r':  g_string_append_c(dst, '\r'); p++; break;
-            case 't':  g_string_append_c(dst, '\t'); p++; break;
-            case 'u':
-            {
-                if (p + 4 >= e) { p = e; break; }
-                int h1 = hexval(*(p+1));
-                int h2 = hexval(*(p+2));
-                int h3 = hexval(*(p+3));
-                int h4 = hexval(*(p+4));
-                if (h1 < 0 || h2 < 0 || h3 < 0 || h4 < 0) { p++; break; }
-                guint32 u = (guint32)((h1<<12) | (h2<<8) | (h3<<4) | h4);
-                p += 5;
-                if (u >= 0xD800 && u <= 0xDBFF)
-                {
-                    if (p + 1 < e && *p == '\\' && *(p+1) == 'u' && p + 6 <= e)
-                    {
-                        int h5 = hexval(*(p+2));
-                        int h6 = hexval(*(p+3));
-                        int h7 = hexval(*(p+4));
-                        int h8 = hexval(*(p+5));
-                        guint32 u2 = (guint32)((h5<<12)|(h6<<8)|(h7<<4)|h8);
-                        if (h5>=0 && h6>=0 && h7>=0 && h8>=0 &&
-                            u2 >= 0xDC00 && u2 <= 0xDFFF)
-                        {
-                            guint32 cp = 0x10000 + (((u - 0xD800) << 10) | (u2 - 0xDC00));
-                            gstring_append_utf8_cp(dst, cp);
-                            p += 6;
-                            break;
-                        }
-                    }
-                    gstring_append_utf8_cp(dst, 0xFFFD);
-                }
-                else
-                {
-                    gstring_append_utf8_cp(dst, u);
-                }
-                break;
-            }
-            default:
-                g_string_append_c(dst, *p++);
-                break;
-        }
+        req->t_first = now;
+        if (req->hedge)
+            hedge_claim(req);
+    }
+    else
+    {
+        if (!req->gaps)
+            req->gaps = g_array_sized_new(FALSE, FALSE, sizeof(guint32), 256);
+        guint32 gap = (guint32)MIN(now - req->t_last, (gint64)G_MAXUINT32);
+        g_array_append_val(req->gaps, gap);
     }
+    req->t_last = now;
+    req->chunks++;
+}
+
+/* One complete JSON document (a line, an SSE event or a whole body) */
+static void parse_document(Req *req, const char *data, size_t len)
+{
+    gsize before = req->accum ? req->accum->len : 0;
+    json_stream_reset(req->parser);
+    json_stream_feed(req->parser, data, len);
+    if (req->accum && req->accum->len > before)
+        note_chunk(req);
+}
+
+/* --- Streaming callbacks ------------------------------------------------- */
+
+/* Overloaded or unreachable upstream: worth asking again */
+static gboolean status_retryable(long code)
+{
+    return code == 429 || code == 502 || code == 503 || code == 504;
 }
 
-/* --- Stream append via UI callback --------------------------------------- */
+/* Body of a response that will be retried: not shown, not parsed */
+static gboolean skip_body(Req *req)
+{
+    return status_retryable(req->http_status) && req->attempt < req->retry_max;
+}
 
-static void append_decoded_segment(Req *req, const char *start, const char *end)
+/* Retry-After is either delta-seconds or an HTTP date */
+static gint64 parse_retry_after(const char *v, size_t len)
 {
-    GString *dec = g_string_new(NULL);
-    json_unescape_append(dec, start, end);
-    if (dec->len)
+    gchar *s = g_strstrip(g_strndup(v, len));
+    gint64 us = -1;
+
+    if (*s && g_ascii_isdigit(*s))
+        us = g_ascii_strtoll(s, NULL, 10) * G_USEC_PER_SEC;
+    else if (*s)
     {
-        if (!req->accum) req->accum = g_string_new(NULL);
-        g_string_append_len(req->accum, dec->str, dec->len);
-        if (g_stream_append)
-            g_stream_append(req, dec->str, (gssize)dec->len);
+        time_t when = curl_getdate(s, NULL);
+        if (when != -1)
+            us = MAX((gint64)(when - time(NULL)), 0) * G_USEC_PER_SEC;
     }
-    g_string_free(dec, TRUE);
+    g_free(s);
+    return us;
 }
 
-static gboolean extract_content_and_append(const char *line, size_t len, Req *req)
+static size_t header_cb(char *buf, size_t size, size_t nm, void *ud)
 {
-    const char *c = strstr(line, "\"content\"");
-    if (!c || c >= line + len) return FALSE;
-    c = strchr(c, ':');
-    if (!c) return FALSE;
-    c++;
-    while (c < line + len && *c == ' ') c++;
-    if (c >= line + len || *c != '\"') return FALSE;
-    c++;
-    const char *p = c;
-    while (p < line + len)
+    Req *req = (Req *)ud;
+    size_t r = size * nm;
+
+    /* Each status line starts a response (redirects, 100 Continue) */
+    if (r > 5 && memcmp(buf, "HTTP/", 5) == 0)
     {
-        if (*p == '"' && *(p - 1) != '\\') break;
-        p++;
+        const char *sp = memchr(buf, ' ', r);
+        req->http_status = sp ? (long)g_ascii_strtoll(sp + 1, NULL, 10) : 0;
+        req->retry_after = -1;
+        capture_status(req->capture, req->http_status);
     }
-    if (p > line + len) return FALSE;
-    append_decoded_segment(req, c, p);
-    return TRUE;
+    else if (r > 12 && g_ascii_strncasecmp(buf, "Retry-After:", 12) == 0)
+        req->retry_after = parse_retry_after(buf + 12, r - 12);
+    return r;
 }
 
-/* --- Streaming callbacks ------------------------------------------------- */
+static void on_json_line(gpointer ud, const gchar *line, gsize len)
+{
+    parse_document((Req *)ud, line, len);
+}
+
+static void on_sse_event(gpointer ud, const gchar *data, gsize len)
+{
+    Req *req = (Req *)ud;
+    if (len == 6 && memcmp(data, "[DONE]", 6) == 0)
+    {
+        req->reply.done = TRUE;
+        return;
+    }
+    parse_document(req, data, len);
+}
 
 static size_t stream_cb_ollama(void *ptr, size_t size, size_t nm, void *ud)
 {
     Req *req = (Req *)ud;
     if (g_atomic_int_get(&req->cancel)) return 0;
     size_t r = size * nm;
-    if (!req->carry) req->carry = g_string_new(NULL);
-    g_string_append_len(req->carry, (const gchar *)ptr, r);
-
-    for (;;)
-    {
-        char *nl = memchr(req->carry->str, '\n', req->carry->len);
-        if (!nl) break;
-        size_t linelen = (size_t)(nl - req->carry->str);
-        if (linelen > 0)
-            extract_content_and_append(req->carry->str, linelen, req);
-        g_string_erase(req->carry, 0, linelen + 1);
-    }
+    if (skip_body(req)) return r;
+    capture_data(req->capture, (const gchar *)ptr, r);
+    framer_feed_lines(&req->framer, (const gchar *)ptr, r, on_json_line, req);
+    push_new_text(req);
     return r;
 }
 
@@ -213,23 +335,10 @@ static size_t stream_cb_openai(void *ptr, size_t size, size_t nm, void *ud)
     Req *req = (Req *)ud;
     if (g_atomic_int_get(&req->cancel)) return 0;
     size_t r = size * nm;
-    if (!req->carry2) req->carry2 = g_string_new(NULL);
-    g_string_append_len(req->carry2, (const gchar *)ptr, r);
-
-    for (;;)
-    {
-        char *start = strstr(req->carry2->str, "data:");
-        if (!start) break;
-        char *sep = strstr(start, "\n\n");
-        if (!sep) break;
-
-        size_t evlen = (size_t)(sep - start);
-        if (!g_str_has_prefix(start + 5, " [DONE]"))
-            extract_content_and_append(start, evlen, req);
-
-        size_t erase_len = (sep - req->carry2->str) + 2;
-        g_string_erase(req->carry2, 0, erase_len);
-    }
+    if (skip_body(req)) return r;
+    capture_data(req->capture, (const gchar *)ptr, r);
+    framer_feed_sse(&req->framer, (const gchar *)ptr, r, on_sse_event, req);
+    push_new_text(req);
     return r;
 }
 
@@ -241,84 +350,204 @@ static int xferinfo_cb(void *clientp, curl_off_t a, curl_off_t b, curl_off_t c,
     return 0;
 }
 
-/* --- Network thread ------------------------------------------------------ */
+/* --- Transfer setup (main thread) ---------------------------------------- */
 
-static gpointer net_thread(gpointer data)
+typedef struct
 {
-    Req *req = (Req *)data;
-    CURL *curl = curl_easy_init();
-    if (!curl)
-    {
-        if (g_stream_append)
-            g_stream_append(req, "[Erreur] curl init\n", -1);
-        goto done;
-    }
+    Req               *req;
+    gchar             *url;
+    gchar             *payload;
+    gsize              payload_len;   /* Raw JSON size */
+    gsize              messages_end;  /* Offset of the messages array's ']' */
+    gchar             *resume;        /* Payload continuing a cut stream */
+    guchar            *body;          /* gzip-coded payload, if used */
+    gsize              body_len;
+    struct curl_slist *hdr;
+    gint               timeout;       /* prefs.timeout when set up */
+    struct Mem         mem;   /* Non-streaming response body */
+} Xfer;
 
-    gchar *url = NULL;
-    gchar *payload = NULL;
-    struct curl_slist *hdr = NULL;
+/* @messages_end receives the offset of the ']' closing "messages" */
+static gchar* build_payload(Req *req, gsize *messages_end)
+{
+    GString *gs = g_string_new(NULL);
 
     if (req->mode == API_OLLAMA)
     {
-        url = g_strdup_printf("%s/api/chat", req->base);
-        history_add("user", req->prompt);
-        {
-            GString *gs = g_string_new(NULL);
-            g_string_append(gs, "{\"model\":\"");
-            g_string_append(gs, req->model);
-            g_string_append(gs, "\",\"messages\":");
-            g_string_append(gs, history_get_json());
-            g_string_append(gs, ",\"stream\":");
-            g_string_append(gs, req->streaming ? "true" : "false");
-            g_string_append(gs, ",\"options\":{");
-            json_append_double(gs, "temperature", req->temp);
-            g_string_append(gs, "}}");
-            payload = g_string_free(gs, FALSE);
-        }
-        hdr = curl_slist_append(hdr, "Content-Type: application/json");
+        history_add_escaped(req->history, "user", req->prompt, req->prompt_json);
+        g_string_append(gs, "{\"model\":\"");
+        g_string_append(gs, req->model);
+        g_string_append(gs, "\",\"messages\":");
+        history_append_json(req->history, gs);
+        *messages_end = gs->len - 1;
+        g_string_append(gs, ",\"stream\":");
+        g_string_append(gs, req->streaming ? "true" : "false");
+        g_string_append(gs, ",\"options\":{");
+        json_append_double(gs, "temperature", req->temp);
+        g_string_append(gs, "}}");
     }
     else
     {
-        url = g_strdup_printf("%s/v1/chat/completions", req->base);
-        gchar *esc_user = json_escape(req->prompt);
+        gchar *esc_user = req->prompt_json ? g_strdup(req->prompt_json)
+                                           : json_escape(req->prompt);
+        /* Shown with the rest of the conversation, sent only this once */
+        history_add_shown(req->history, "user", req->prompt, esc_user);
         gchar *esc_sys = NULL;
         gboolean has_sys = (prefs.system_prompt && *prefs.system_prompt);
         if (has_sys) esc_sys = json_escape(prefs.system_prompt);
+
+        g_string_append(gs, "{\"model\":\"");
+        g_string_append(gs, req->model);
+        g_string_append(gs, "\",\"messages\":[");
+        if (has_sys)
         {
-            GString *gs = g_string_new(NULL);
-            g_string_append(gs, "{\"model\":\"");
-            g_string_append(gs, req->model);
-            g_string_append(gs, "\",\"messages\":[");
-            if (has_sys)
-            {
-                g_string_append(gs, "{\"role\":\"system\",\"content\":\"");
-                g_string_append(gs, esc_sys);
-                g_string_append(gs, "\"},");
-            }
-            g_string_append(gs, "{\"role\":\"user\",\"content\":\"");
-            g_string_append(gs, esc_user);
-            g_string_append(gs, "\"}]");
-            g_string_append(gs, ",\"temperature\":");
-            json_append_double(gs, NULL, req->temp);
-            g_string_append(gs, ",\"stream\":");
-            g_string_append(gs, req->streaming ? "true" : "false");
-            g_string_append(gs, "}");
-            payload = g_string_free(gs, FALSE);
+            g_string_append(gs, "{\"role\":\"system\",\"content\":\"");
+            g_string_append(gs, esc_sys);
+            g_string_append(gs, "\"},");
         }
+        g_string_append(gs, "{\"role\":\"user\",\"content\":\"");
+        g_string_append(gs, esc_user);
+        g_string_append(gs, "\"}");
+        *messages_end = gs->len;
+        g_string_append_c(gs, ']');
+        g_string_append(gs, ",\"temperature\":");
+        json_append_double(gs, NULL, req->temp);
+        g_string_append(gs, ",\"stream\":");
+        g_string_append(gs, req->streaming ? "true" : "false");
+        g_string_append(gs, "}");
+
         g_free(esc_user);
         g_free(esc_sys);
-        hdr = curl_slist_append(hdr, "Content-Type: application/json");
-        if (req->api_key && *req->api_key)
-        {
-            gchar *auth = g_strdup_printf("Authorization: Bearer %s", req->api_key);
-            hdr = curl_slist_append(hdr, auth);
-            g_free(auth);
-        }
     }
+    return g_string_free(gs, FALSE);
+}
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, hdr);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload);
+/*
+ * gzip @len bytes of @data into a new buffer. Returns NULL when zlib
+ * fails or the result would not be smaller, so the caller sends it as is.
+ */
+static guchar* gzip_encode(const gchar *data, gsize len, gsize *out_len)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+
+    /* 15 + 16: gzip wrapper rather than zlib; level 3 keeps large
+     * attachments to a few milliseconds */
+    if (deflateInit2(&zs, 3, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    gsize cap = deflateBound(&zs, (uLong)len);
+    guchar *out = g_malloc(cap);
+    zs.next_in = (Bytef *)data;
+    zs.avail_in = (uInt)len;
+    zs.next_out = out;
+    zs.avail_out = (uInt)cap;
+
+    int rc = deflate(&zs, Z_FINISH);
+    *out_len = zs.total_out;
+    deflateEnd(&zs);
+
+    if (rc != Z_STREAM_END || *out_len >= len)
+    {
+        g_free(out);
+        return NULL;
+    }
+    return out;
+}
+
+static struct curl_slist* build_headers(Req *req, gboolean gzip)
+{
+    struct curl_slist *hdr = NULL;
+
+    hdr = curl_slist_append(hdr, "Content-Type: application/json");
+    if (gzip)
+        hdr = curl_slist_append(hdr, "Content-Encoding: gzip");
+    if (req->mode == API_OPENAI && req->api_key && *req->api_key)
+    {
+        gchar *auth = g_strdup_printf("Authorization: Bearer %s", req->api_key);
+        hdr = curl_slist_append(hdr, auth);
+        g_free(auth);
+    }
+    return hdr;
+}
+
+/* Post @json, gzip-coded when the backend takes it (any thread) */
+static void xfer_set_body(Xfer *x, CURL *curl, const gchar *json, gsize len)
+{
+    g_clear_pointer(&x->body, g_free);
+    if (x->req->gzip_request && len >= GZIP_MIN_BODY)
+        x->body = gzip_encode(json, len, &x->body_len);
+
+    curl_slist_free_all(x->hdr);
+    x->hdr = build_headers(x->req, x->body != NULL);
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, x->hdr);
+
+    if (x->body)
+    {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, x->body);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)x->body_len);
+    }
+    else
+    {
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json);
+        curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE, (curl_off_t)len);
+    }
+    stats_add_request(len, x->body ? x->body_len : len);
+}
+
+/* Where the request actually goes: its pool member, or its base URL */
+static const gchar* req_server(const Req *req)
+{
+    return req->endpoint ? req->endpoint : req->base;
+}
+
+static gchar* chat_url(const Req *req, const gchar *base)
+{
+    if (req->mode == API_OLLAMA)
+        return g_strdup_printf("%s/api/chat", base);
+    return g_strdup_printf("%s/v1/chat/completions", base);
+}
+
+static Xfer* xfer_new(Req *req)
+{
+    Xfer *x = g_new0(Xfer, 1);
+    x->req = req;
+    x->url = chat_url(req, req->base);
+    x->payload = build_payload(req, &x->messages_end);
+    x->payload_len = strlen(x->payload);
+    return x;
+}
+
+/* Non-streamed body: recorded, then collected */
+static size_t body_cb(void *ptr, size_t size, size_t nm, void *ud)
+{
+    Xfer *x = (Xfer *)ud;
+    capture_data(x->req->capture, (const gchar *)ptr, size * nm);
+    return collect_cb(ptr, size, nm, &x->mem);
+}
+
+static void xfer_free(Xfer *x)
+{
+    curl_slist_free_all(x->hdr);
+    g_free(x->url);
+    g_free(x->payload);
+    g_free(x->resume);
+    g_free(x->body);
+    g_free(x->mem.data);
+    g_free(x);
+}
+
+static void xfer_setup(Xfer *x, CURL *curl)
+{
+    Req *req = x->req;
+
+    x->timeout = prefs.timeout;
+
+    xfer_set_body(x, curl, x->payload, x->payload_len);
+
+    curl_easy_setopt(curl, CURLOPT_URL, x->url);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, header_cb);
+    curl_easy_setopt(curl, CURLOPT_HEADERDATA, req);
     curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo_cb);
     curl_easy_setopt(curl, CURLOPT_XFERINFODATA, req);
     curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
@@ -327,108 +556,1251 @@ static gpointer net_thread(gpointer data)
     if (prefs.timeout > 0)
         curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)prefs.timeout);
 
-    /* Apply proxy if configured */
-    if (prefs.proxy && *prefs.proxy)
+    /* A local socket bypasses the proxy; the URL still gives Host and path */
+    if (req->unix_socket && *req->unix_socket)
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, req->unix_socket);
+    else if (prefs.proxy && *prefs.proxy)
         curl_easy_setopt(curl, CURLOPT_PROXY, prefs.proxy);
 
     if (req->streaming)
     {
         if (req->mode == API_OLLAMA)
-        {
             curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_cb_ollama);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
-        }
         else
-        {
             curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stream_cb_openai);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
-        }
-        CURLcode rc = curl_easy_perform(curl);
-        if (rc == CURLE_ABORTED_BY_CALLBACK)
-        {
-            if (g_stream_append)
-                g_stream_append(req, "\n[Annulé]\n", -1);
-        }
-        else if (rc != CURLE_OK)
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, req);
+
+        /* Stall detector: under 1 byte/s for stall_secs fails the
+         * transfer with CURLE_OPERATION_TIMEDOUT, which is retried */
+        if (req->stall_secs > 0)
         {
-            long code = 0; curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-            gchar *msg = g_strdup_printf("\n[Erreur] streaming: %s (HTTP %ld)\n", curl_easy_strerror(rc), code);
-            if (g_stream_append)
-                g_stream_append(req, msg, -1);
-            g_free(msg);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)req->stall_secs);
         }
     }
     else
     {
-        struct Mem mem = {0};
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, collect_cb);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &mem);
-        CURLcode rc = curl_easy_perform(curl);
-        if (rc == CURLE_ABORTED_BY_CALLBACK)
-        {
-            if (g_stream_append)
-                g_stream_append(req, "\n[Annulé]\n", -1);
-        }
-        else if (rc != CURLE_OK)
-        {
-            long code = 0; curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-            gchar *msg = g_strdup_printf("\n[Erreur] requête: %s (HTTP %ld)\n", curl_easy_strerror(rc), code);
-            if (g_stream_append)
-                g_stream_append(req, msg, -1);
-            g_free(msg);
-        }
-        else if (mem.data && mem.size)
-        {
-            long code = 0; curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
-            if (code >= 300)
-            {
-                gchar *msg = g_strdup_printf("\n[Erreur] HTTP %ld\n", code);
-                if (g_stream_append)
-                    g_stream_append(req, msg, -1);
-                g_free(msg);
-            }
-            extract_content_and_append(mem.data, mem.size, req);
-        }
-        g_free(mem.data);
+        /* Whole replies compress well; streams stay identity-coded since
+         * a compressing server or proxy may hold tokens back to fill its
+         * window. "" offers every coding this libcurl can decode. */
+        curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, body_cb);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, x);
     }
+}
 
-    curl_slist_free_all(hdr);
-    curl_easy_cleanup(curl);
-    g_free(url);
-    g_free(payload);
+static void req_free(Req *req)
+{
+    g_free(req->prompt);
+    g_free(req->prompt_json);
+    g_free(req->base);
+    g_free(req->model);
+    g_free(req->api_key);
+    g_free(req->unix_socket);
+    g_free(req->pool);
+    g_free(req->endpoint);
+    g_free(req->hedge_to);
+    if (req->own_history)
+        history_free(req->history);
+    framer_clear(&req->framer);
+    byte_ring_unref(req->stream_ring);
+    if (req->accum)  g_string_free(req->accum, TRUE);
+    json_stream_free(req->parser);
+    reply_clear(&req->reply);
+    g_free(req->row_note);
+    g_free(req->cache_key);
+    capture_close(req->capture);
+    if (req->followers) g_ptr_array_free(req->followers, TRUE);
+    if (req->gaps) g_array_free(req->gaps, TRUE);
+    g_free(req);
+}
+
+/* --- Completion ---------------------------------------------------------- */
+
+static gboolean finish_idle_cb(gpointer data);
+static Req* hedge_settle(Req *req);
 
-done:
+/*
+ * Only deterministic replies are stored and replayed: at a temperature
+ * above 0, asking again is meant to give another answer.
+ */
+static gboolean cache_replayable(const Req *req)
+{
+    return req->temp == 0.0;
+}
+
+/* Give the final text of @req to the requests that shared its stream */
+static void finish_followers(Req *req, const gchar *final)
+{
+    g_mutex_lock(&follow_lock);
+    GPtrArray *fs = req->followers;
+    req->followers = NULL;
+    g_mutex_unlock(&follow_lock);
+    if (!fs)
+        return;
+
+    for (guint i = 0; i < fs->len; i++)
     {
-        gchar *final = req->accum ? g_string_free(req->accum, FALSE) : g_strdup("");
-        req->accum = NULL;
+        Req *f = g_ptr_array_index(fs, i);
+        f->leader = NULL;
+        if (!f->accum)
+            f->accum = g_string_new(NULL);
+        g_string_assign(f->accum, final);
+        f->row_note = g_strdup(req->complete ? "⇆ Réponse partagée avec une requête identique"
+                                             : "⇆ Réponse partagée, incomplète");
+        finish_idle_cb(f);
+    }
+    g_ptr_array_free(fs, TRUE);
+}
 
-        if (final && *final)
-            history_add("assistant", final);
+static gboolean finish_idle_cb(gpointer data)
+{
+    Req *req = (Req *)data;
+    if (req->hedge && !(req = hedge_settle(req)))
+        return FALSE;
 
-        if (g_replace_row)
-            g_replace_row(req->row, final);
-        else
-            g_free(final);
+    gchar *final = req->accum ? g_string_free(req->accum, FALSE) : g_strdup("");
+    req->accum = NULL;
+
+    if (req->cache_key && inflight &&
+        g_hash_table_lookup(inflight, req->cache_key) == req)
+    {
+        g_hash_table_remove(inflight, req->cache_key);
+        if (req->complete && prefs.cache_enabled && cache_replayable(req))
+            respcache_store(req->cache_key, final,
+                            (gint64)prefs.cache_max_mb * 1024 * 1024);
+    }
+    finish_followers(req, final);
+
+    /* Stopped while feeding other rows: its own row is already done */
+    if (g_atomic_int_get(&req->row_gone))
+    {
+        g_free(final);
+        req_free(req);
+        return FALSE;
     }
 
+    if (final && *final && !req->replay)
+        history_add(req->history, "assistant", final);
+
+    if (g_replace_row)
+        g_replace_row(req->row, final, req->has_timing ? &req->timing : NULL);
+    g_free(final);
+    if (req->row_note && g_row_status)
+        g_row_status(req->row, req->row_note);
+
     if (g_set_busy)
-        g_set_busy(FALSE);
+        g_set_busy(req, FALSE);
 
-    g_free(req->prompt);
-    g_free(req->base);
-    g_free(req->model);
-    g_free(req->api_key);
-    if (req->carry)  g_string_free(req->carry, TRUE);
-    if (req->carry2) g_string_free(req->carry2, TRUE);
-    current_req = NULL;
-    g_free(req);
+    req_free(req);
+    return FALSE;
+}
+
+static void report_error(Req *req, const char *what, CURL *curl, CURLcode rc)
+{
+    long code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    add_row_note(req, g_strdup_printf("[Erreur] %s: %s (HTTP %ld)", what,
+                                      curl_easy_strerror(rc), code));
+}
+
+/* --- Timing (I/O thread) ------------------------------------------------ */
+
+static gint64 info_us(CURL *curl, CURLINFO what)
+{
+    curl_off_t v = 0;
+    curl_easy_getinfo(curl, what, &v);
+    return (gint64)v;
+}
+
+/* Figures derived from the content chunks, then into the per-model stats */
+static void timing_finish(Req *req, ReqTiming *t)
+{
+    t->when = g_get_real_time();
+    t->first_token = req->t_first ? req->t_first - req->t_start : -1;
+    t->tokens = req->reply.eval_count > 0 ? req->reply.eval_count : req->chunks;
+
+    /* Generation speed: between first and last chunk when streaming,
+     * over the whole request otherwise */
+    gint64 span = req->streaming ? req->t_last - req->t_first : t->total;
+    if (t->tokens > 1 && span > 0)
+        t->tokens_per_s = (gdouble)(req->streaming ? t->tokens - 1 : t->tokens)
+                          * G_USEC_PER_SEC / span;
+    stats_timing_set_gaps(t, req->gaps);
+
+    req->has_timing = TRUE;
+    stats_add_timing(req->model, t);
+}
+
+static void record_timing(Req *req, CURL *curl)
+{
+    ReqTiming *t = &req->timing;
+    gint64 dns = info_us(curl, CURLINFO_NAMELOOKUP_TIME_T);
+    gint64 conn = info_us(curl, CURLINFO_CONNECT_TIME_T);
+    gint64 app = info_us(curl, CURLINFO_APPCONNECT_TIME_T);
+
+    /* curl's times are cumulative from the start of the transfer */
+    memset(t, 0, sizeof *t);
+    t->dns = dns;
+    t->connect = MAX(conn - dns, 0);
+    t->tls = app > 0 ? MAX(app - conn, 0) : 0;
+    t->ttfb = info_us(curl, CURLINFO_STARTTRANSFER_TIME_T);
+    t->total = info_us(curl, CURLINFO_TOTAL_TIME_T);
+    timing_finish(req, t);
+}
+
+/* --- Endpoint pools ----------------------------------------------------- */
+
+/* Runs on the I/O thread */
+static void probe_done(CURL *curl, CURLcode rc, gpointer data)
+{
+    gchar *url = (gchar *)data;
+    long code = 0;
+
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    endpoints_probed(url, rc == CURLE_OK && code > 0 && code < 500);
+    netpool_release(url, curl);
+    g_free(url);
+}
+
+/* Ask an ejected pool member whether it is back: a HEAD on its base URL */
+static void pool_probe(const gchar *url)
+{
+    CURL *curl = netpool_acquire(url);
+    if (!curl)
+    {
+        endpoints_probed(url, FALSE);
+        return;
+    }
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 3L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    if (prefs.proxy && *prefs.proxy)
+        curl_easy_setopt(curl, CURLOPT_PROXY, prefs.proxy);
+    netloop_add(curl, probe_done, g_strdup(url));
+}
+
+/* Send @req to the best member of its pool (main thread) */
+static void pool_pick(Req *req, Xfer *x)
+{
+    GPtrArray *probes = g_ptr_array_new_with_free_func(g_free);
+
+    req->endpoint = endpoints_pick(req->base, req->pool, NULL, probes);
+    g_free(x->url);
+    x->url = chat_url(req, req->endpoint);
+
+    for (guint i = 0; i < probes->len; i++)
+        pool_probe(g_ptr_array_index(probes, i));
+    g_ptr_array_unref(probes);
+}
+
+/*
+ * A pooled request failed in a way worth retrying: count it against its
+ * member and send the retry elsewhere if another one is in rotation.
+ */
+static void pool_move(Xfer *x, CURL *curl)
+{
+    Req *req = x->req;
+    gchar *old = req->endpoint;
+
+    endpoints_report(old, FALSE, 0);
+    req->endpoint = endpoints_pick(req->base, req->pool, old, NULL);
+    endpoints_release(old);
+    g_free(old);
+
+    g_free(x->url);
+    x->url = chat_url(req, req->endpoint);
+    curl_easy_setopt(curl, CURLOPT_URL, x->url);
+}
+
+/* Outcome of the last attempt of a pooled request (I/O thread) */
+static void pool_done(Req *req, CURL *curl, CURLcode rc)
+{
+    if (rc != CURLE_ABORTED_BY_CALLBACK)
+    {
+        curl_off_t ttfb = 0;
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+        endpoints_report(req->endpoint,
+                         rc == CURLE_OK && !status_retryable(req->http_status) &&
+                         req->http_status < 500,
+                         (gint64)ttfb);
+    }
+    endpoints_release(req->endpoint);
+}
+
+/* --- Retries (I/O thread) ----------------------------------------------- */
+
+static void xfer_done(CURL *curl, CURLcode rc, gpointer data);
+
+static gboolean rc_transient(CURLcode rc)
+{
+    switch (rc)
+    {
+        case CURLE_COULDNT_CONNECT:
+        case CURLE_OPERATION_TIMEDOUT:   /* Includes the stall detector */
+        case CURLE_SEND_ERROR:
+        case CURLE_RECV_ERROR:
+        case CURLE_GOT_NOTHING:
+        case CURLE_PARTIAL_FILE:
+        case CURLE_HTTP2:
+        case CURLE_HTTP2_STREAM:
+            return TRUE;
+        default:
+            return FALSE;
+    }
+}
+
+/* Why the transfer should be retried, or NULL (caller frees) */
+static gchar* retry_reason(Xfer *x, CURL *curl, CURLcode rc)
+{
+    Req *req = x->req;
+
+    if (rc != CURLE_OK)
+    {
+        if (!rc_transient(rc))
+            return NULL;
+        /* The overall timeout would only strike again */
+        curl_off_t total = 0;
+        curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+        if (rc == CURLE_OPERATION_TIMEDOUT && x->timeout > 0 &&
+            total >= (curl_off_t)x->timeout * G_USEC_PER_SEC)
+            return NULL;
+        return g_strdup(curl_easy_strerror(rc));
+    }
+    if (status_retryable(req->http_status))
+        return g_strdup_printf("HTTP %ld", req->http_status);
+    /* Connection closed cleanly but the reply never finished */
+    if (req->streaming && req->http_status < 300 && !reply_finished(&req->reply) &&
+        !req->reply.failed)
+        return g_strdup("flux interrompu");
     return NULL;
 }
 
-void network_send_request(Req *req)
+/* Exponential backoff with equal jitter, or the server's Retry-After */
+static gint64 retry_delay(Req *req)
 {
-    current_req = req;
-    if (g_set_busy)
-        g_set_busy(TRUE);
-    g_thread_new("ai_chat_http", net_thread, req);
+    gint64 cap = MIN((gint64)G_USEC_PER_SEC << MIN(req->attempt, 10), RETRY_BACKOFF_MAX_US);
+    gint64 half = cap / 2;
+    gint64 delay = half + (gint64)g_random_int_range(0, (gint32)(half / 1000) + 1) * 1000;
+    return MAX(delay, req->retry_after);
+}
+
+/* Main thread: the row is empty, the text of the new attempt can go in */
+static gboolean restart_row_idle(gpointer data)
+{
+    Req *req = (Req *)data;
+    if (g_restart_row && !g_atomic_int_get(&req->row_gone))
+        g_restart_row(req);
+    g_atomic_int_set(&req->restarting, 0);
+    return FALSE;
+}
+
+/*
+ * The answer of @req starts over: forget its text and have its row
+ * emptied, along with those of the requests sharing its stream. The
+ * clearing is queued before the request can finish, so @req is alive.
+ */
+static void restart_answer(Req *req)
+{
+    g_mutex_lock(&follow_lock);
+    g_string_truncate(req->accum, 0);
+    req->pushed = 0;
+    g_atomic_int_set(&req->restarting, 1);
+    g_idle_add(restart_row_idle, req);
+
+    for (guint i = 0; req->followers && i < req->followers->len; i++)
+    {
+        Req *f = g_ptr_array_index(req->followers, i);
+        if (f->accum)
+            g_string_truncate(f->accum, 0);
+        f->pushed = 0;
+        g_atomic_int_set(&f->restarting, 1);
+        g_idle_add(restart_row_idle, f);
+    }
+    g_mutex_unlock(&follow_lock);
+}
+
+/*
+ * Re-issue the request if the failure looks transient. In Ollama mode a
+ * stream cut after some text goes out again with that text as a trailing
+ * assistant message, which Ollama continues, so the new tokens extend the
+ * same row. OpenAI-compatible servers would answer from scratch: there the
+ * text is dropped and the row emptied before the new attempt.
+ */
+static gboolean xfer_retry(Xfer *x, CURL *curl, CURLcode rc)
+{
+    Req *req = x->req;
+
+    if (netloop_stopping() || g_atomic_int_get(&req->cancel) ||
+        req->attempt >= req->retry_max)
+        return FALSE;
+    gchar *why = retry_reason(x, curl, rc);
+    if (!why)
+        return FALSE;
+    if (req->retry_after > RETRY_AFTER_MAX_US)
+    {
+        g_free(why);
+        return FALSE;
+    }
+
+    gint64 delay = retry_delay(req);
+    gboolean cut = req->streaming && req->accum && req->accum->len > 0;
+    gboolean resume = cut && req->mode == API_OLLAMA;
+    req->attempt++;
+    if (req->endpoint)
+        pool_move(x, curl);
+
+    if (g_row_status && !g_atomic_int_get(&req->row_gone))
+    {
+        gchar *msg = g_strdup_printf("↻ %s — %s %d/%d dans %.0f s", why,
+                                     resume ? "reprise" : "nouvelle tentative",
+                                     req->attempt, req->retry_max,
+                                     (gdouble)delay / G_USEC_PER_SEC);
+        g_row_status(req->row, msg);
+        g_free(msg);
+    }
+    g_free(why);
+    if (cut && !resume)
+        restart_answer(req);
+
+    /* Timings describe the last attempt, from when it starts: the backoff
+     * stays out of the first token, the gaps and the stats */
+    req->t_start = g_get_monotonic_time() + delay;
+    req->t_first = 0;
+    req->t_last = 0;
+    req->chunks = 0;
+    if (req->gaps)
+        g_array_set_size(req->gaps, 0);
+
+    /* Fresh response state; the text shown so far stays in accum */
+    framer_clear(&req->framer);
+    reply_clear(&req->reply);
+    req->http_status = 0;
+    req->retry_after = -1;
+    g_clear_pointer(&x->mem.data, g_free);
+    x->mem.size = 0;
+
+    if (resume)
+    {
+        GString *gs = g_string_sized_new(x->payload_len + req->accum->len + 64);
+        g_string_append_len(gs, x->payload, (gssize)x->messages_end);
+        g_string_append(gs, ",{\"role\":\"assistant\",\"content\":\"");
+        json_escape_append(gs, req->accum->str, (gssize)req->accum->len);
+        g_string_append(gs, "\"}");
+        g_string_append(gs, x->payload + x->messages_end);
+        g_free(x->resume);
+        gsize len = gs->len;
+        x->resume = g_string_free(gs, FALSE);
+        xfer_set_body(x, curl, x->resume, len);
+    }
+
+    netloop_add_delayed(curl, delay, &req->cancel, xfer_done, x);
+    return TRUE;
+}
+
+/* Runs on the I/O thread */
+static void xfer_done(CURL *curl, CURLcode rc, gpointer data)
+{
+    Xfer *x = (Xfer *)data;
+    Req *req = x->req;
+
+    /* A last JSON line may come without its newline */
+    if (rc == CURLE_OK && req->streaming && req->mode == API_OLLAMA &&
+        !skip_body(req))
+    {
+        framer_flush_lines(&req->framer, on_json_line, req);
+        push_new_text(req);
+    }
+
+    /* However it noticed (write callback, progress callback, the loop) */
+    if (rc != CURLE_OK && g_atomic_int_get(&req->cancel))
+        rc = CURLE_ABORTED_BY_CALLBACK;
+
+    if (xfer_retry(x, curl, rc))
+        return;
+
+    /* A racer that lost was cancelled by the winner: it says nothing
+       about the backend or about Stop */
+    gboolean lost = hedge_lost(req);
+    if (rc == CURLE_ABORTED_BY_CALLBACK && req->t_cancel && !lost)
+        stats_add_stop(g_get_monotonic_time() - req->t_cancel);
+
+    req->complete = rc == CURLE_OK && req->http_status < 300 && !req->reply.failed &&
+                    (!req->streaming || reply_finished(&req->reply));
+    if (req->attempt > 0)
+        add_row_note(req, g_strdup_printf(req->complete ? "↻ Réponse obtenue après %d nouvelle(s) tentative(s)"
+                                                        : "↻ Échec après %d nouvelle(s) tentative(s)",
+                                          req->attempt));
+
+    if (rc == CURLE_ABORTED_BY_CALLBACK)
+    {
+        add_row_note(req, g_strdup("[Annulé]"));
+    }
+    else if (rc != CURLE_OK)
+    {
+        report_error(req, req->streaming ? "streaming" : "requête", curl, rc);
+    }
+    else if (req->streaming)
+    {
+        if (req->http_status >= 300 && !req->reply.failed)
+            add_row_note(req, g_strdup_printf("[Erreur] HTTP %ld", req->http_status));
+    }
+    else if (x->mem.data && x->mem.size)
+    {
+        curl_off_t wire = 0;
+        if (!lost && curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T, &wire) == CURLE_OK)
+            stats_add_response(x->mem.size, (gsize)wire);
+
+        long code = 0; curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+        if (code >= 300)
+            add_row_note(req, g_strdup_printf("[Erreur] HTTP %ld", code));
+        parse_document(req, x->mem.data, x->mem.size);
+        push_new_text(req);
+    }
+
+    if (rc == CURLE_OK && req->t_first && !lost)
+        record_timing(req, curl);
+
+    if (rc == CURLE_OK && !lost)
+    {
+        curl_off_t ttfb = 0;
+        long conns = 0;
+        curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+        curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &conns);
+        stats_add_ttfb((gint64)ttfb, conns == 0);
+    }
+
+    if (req->endpoint)
+        pool_done(req, curl, rc);
+    netpool_release(req_server(req), curl);
+    xfer_free(x);
+
+    /* At unload the main loop will not run our idle callbacks any more */
+    if (netloop_stopping())
+    {
+        for (guint i = 0; req->followers && i < req->followers->len; i++)
+            req_free(g_ptr_array_index(req->followers, i));
+        req_free(req);
+        return;
+    }
+    g_idle_add(finish_idle_cb, req);
+}
+
+/* --- Pre-warming (main thread) ------------------------------------------ */
+
+/* Last use of @base (0 if never), to be updated by the caller */
+static gint64* backend_last_use(const gchar *base)
+{
+    if (!last_use)
+        last_use = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    gint64 *t = g_hash_table_lookup(last_use, base);
+    if (!t)
+    {
+        t = g_new0(gint64, 1);
+        g_hash_table_insert(last_use, g_strdup(base), t);
+    }
+    return t;
+}
+
+/*
+ * Note that @base is about to be used. Returns TRUE if it already was
+ * within PREWARM_FRESH_US, i.e. its connection should still be open.
+ */
+static gboolean touch_backend(const gchar *base)
+{
+    gint64 now = g_get_monotonic_time();
+    gint64 *t = backend_last_use(base);
+    gboolean fresh = now - *t < PREWARM_FRESH_US;
+    *t = now;
+    return fresh;
+}
+
+typedef struct
+{
+    gchar  *base;
+    gint64  prev;    /* last_use before the warm-up */
+    gint64  set;     /* last_use while it runs */
+} Prewarm;
+
+/* A warm-up failed: no connection was left open, forget the use it noted
+ * unless a request has touched the backend since */
+static gboolean prewarm_failed_idle(gpointer data)
+{
+    Prewarm *p = (Prewarm *)data;
+    gint64 *t = last_use ? g_hash_table_lookup(last_use, p->base) : NULL;
+    if (t && *t == p->set)
+        *t = p->prev;
+    g_free(p->base);
+    g_free(p);
+    return FALSE;
+}
+
+/* Runs on the I/O thread */
+static void prewarm_done(CURL *curl, CURLcode rc, gpointer data)
+{
+    Prewarm *p = (Prewarm *)data;
+    /* The connection stays in the shared cache for the next request */
+    netpool_release(p->base, curl);
+    if (rc != CURLE_OK)
+    {
+        g_idle_add(prewarm_failed_idle, p);
+        return;
+    }
+    g_free(p->base);
+    g_free(p);
+}
+
+void network_prewarm(const gchar *base_url, const gchar *unix_socket)
+{
+    if (!base_url || !*base_url)
+        return;
+
+    /* Noted as used at once, so a warm-up in progress is not repeated */
+    Prewarm *p = g_new0(Prewarm, 1);
+    p->prev = *backend_last_use(base_url);
+    if (touch_backend(base_url))
+    {
+        g_free(p);
+        return;
+    }
+    p->base = g_strdup(base_url);
+    p->set = *backend_last_use(base_url);
+
+    CURL *curl = netpool_acquire(base_url);
+    if (!curl)
+    {
+        prewarm_failed_idle(p);
+        return;
+    }
+
+    /*
+     * A HEAD on the base URL rather than CURLOPT_CONNECT_ONLY: connect-only
+     * connections stay tied to their handle, while this one goes back to
+     * the cache where the chat request will pick it up. Proxy settings
+     * must match the chat request for that.
+     */
+    curl_easy_setopt(curl, CURLOPT_URL, base_url);
+    curl_easy_setopt(curl, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 5L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+    if (unix_socket && *unix_socket)
+        curl_easy_setopt(curl, CURLOPT_UNIX_SOCKET_PATH, unix_socket);
+    else if (prefs.proxy && *prefs.proxy)
+        curl_easy_setopt(curl, CURLOPT_PROXY, prefs.proxy);
+
+    netloop_add(curl, prewarm_done, p);
+}
+
+/* --- Response cache (main thread) --------------------------------------- */
+
+/* Finish @req with the cached reply, if there is one */
+static gboolean cache_replay(Req *req)
+{
+    if (!cache_replayable(req))
+        return FALSE;
+    gchar *text = respcache_lookup(req->cache_key);
+    if (!text)
+        return FALSE;
+
+    if (!req->accum)
+        req->accum = g_string_new(NULL);
+    g_string_assign(req->accum, text);
+    g_free(text);
+    req->row_note = g_strdup("⚡ Servi depuis le cache");
+    g_idle_add(finish_idle_cb, req);
+    return TRUE;
+}
+
+/* Attach @req to an identical request in flight, if there is one */
+static gboolean share_inflight(Req *req)
+{
+    Req *leader = inflight ? g_hash_table_lookup(inflight, req->cache_key) : NULL;
+    if (!leader || g_atomic_int_get(&leader->cancel))
+        return FALSE;
+
+    /* The next chunk catches the new row up with the text so far */
+    g_mutex_lock(&follow_lock);
+    if (!leader->followers)
+        leader->followers = g_ptr_array_new();
+    g_ptr_array_add(leader->followers, req);
+    req->leader = leader;
+    g_mutex_unlock(&follow_lock);
+
+    if (g_row_status)
+        g_row_status(req->row, "⇆ Requête identique en cours, réponse partagée");
+    return TRUE;
+}
+
+/*
+ * Stop showing the stream of @req while identical requests still read it:
+ * its row ends now with the text so far and its session is free, but the
+ * transfer goes on for them, and is only cancelled once the last of them
+ * is stopped. Returns FALSE when nobody else reads it.
+ */
+static gboolean leader_detach(Req *req)
+{
+    g_mutex_lock(&follow_lock);
+    if (!req->followers || req->followers->len == 0)
+    {
+        g_mutex_unlock(&follow_lock);
+        return FALSE;
+    }
+    gchar *text = g_strdup(req->accum ? req->accum->str : "");
+    g_atomic_int_set(&req->row_gone, 1);
+    g_mutex_unlock(&follow_lock);
+
+    if (*text)
+        history_add(req->history, "assistant", text);
+    if (g_replace_row)
+        g_replace_row(req->row, text, NULL);
+    if (g_row_status)
+        g_row_status(req->row, "[Annulé] — la réponse partagée continue pour les autres lignes");
+    g_free(text);
+    if (g_set_busy)
+        g_set_busy(req, FALSE);
+    return TRUE;
+}
+
+/* --- Replay ------------------------------------------------------------- */
+
+typedef struct
+{
+    Req         *req;
+    CaptureFile *cap;
+    gdouble      speed;   /* 0: no waiting */
+    GThread     *thread;
+    struct Mem   mem;     /* Non-streamed body */
+    gboolean     cancelled;
+} Replay;
+
+static void replay_free(Replay *rp)
+{
+    capture_file_free(rp->cap);
+    g_free(rp->mem.data);
+    g_free(rp);
+}
+
+static gboolean replay_finish_idle(gpointer data)
+{
+    Replay *rp = (Replay *)data;
+    g_thread_join(rp->thread);
+    g_ptr_array_remove(replays, rp);
+    finish_idle_cb(rp->req);
+    replay_free(rp);
+    return FALSE;
+}
+
+/* Sleep until @due, waking up to notice a cancel */
+static gboolean replay_wait(Req *req, gint64 due)
+{
+    for (;;)
+    {
+        if (g_atomic_int_get(&req->cancel) || g_atomic_int_get(&replay_stopping))
+            return FALSE;
+        gint64 left = due - g_get_monotonic_time();
+        if (left <= 0)
+            return TRUE;
+        g_usleep((gulong)MIN(left, 50000));
+    }
+}
+
+/* What xfer_done does after a transfer, minus curl */
+static void replay_done(Replay *rp)
+{
+    Req *req = rp->req;
+
+    if (!rp->cancelled && req->streaming && req->mode == API_OLLAMA)
+    {
+        framer_flush_lines(&req->framer, on_json_line, req);
+        push_new_text(req);
+    }
+    else if (!rp->cancelled && !req->streaming && rp->mem.size)
+    {
+        parse_document(req, rp->mem.data, rp->mem.size);
+        push_new_text(req);
+    }
+
+    req->complete = !rp->cancelled && req->http_status < 300 && !req->reply.failed &&
+                    (!req->streaming || reply_finished(&req->reply));
+    if (rp->cancelled)
+        add_row_note(req, g_strdup("[Annulé]"));
+    else if (req->http_status >= 300 && !req->reply.failed)
+        add_row_note(req, g_strdup_printf("[Erreur] HTTP %ld", req->http_status));
+
+    /* Only the response side of the timings exists in a capture */
+    if (!rp->cancelled && req->t_first)
+    {
+        memset(&req->timing, 0, sizeof req->timing);
+        req->timing.total = g_get_monotonic_time() - req->t_start;
+        timing_finish(req, &req->timing);
+    }
+}
+
+/*
+ * Hand one recorded body chunk to the parser, which pushes the text to the
+ * row. The stop flag is checked under the lock network_cleanup takes to
+ * clear the UI callbacks, so none goes away while it is in use.
+ */
+static gboolean replay_feed(Replay *rp, const CaptureRecord *r)
+{
+    Req *req = rp->req;
+
+    g_mutex_lock(&replay_lock);
+    if (g_atomic_int_get(&replay_stopping))
+    {
+        g_mutex_unlock(&replay_lock);
+        return FALSE;
+    }
+    if (!req->streaming)
+        collect_cb((void *)r->data, 1, r->len, &rp->mem);
+    else if (req->mode == API_OLLAMA)
+        stream_cb_ollama((void *)r->data, 1, r->len, req);
+    else
+        stream_cb_openai((void *)r->data, 1, r->len, req);
+    g_mutex_unlock(&replay_lock);
+    return TRUE;
+}
+
+static gpointer replay_thread(gpointer data)
+{
+    Replay *rp = (Replay *)data;
+    Req *req = rp->req;
+    gboolean seen_data = FALSE;
+
+    for (guint i = 0; i < rp->cap->records->len; i++)
+    {
+        const CaptureRecord *r = &g_array_index(rp->cap->records, CaptureRecord, i);
+        gint64 due = req->t_start + (rp->speed > 0 ? (gint64)(r->us / rp->speed) : 0);
+        if (!replay_wait(req, due))
+        {
+            rp->cancelled = TRUE;
+            break;
+        }
+
+        if (r->kind == 'S')
+        {
+            /* A new response: what came before it was a retried attempt,
+             * reset as xfer_retry does */
+            req->http_status = r->status;
+            if (seen_data)
+            {
+                framer_clear(&req->framer);
+                reply_clear(&req->reply);
+                g_clear_pointer(&rp->mem.data, g_free);   /* Error body */
+                rp->mem.size = 0;
+                if (req->streaming && req->mode != API_OLLAMA &&
+                    req->accum && req->accum->len > 0)
+                    restart_answer(req);
+                seen_data = FALSE;
+            }
+            continue;
+        }
+        seen_data = TRUE;
+        if (!replay_feed(rp, r))
+        {
+            rp->cancelled = TRUE;
+            break;
+        }
+    }
+
+    /* The flush may push text too */
+    g_mutex_lock(&replay_lock);
+    gboolean stopping = g_atomic_int_get(&replay_stopping);
+    if (!stopping)
+        replay_done(rp);
+    g_mutex_unlock(&replay_lock);
+    if (stopping)
+        return NULL;   /* network_cleanup frees everything */
+    g_idle_add(replay_finish_idle, rp);
+    return NULL;
+}
+
+void network_replay(Req *req, CaptureFile *cap, gdouble speed)
+{
+    if (g_set_busy)
+        g_set_busy(req, TRUE);
+
+    Replay *rp = g_new0(Replay, 1);
+    rp->req = req;
+    rp->cap = cap;
+    rp->speed = speed;
+
+    req->parser = response_parser_new(req);
+    req->http_status = 200;   /* Captures from before status records */
+    req->retry_max = 0;       /* Every recorded body gets parsed */
+    req->retry_after = -1;
+    req->t_start = g_get_monotonic_time();
+    req->replay = TRUE;   /* Its answer was given in another conversation */
+
+    if (!replays)
+        replays = g_ptr_array_new();
+    g_ptr_array_add(replays, rp);
+    rp->thread = g_thread_new("ai-chat-replay", replay_thread, rp);
+}
+
+/* --- Hedging (main thread) ---------------------------------------------- */
+
+/*
+ * A hedged request builds its racer at once, on a copy of the history
+ * taken before its own payload added the prompt (only the system prompt
+ * if the context cannot go to an Ollama preset), and sends it when the
+ * first token is late. Both streams run on the I/O thread, so the first
+ * one with content claims the row without further locking; the loser is
+ * cancelled and loses its ring. The row's request finishes once both
+ * have, with the winner's reply.
+ */
+struct Hedge
+{
+    Req      *primary;
+    Req      *secondary;   /* Built at once, sent when the timer fires */
+    gpointer  winner;      /* First with content (atomic, I/O thread) */
+    ByteRing *ring;        /* The row's stream view, for a winning racer */
+    gchar    *name;        /* Secondary preset */
+    gint64    delay_us;
+    guint     timer;       /* 0 once fired or dropped */
+    gboolean  launched;
+    gint      pending;     /* Requests of the pair still running */
+    Req      *parked;      /* Finished first, waits for the other, or NULL */
+};
+
+static void hedge_free(Hedge *h)
+{
+    if (h->timer)
+        g_source_remove(h->timer);
+    if (hedges)
+        g_ptr_array_remove(hedges, h);
+    byte_ring_unref(h->ring);
+    g_free(h->name);
+    g_free(h);
+}
+
+/* Runs on the I/O thread when @req gets its first content */
+static void hedge_claim(Req *req)
+{
+    Hedge *h = req->hedge;
+
+    if (g_atomic_pointer_compare_and_exchange(&h->winner, NULL, req))
+    {
+        Req *other = req == h->primary ? h->secondary : h->primary;
+        g_atomic_int_set(&other->cancel, 1);
+        netloop_interrupt();
+        if (req == h->secondary)
+        {
+            g_clear_pointer(&other->stream_ring, byte_ring_unref);
+            req->stream_ring = h->ring ? byte_ring_ref(h->ring) : NULL;
+        }
+    }
+    else
+    {
+        /* Lost: what it decoded stays off the screen */
+        g_atomic_int_set(&req->cancel, 1);
+        g_clear_pointer(&req->stream_ring, byte_ring_unref);
+    }
+}
+
+/* @req is one of a hedged pair and the other one got content first */
+static gboolean hedge_lost(Req *req)
+{
+    gpointer winner = req->hedge ? g_atomic_pointer_get(&req->hedge->winner) : NULL;
+    return winner && winner != req;
+}
+
+static gboolean hedge_fire(gpointer data)
+{
+    Hedge *h = (Hedge *)data;
+    h->timer = 0;
+    if (g_atomic_pointer_get(&h->winner) || g_atomic_int_get(&h->primary->cancel))
+        return G_SOURCE_REMOVE;
+
+    h->launched = TRUE;
+    h->pending++;
+    if (g_row_status)
+    {
+        gchar *msg = g_strdup_printf("⏱ Aucun token après %.1f s — relance vers %s",
+                                     (gdouble)h->delay_us / G_USEC_PER_SEC, h->name);
+        g_row_status(h->primary->row, msg);
+        g_free(msg);
+    }
+    network_send_request(h->secondary);
+    return G_SOURCE_REMOVE;
+}
+
+/* How long to wait for a first token before racing @req */
+static gint64 hedge_delay_us(const Req *req)
+{
+    if (req->hedge_ms > 0)
+        return (gint64)req->hedge_ms * 1000;
+    gint64 p = stats_first_token_quantile(req->model, HEDGE_QUANTILE,
+                                          HEDGE_LEARN_LAST, HEDGE_LEARN_MIN);
+    if (p < 0)
+        return (gint64)HEDGE_DEFAULT_MS * 1000;
+    return MAX(p, (gint64)HEDGE_MIN_MS * 1000);
+}
+
+/* Set up the race of @req against its hedge_to preset, before its payload */
+static void hedge_arm(Req *req)
+{
+    const BackendPreset *b = prefs_get_backend(req->hedge_to);
+    if (!b || !b->base_url || !*b->base_url ||
+        (g_strcmp0(b->base_url, req->base) == 0 && g_strcmp0(b->model, req->model) == 0))
+        return;   /* Gone, or the very same backend: nothing to gain */
+
+    Hedge *h = g_new0(Hedge, 1);
+    h->primary = req;
+    h->name = g_strdup(b->name);
+    h->ring = req->stream_ring ? byte_ring_ref(req->stream_ring) : NULL;
+    h->pending = 1;
+
+    Req *s = g_new0(Req, 1);
+    s->prompt       = g_strdup(req->prompt);
+    s->prompt_json  = g_strdup(req->prompt_json);
+    s->mode         = b->api_mode;
+    s->base         = g_strdup(b->base_url);
+    s->model        = g_strdup(b->model);
+    s->temp         = b->temperature;
+    s->api_key      = g_strdup(b->api_key);
+    s->unix_socket  = g_strdup(b->unix_socket);
+    s->pool         = g_strdup(b->url_pool);
+    s->streaming    = req->streaming;
+    s->gzip_request = b->gzip_request;
+    s->retry_max    = b->retry_max;
+    s->stall_secs   = b->stall_secs;
+    s->accum        = g_string_new(NULL);
+    s->history      = history_context_copy(req->history);
+    s->own_history  = TRUE;
+    s->row          = req->row;   /* Retry notes; text only once it wins */
+    s->hedge        = h;
+    g_atomic_int_set(&s->cancel, 0);
+    h->secondary = s;
+
+    h->delay_us = hedge_delay_us(req);
+    h->timer = g_timeout_add((guint)(h->delay_us / 1000), hedge_fire, h);
+    req->hedge = h;
+
+    if (!hedges)
+        hedges = g_ptr_array_new();
+    g_ptr_array_add(hedges, h);
+}
+
+/* No race after all (served from the cache, or sharing a stream) */
+static void hedge_drop(Req *req)
+{
+    Hedge *h = req->hedge;
+    if (!h)
+        return;
+    req_free(h->secondary);
+    hedge_free(h);
+    req->hedge = NULL;
+}
+
+/*
+ * As each of a hedged pair finishes. Returns NULL while the other one
+ * runs, then the primary carrying the winner's reply, to finish the row.
+ */
+static Req* hedge_settle(Req *req)
+{
+    Hedge *h = req->hedge;
+
+    if (h->timer)
+    {
+        g_source_remove(h->timer);   /* Finished before the racer was due */
+        h->timer = 0;
+    }
+    if (--h->pending > 0)
+    {
+        h->parked = req;
+        return NULL;
+    }
+
+    Req *p = h->primary, *s = h->secondary;
+    gdouble after = (gdouble)h->delay_us / G_USEC_PER_SEC;
+    if (h->launched && g_atomic_pointer_get(&h->winner) == s)
+    {
+        GString *t = p->accum;
+        p->accum = s->accum;
+        s->accum = t;
+        p->complete = s->complete;
+        p->has_timing = s->has_timing;
+        p->timing = s->timing;
+        /* As seen from the row: the racer started late */
+        p->timing.first_token += s->t_start - p->t_start;
+        p->timing.total += s->t_start - p->t_start;
+        add_row_note(p, g_strdup_printf("⤳ Réponse de %s (%s), relancé après %.1f s sans token",
+                                        h->name, s->model, after));
+    }
+    else if (h->launched)
+        add_row_note(p, g_strdup_printf("⤳ Relance vers %s après %.1f s ; %s a répondu en premier",
+                                        h->name, after, p->model));
+
+    p->hedge = NULL;
+    req_free(s);
+    hedge_free(h);
+    return p;
+}
+
+/*
+ * At unload, after the I/O thread freed the transfers it still had: no
+ * timer may fire once the plugin is gone, and the racer never sent or the
+ * request waiting for the other of its pair has no owner left
+ */
+static void hedges_stop(void)
+{
+    if (!hedges)
+        return;
+    while (hedges->len > 0)
+    {
+        Hedge *h = g_ptr_array_index(hedges, hedges->len - 1);
+        if (!h->launched)
+            req_free(h->secondary);
+        else if (h->parked)
+            req_free(h->parked);
+        hedge_free(h);
+    }
+    g_clear_pointer(&hedges, g_ptr_array_unref);
+}
+
+/* --- Public API ---------------------------------------------------------- */
+
+void network_send_request(Req *req)
+{
+    if (g_set_busy)
+        g_set_busy(req, TRUE);
+
+    /* Before the payload adds the prompt to the history the racer copies */
+    if (!req->hedge && req->hedge_to && *req->hedge_to)
+        hedge_arm(req);
+    gboolean racer = req->hedge && req->hedge->secondary == req;
+
+    Xfer *x = xfer_new(req);
+
+    /* Model and messages: the payload up to the end of "messages" */
+    if (prefs.cache_enabled && !racer)
+    {
+        req->cache_key = respcache_key(x->url, x->payload, x->messages_end + 1,
+                                       req->temp);
+        if (cache_replay(req) || share_inflight(req))
+        {
+            hedge_drop(req);
+            xfer_free(x);
+            return;
+        }
+    }
+
+    /* A Unix socket names one server: no pool then */
+    if (req->pool && *req->pool && !(req->unix_socket && *req->unix_socket))
+        pool_pick(req, x);
+
+    CURL *curl = netpool_acquire(req_server(req));
+    if (!curl)
+    {
+        add_row_note(req, g_strdup("[Erreur] curl init"));
+        endpoints_release(req->endpoint);
+        xfer_free(x);
+        g_idle_add(finish_idle_cb, req);
+        return;
+    }
+
+    /* A hedged reply may come from another backend: not one to share */
+    if (req->cache_key && !req->hedge)
+    {
+        if (!inflight)
+            inflight = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+        g_hash_table_replace(inflight, g_strdup(req->cache_key), req);
+        req->shared = TRUE;
+    }
+
+    touch_backend(req->base);
+    req->parser = response_parser_new(req);
+    if (prefs.capture_enabled)
+        req->capture = capture_open(req->mode, req->streaming, req->model);
+
+    req->retry_after = -1;
+    req->t_start = g_get_monotonic_time();
+
+    xfer_setup(x, curl);
+    netloop_add_delayed(curl, 0, &req->cancel, xfer_done, x);
+}
+
+void network_prepare_request(Req *req)
+{
+    g_free(req->prompt_json);
+    req->prompt_json = json_escape(req->prompt);
+    /* A pooled request's member is only known once it is picked */
+    if (prefs.prewarm && !(req->pool && *req->pool))
+        network_prewarm(req->base, req->unix_socket);
+}
+
+void network_request_free(Req *req)
+{
+    req_free(req);
+}
+
+/*
+ * At unload, once network_cleanup raised replay_stopping: join the replay
+ * threads and free what they were feeding
+ */
+static void replays_stop(void)
+{
+    for (guint i = 0; replays && i < replays->len; i++)
+    {
+        Replay *rp = g_ptr_array_index(replays, i);
+        g_thread_join(rp->thread);
+        g_idle_remove_by_data(rp);
+        while (g_idle_remove_by_data(rp->req))
+            ;   /* Row restarts */
+        req_free(rp->req);
+        replay_free(rp);
+    }
+    g_clear_pointer(&replays, g_ptr_array_unref);
+    g_atomic_int_set(&replay_stopping, 0);
+}
+
+void network_cancel_request(Req *req)
+{
+    if (req->shared && !g_atomic_int_get(&req->row_gone) && leader_detach(req))
+        return;
+
+    /* Before the flag, which publishes it to the I/O thread */
+    if (!req->t_cancel)
+        req->t_cancel = g_get_monotonic_time();
+    g_atomic_int_set(&req->cancel, 1);
+
+    Hedge *h = req->hedge;
+    if (h)
+    {
+        if (h->timer)
+        {
+            g_source_remove(h->timer);
+            h->timer = 0;
+        }
+        if (!h->secondary->t_cancel)
+            h->secondary->t_cancel = req->t_cancel;
+        g_atomic_int_set(&h->secondary->cancel, 1);
+    }
+    netloop_interrupt();
+
+    Req *leader = req->leader;
+    if (!leader)
+        return;
+
+    /* The leader goes on for the other rows; this one keeps what it has */
+    g_mutex_lock(&follow_lock);
+    if (leader->followers)
+        g_ptr_array_remove(leader->followers, req);
+    req->leader = NULL;
+    gboolean unread = g_atomic_int_get(&leader->row_gone) &&
+                      (!leader->followers || leader->followers->len == 0);
+    g_mutex_unlock(&follow_lock);
+
+    /* Last reader of a stopped leader gone: now stop the transfer */
+    if (unread)
+    {
+        leader->t_cancel = req->t_cancel;
+        g_atomic_int_set(&leader->cancel, 1);
+        netloop_interrupt();
+    }
+
+    add_row_note(req, g_strdup("[Annulé]"));
+    g_idle_add(finish_idle_cb, req);
 }
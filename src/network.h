@@ -8,49 +8,157 @@
 #include <glib.h>
 #include <gtk/gtk.h>
 #include "prefs.h"
+#include "history.h"
+#include "json_stream.h"
+#include "framing.h"
+#include "byte_ring.h"
+#include "reply.h"
+#include "stats.h"
+#include "capture.h"
+
+/* Race against a secondary backend (network.c) */
+typedef struct Hedge Hedge;
 
 /* Request structure for async HTTP operations */
 typedef struct Req
 {
     gchar    *prompt;
+    gchar    *prompt_json;    /* prompt JSON-escaped ahead of time, or NULL */
     ApiMode   mode;
     gchar    *base;
     gchar    *model;
     gdouble   temp;
     gchar    *api_key;
+    gchar    *unix_socket;    /* Connect through this socket, NULL/"" = TCP */
+    gchar    *pool;           /* More base URLs to balance over, NULL/"" = none */
+    gchar    *endpoint;       /* Pool member serving it, NULL when not pooled */
     gboolean  streaming;
+    gboolean  gzip_request;   /* Send the body with Content-Encoding: gzip */
+    gint      retry_max;      /* Retries on transient failures */
+    gint      stall_secs;     /* Abort a stream silent this long (0 = off) */
+    gchar    *hedge_to;       /* Preset raced if the first token is late, NULL = off */
+    gint      hedge_ms;       /* How late; 0 = learned from recent first tokens */
+    Hedge    *hedge;          /* Race in progress, NULL otherwise */
+
+    ChatHistory *history;   /* Conversation the request belongs to */
+    gboolean     own_history;   /* history is a private copy, freed with it */
+    gpointer     session;   /* Owning chat session (opaque, for the UI) */
+    gpointer     column;    /* Comparison column it answers in, or NULL */
+    gboolean     replay;    /* Fed from a capture, kept out of the history */
 
     volatile gint cancel;
+    gint64        t_cancel;   /* Monotonic time of the Stop, 0 if none */
+
+    Framer    framer;   /* JSON-lines (Ollama) / SSE (OpenAI) framing */
+
+    JsonStream *parser;       /* Response tokenizer (I/O thread) */
+    ReplyState  reply;        /* done, finish_reason, token count, error */
+
+    long      http_status;    /* Status of the current response (I/O thread) */
+    gint64    retry_after;    /* Retry-After in µs, -1 if absent */
+    gint      attempt;        /* Retries done so far */
+    gint      restarting;     /* Atomic: row being cleared, hold the text */
+    gchar    *row_note;       /* Shown under the row once finished */
+    gboolean  complete;       /* Reply ended normally (I/O thread) */
+    Capture  *capture;        /* Raw response recording, NULL if off */
+
+    gchar      *cache_key;    /* Response cache key, NULL if not cached */
+    gboolean    shared;       /* Other requests may attach to this one */
+    GPtrArray  *followers;    /* Identical requests fed by this one */
+    struct Req *leader;       /* Request whose stream this one mirrors */
+    gint        row_gone;     /* Atomic: stopped, but still feeding followers */
 
-    GString  *carry;    /* JSON-lines buffer (Ollama) */
-    GString  *carry2;   /* SSE buffer (OpenAI) */
+    gint64    t_start;        /* Monotonic time the current attempt was sent */
+    gint64    t_first;        /* First content chunk, 0 until then */
+    gint64    t_last;         /* Latest content chunk */
+    gint64    chunks;         /* Documents that carried content */
+    GArray   *gaps;           /* µs between content chunks (guint32) */
+    ReqTiming timing;         /* Filled in when the transfer succeeds */
+    gboolean  has_timing;
 
     GtkWidget     *row;
     GtkWidget     *stream_view;
     GtkTextBuffer *stream_buf;
+    ByteRing      *stream_ring;   /* I/O thread -> stream view */
 
     GString *accum;     /* Accumulated response text */
+    gsize    pushed;    /* Bytes of accum already handed to the UI */
 } Req;
 
-/* Current request (for cancel support) */
-extern Req *current_req;
-
 /* Initialize curl globally */
 void network_init(void);
 
 /* Cleanup curl globally */
 void network_cleanup(void);
 
-/* Start async HTTP request in a new thread */
+/*
+ * Start async HTTP request on the I/O thread (several may run at once).
+ * With the response cache on, a cached reply is replayed instead and a
+ * request identical to one in flight shares its stream. With a pool, it
+ * goes to the least loaded member (see endpoints.h). With hedge_to
+ * set, the same prompt goes to that backend preset too if no token came
+ * after the hedging delay; the first of the two to produce content feeds
+ * the row, the other is cancelled.
+ */
 void network_send_request(Req *req);
 
-/* Callbacks to be set by UI module */
-typedef void (*StreamAppendFunc)(Req *req, const char *text, gssize len);
-typedef void (*ReplaceRowFunc)(GtkWidget *row, const gchar *final_text);
-typedef void (*SetBusyFunc)(gboolean busy);
+/*
+ * Get @req ready ahead of sending it, while another answer streams: its
+ * prompt is escaped and, with pre-warming on, its backend's connection
+ * opened (not for a pool, whose member is picked at sending). Call again
+ * if the prompt changes. Main thread.
+ */
+void network_prepare_request(Req *req);
+
+/* Free a request that was never sent (the network module frees the others) */
+void network_request_free(Req *req);
+
+/*
+ * Stop @req: the I/O thread is woken to tear its transfer down at once
+ * (the time this takes goes to the stop latency stats), or, when it
+ * shares another request's stream, it is detached and finished right
+ * away, from an idle callback. Main thread.
+ */
+void network_cancel_request(Req *req);
+
+/*
+ * Feed the responses recorded in @cap back through the parser and the
+ * stream view of @req, at @speed times their original pace (0: as fast
+ * as possible), on a thread of their own. @req needs its mode, streaming
+ * flag, model, history and row like a real request; takes @cap. Cancel
+ * with network_cancel_request. Main thread.
+ */
+void network_replay(Req *req, CaptureFile *cap, gdouble speed);
+
+/*
+ * Open a connection to @base_url in the background (DNS, TCP, TLS) so the
+ * next request finds it in the connection cache; through @unix_socket
+ * when it is set. Does nothing if the backend was used or warmed
+ * recently. Main thread.
+ */
+void network_prewarm(const gchar *base_url, const gchar *unix_socket);
+
+/*
+ * Callbacks to be set by UI module. StreamAppendFunc may be called from
+ * the I/O thread and returns how many bytes were taken (the rest can be
+ * offered again later); ReplaceRowFunc and SetBusyFunc run on the main
+ * thread, the timing passed to ReplaceRowFunc (or NULL) is only borrowed.
+ * RowStatusFunc shows a status line under a row (retries, cache); it may
+ * be called from any thread and is applied after a pending row replace.
+ * RestartRowFunc empties the stream view of a request whose answer starts
+ * over (main thread; nothing more is pushed to it until it returns).
+ */
+typedef gsize (*StreamAppendFunc)(Req *req, const char *text, gssize len);
+typedef void (*ReplaceRowFunc)(GtkWidget *row, const gchar *final_text,
+                               const ReqTiming *timing);
+typedef void (*SetBusyFunc)(Req *req, gboolean busy);
+typedef void (*RowStatusFunc)(GtkWidget *row, const gchar *status);
+typedef void (*RestartRowFunc)(Req *req);
 
 void network_set_callbacks(StreamAppendFunc stream_append,
                            ReplaceRowFunc replace_row,
-                           SetBusyFunc set_busy);
+                           SetBusyFunc set_busy,
+                           RowStatusFunc row_status,
+                           RestartRowFunc restart_row);
 
 #endif /* NETWORK_H */
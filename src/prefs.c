@@ -47,6 +47,9 @@ static void backend_free(BackendPreset *b)
     g_free(b->base_url);
     g_free(b->model);
     g_free(b->api_key);
+    g_free(b->unix_socket);
+    g_free(b->url_pool);
+    g_free(b->hedge_backend);
     g_free(b);
 }
 
@@ -75,6 +78,14 @@ static BackendPreset* find_backend_by_name(const gchar *name)
     return NULL;
 }
 
+/* Integer key, or @def when absent (older config files) */
+static gint get_int_or(GKeyFile *kf, const gchar *group, const gchar *key, gint def)
+{
+    if (!g_key_file_has_key(kf, group, key, NULL))
+        return def;
+    return g_key_file_get_integer(kf, group, key, NULL);
+}
+
 /* --- Defaults --- */
 
 void prefs_set_defaults(void)
@@ -94,6 +105,17 @@ void prefs_set_defaults(void)
     prefs.current_backend_name = NULL;
     prefs.backend_presets = NULL;
     prefs.links_enabled = TRUE;  /* Links clickable by default */
+    prefs.gzip_request = FALSE;  /* Not every backend accepts it */
+    prefs.prewarm = TRUE;
+    prefs.retry_max = 2;
+    prefs.stall_secs = 60;   /* Model loading can keep a stream silent */
+    prefs.unix_socket = g_strdup("");
+    prefs.url_pool = g_strdup("");
+    prefs.hedge_backend = g_strdup("");
+    prefs.hedge_ms = 0;
+    prefs.cache_enabled = FALSE;
+    prefs.cache_max_mb = 64;
+    prefs.capture_enabled = FALSE;
 
     /* Add default presets */
     prefs_set_preset("Assistant général",
@@ -117,6 +139,9 @@ void prefs_free(void)
     g_clear_pointer(&prefs.system_prompt, g_free);
     g_clear_pointer(&prefs.current_preset_name, g_free);
     g_clear_pointer(&prefs.proxy, g_free);
+    g_clear_pointer(&prefs.unix_socket, g_free);
+    g_clear_pointer(&prefs.url_pool, g_free);
+    g_clear_pointer(&prefs.hedge_backend, g_free);
     g_clear_pointer(&prefs.current_backend_name, g_free);
     g_clear_pointer(&conf_path, g_free);
 
@@ -194,6 +219,30 @@ void prefs_load(void)
     else
         prefs.links_enabled = TRUE;
 
+    prefs.gzip_request = g_key_file_get_boolean(kf, "chat", "gzip_request", NULL);
+
+    if (g_key_file_has_key(kf, "chat", "prewarm", NULL))
+        prefs.prewarm = g_key_file_get_boolean(kf, "chat", "prewarm", NULL);
+    else
+        prefs.prewarm = TRUE;
+
+    prefs.retry_max = CLAMP(get_int_or(kf, "chat", "retry_max", 2), 0, 10);
+    prefs.stall_secs = MAX(get_int_or(kf, "chat", "stall_secs", 60), 0);
+    g_free(prefs.unix_socket);
+    prefs.unix_socket = g_key_file_get_string(kf, "chat", "unix_socket", NULL);
+    if (!prefs.unix_socket) prefs.unix_socket = g_strdup("");
+    g_free(prefs.url_pool);
+    prefs.url_pool = g_key_file_get_string(kf, "chat", "url_pool", NULL);
+    if (!prefs.url_pool) prefs.url_pool = g_strdup("");
+    g_free(prefs.hedge_backend);
+    prefs.hedge_backend = g_key_file_get_string(kf, "chat", "hedge_backend", NULL);
+    if (!prefs.hedge_backend) prefs.hedge_backend = g_strdup("");
+    prefs.hedge_ms = MAX(get_int_or(kf, "chat", "hedge_ms", 0), 0);
+
+    prefs.cache_enabled = g_key_file_get_boolean(kf, "chat", "cache_enabled", NULL);
+    prefs.cache_max_mb = CLAMP(get_int_or(kf, "chat", "cache_max_mb", 64), 1, 4096);
+    prefs.capture_enabled = g_key_file_get_boolean(kf, "chat", "capture_enabled", NULL);
+
     /* Load presets */
     g_list_free_full(prefs.prompt_presets, (GDestroyNotify)preset_free);
     prefs.prompt_presets = NULL;
@@ -256,6 +305,13 @@ void prefs_load(void)
             gchar *key_model = g_strdup_printf("backend_%d_model", i);
             gchar *key_temp = g_strdup_printf("backend_%d_temp", i);
             gchar *key_key = g_strdup_printf("backend_%d_key", i);
+            gchar *key_gzip = g_strdup_printf("backend_%d_gzip", i);
+            gchar *key_retries = g_strdup_printf("backend_%d_retries", i);
+            gchar *key_stall = g_strdup_printf("backend_%d_stall", i);
+            gchar *key_unix = g_strdup_printf("backend_%d_unix_socket", i);
+            gchar *key_pool = g_strdup_printf("backend_%d_url_pool", i);
+            gchar *key_hedge = g_strdup_printf("backend_%d_hedge", i);
+            gchar *key_hedge_ms = g_strdup_printf("backend_%d_hedge_ms", i);
 
             gchar *name = g_key_file_get_string(kf, "backends", key_name, NULL);
             if (name)
@@ -271,6 +327,16 @@ void prefs_load(void)
                                                model ? model : "",
                                                temp,
                                                api_key ? api_key : "");
+                b->gzip_request = g_key_file_get_boolean(kf, "backends", key_gzip, NULL);
+                b->retry_max = CLAMP(get_int_or(kf, "backends", key_retries, 2), 0, 10);
+                b->stall_secs = MAX(get_int_or(kf, "backends", key_stall, 60), 0);
+                b->unix_socket = g_key_file_get_string(kf, "backends", key_unix, NULL);
+                if (!b->unix_socket) b->unix_socket = g_strdup("");
+                b->url_pool = g_key_file_get_string(kf, "backends", key_pool, NULL);
+                if (!b->url_pool) b->url_pool = g_strdup("");
+                b->hedge_backend = g_key_file_get_string(kf, "backends", key_hedge, NULL);
+                if (!b->hedge_backend) b->hedge_backend = g_strdup("");
+                b->hedge_ms = MAX(get_int_or(kf, "backends", key_hedge_ms, 0), 0);
                 prefs.backend_presets = g_list_append(prefs.backend_presets, b);
 
                 g_free(url);
@@ -285,6 +351,13 @@ void prefs_load(void)
             g_free(key_model);
             g_free(key_temp);
             g_free(key_key);
+            g_free(key_gzip);
+            g_free(key_retries);
+            g_free(key_stall);
+            g_free(key_unix);
+            g_free(key_pool);
+            g_free(key_hedge);
+            g_free(key_hedge_ms);
         }
     }
 
@@ -312,6 +385,17 @@ void prefs_save(void)
     g_key_file_set_integer(kf, "chat", "timeout", prefs.timeout);
     g_key_file_set_string(kf,  "chat", "proxy", prefs.proxy ? prefs.proxy : "");
     g_key_file_set_boolean(kf, "chat", "links_enabled", prefs.links_enabled);
+    g_key_file_set_boolean(kf, "chat", "gzip_request", prefs.gzip_request);
+    g_key_file_set_boolean(kf, "chat", "prewarm", prefs.prewarm);
+    g_key_file_set_integer(kf, "chat", "retry_max", prefs.retry_max);
+    g_key_file_set_integer(kf, "chat", "stall_secs", prefs.stall_secs);
+    g_key_file_set_string(kf,  "chat", "unix_socket", prefs.unix_socket ? prefs.unix_socket : "");
+    g_key_file_set_string(kf,  "chat", "url_pool", prefs.url_pool ? prefs.url_pool : "");
+    g_key_file_set_string(kf,  "chat", "hedge_backend", prefs.hedge_backend ? prefs.hedge_backend : "");
+    g_key_file_set_integer(kf, "chat", "hedge_ms", prefs.hedge_ms);
+    g_key_file_set_boolean(kf, "chat", "cache_enabled", prefs.cache_enabled);
+    g_key_file_set_integer(kf, "chat", "cache_max_mb", prefs.cache_max_mb);
+    g_key_file_set_boolean(kf, "chat", "capture_enabled", prefs.capture_enabled);
 
     /* Save presets */
     gint count = (gint)g_list_length(prefs.prompt_presets);
@@ -348,6 +432,13 @@ void prefs_save(void)
         gchar *key_model = g_strdup_printf("backend_%d_model", bi);
         gchar *key_temp = g_strdup_printf("backend_%d_temp", bi);
         gchar *key_key = g_strdup_printf("backend_%d_key", bi);
+        gchar *key_gzip = g_strdup_printf("backend_%d_gzip", bi);
+        gchar *key_retries = g_strdup_printf("backend_%d_retries", bi);
+        gchar *key_stall = g_strdup_printf("backend_%d_stall", bi);
+        gchar *key_unix = g_strdup_printf("backend_%d_unix_socket", bi);
+        gchar *key_pool = g_strdup_printf("backend_%d_url_pool", bi);
+        gchar *key_hedge = g_strdup_printf("backend_%d_hedge", bi);
+        gchar *key_hedge_ms = g_strdup_printf("backend_%d_hedge_ms", bi);
 
         g_key_file_set_string(kf, "backends", key_name, b->name);
         g_key_file_set_integer(kf, "backends", key_mode, b->api_mode);
@@ -355,6 +446,13 @@ void prefs_save(void)
         g_key_file_set_string(kf, "backends", key_model, b->model);
         g_key_file_set_double(kf, "backends", key_temp, b->temperature);
         g_key_file_set_string(kf, "backends", key_key, b->api_key ? b->api_key : "");
+        g_key_file_set_boolean(kf, "backends", key_gzip, b->gzip_request);
+        g_key_file_set_integer(kf, "backends", key_retries, b->retry_max);
+        g_key_file_set_integer(kf, "backends", key_stall, b->stall_secs);
+        g_key_file_set_string(kf, "backends", key_unix, b->unix_socket ? b->unix_socket : "");
+        g_key_file_set_string(kf, "backends", key_pool, b->url_pool ? b->url_pool : "");
+        g_key_file_set_string(kf, "backends", key_hedge, b->hedge_backend ? b->hedge_backend : "");
+        g_key_file_set_integer(kf, "backends", key_hedge_ms, b->hedge_ms);
 
         g_free(key_name);
         g_free(key_mode);
@@ -362,6 +460,13 @@ void prefs_save(void)
         g_free(key_model);
         g_free(key_temp);
         g_free(key_key);
+        g_free(key_gzip);
+        g_free(key_retries);
+        g_free(key_stall);
+        g_free(key_unix);
+        g_free(key_pool);
+        g_free(key_hedge);
+        g_free(key_hedge_ms);
     }
 
     txt = g_key_file_to_data(kf, &len, NULL);
@@ -502,6 +607,16 @@ void prefs_save_backend(const gchar *name)
         existing->temperature = prefs.temperature;
         g_free(existing->api_key);
         existing->api_key = g_strdup(prefs.api_key);
+        existing->gzip_request = prefs.gzip_request;
+        existing->retry_max = prefs.retry_max;
+        existing->stall_secs = prefs.stall_secs;
+        g_free(existing->unix_socket);
+        existing->unix_socket = g_strdup(prefs.unix_socket);
+        g_free(existing->url_pool);
+        existing->url_pool = g_strdup(prefs.url_pool);
+        g_free(existing->hedge_backend);
+        existing->hedge_backend = g_strdup(prefs.hedge_backend);
+        existing->hedge_ms = prefs.hedge_ms;
     }
     else
     {
@@ -509,6 +624,13 @@ void prefs_save_backend(const gchar *name)
         BackendPreset *b = backend_new(name, prefs.api_mode,
                                        prefs.base_url, prefs.model,
                                        prefs.temperature, prefs.api_key);
+        b->gzip_request = prefs.gzip_request;
+        b->retry_max = prefs.retry_max;
+        b->stall_secs = prefs.stall_secs;
+        b->unix_socket = g_strdup(prefs.unix_socket);
+        b->url_pool = g_strdup(prefs.url_pool);
+        b->hedge_backend = g_strdup(prefs.hedge_backend);
+        b->hedge_ms = prefs.hedge_ms;
         prefs.backend_presets = g_list_append(prefs.backend_presets, b);
     }
 
@@ -551,6 +673,22 @@ gboolean prefs_rename_backend(const gchar *old_name, const gchar *new_name)
     g_free(b->name);
     b->name = g_strdup(new_name);
 
+    /* Hedging targets follow the rename */
+    for (GList *l = prefs.backend_presets; l; l = l->next)
+    {
+        BackendPreset *o = (BackendPreset *)l->data;
+        if (g_strcmp0(o->hedge_backend, old_name) == 0)
+        {
+            g_free(o->hedge_backend);
+            o->hedge_backend = g_strdup(new_name);
+        }
+    }
+    if (g_strcmp0(prefs.hedge_backend, old_name) == 0)
+    {
+        g_free(prefs.hedge_backend);
+        prefs.hedge_backend = g_strdup(new_name);
+    }
+
     /* Update current backend name if needed */
     if (g_strcmp0(prefs.current_backend_name, old_name) == 0)
     {
@@ -574,6 +712,16 @@ void prefs_apply_backend(const gchar *name)
         prefs.temperature = b->temperature;
         g_free(prefs.api_key);
         prefs.api_key = g_strdup(b->api_key);
+        prefs.gzip_request = b->gzip_request;
+        prefs.retry_max = b->retry_max;
+        prefs.stall_secs = b->stall_secs;
+        g_free(prefs.unix_socket);
+        prefs.unix_socket = g_strdup(b->unix_socket ? b->unix_socket : "");
+        g_free(prefs.url_pool);
+        prefs.url_pool = g_strdup(b->url_pool ? b->url_pool : "");
+        g_free(prefs.hedge_backend);
+        prefs.hedge_backend = g_strdup(b->hedge_backend ? b->hedge_backend : "");
+        prefs.hedge_ms = b->hedge_ms;
         g_free(prefs.current_backend_name);
         prefs.current_backend_name = g_strdup(name);
     }
@@ -25,6 +25,13 @@ typedef struct
     gchar   *model;
     gdouble  temperature;
     gchar   *api_key;
+    gboolean gzip_request;   /* Backend accepts Content-Encoding: gzip */
+    gint     retry_max;      /* Retries on transient failures (0 = none) */
+    gint     stall_secs;     /* Stream stall timeout in seconds (0 = off) */
+    gchar   *unix_socket;    /* Connect through this socket file ("" = TCP) */
+    gchar   *url_pool;       /* More base URLs serving the same models ("" = none) */
+    gchar   *hedge_backend;  /* Preset raced when the first token is late ("" = none) */
+    gint     hedge_ms;       /* How late, 0 = learned from recent first tokens */
 } BackendPreset;
 
 typedef struct
@@ -44,6 +51,17 @@ typedef struct
     gchar   *current_backend_name; /* Name of current backend preset (or NULL) */
     GList   *backend_presets;      /* List of BackendPreset* */
     gboolean links_enabled;        /* Enable clickable links in messages */
+    gboolean gzip_request;         /* Compress request bodies (per backend) */
+    gboolean prewarm;              /* Open the connection while typing */
+    gint     retry_max;            /* Retries on transient failures (per backend) */
+    gint     stall_secs;           /* Stream stall timeout, 0 = off (per backend) */
+    gchar   *unix_socket;          /* Unix socket path, "" = TCP (per backend) */
+    gchar   *url_pool;             /* Other base URLs to balance over (per backend) */
+    gchar   *hedge_backend;        /* Secondary preset for late first tokens (per backend) */
+    gint     hedge_ms;             /* Hedging threshold, 0 = learned (per backend) */
+    gboolean cache_enabled;        /* Replay identical requests from disk */
+    gint     cache_max_mb;         /* Response cache size cap */
+    gboolean capture_enabled;      /* Record raw responses for replay */
 } AiPrefs;
 
 /* Global preferences instance */
@@ -98,7 +116,8 @@ void prefs_delete_backend(const gchar *name);
 /* Rename a backend preset */
 gboolean prefs_rename_backend(const gchar *old_name, const gchar *new_name);
 
-/* Apply a backend preset (sets api_mode, base_url, model, temperature, api_key) */
+/* Apply a backend preset (sets api_mode, base_url, model, temperature, api_key,
+ * gzip_request, retry_max, stall_secs, unix_socket, url_pool, hedging) */
 void prefs_apply_backend(const gchar *name);
 
 #endif /* PREFS_H */
@@ -0,0 +1,67 @@
+/*
+ * reply.c — Fields of a chat reply for AI Chat plugin
+ *
+ * The one place that knows where Ollama and OpenAI-compatible servers
+ * put the text and the end-of-reply markers, for network.c and for the
+ * parser benchmark.
+ */
+
+#include "reply.h"
+
+void reply_watch(JsonStream *js, gboolean ollama)
+{
+    if (ollama)
+    {
+        json_stream_watch(js, "message.content", REPLY_CONTENT, TRUE);
+        json_stream_watch(js, "done", REPLY_DONE, FALSE);
+        json_stream_watch(js, "eval_count", REPLY_EVAL_COUNT, FALSE);
+        json_stream_watch(js, "error", REPLY_ERROR, FALSE);
+    }
+    else
+    {
+        json_stream_watch(js, "choices[].delta.content", REPLY_CONTENT, TRUE);
+        json_stream_watch(js, "choices[].message.content", REPLY_CONTENT, TRUE);
+        json_stream_watch(js, "choices[].finish_reason", REPLY_FINISH_REASON, FALSE);
+        json_stream_watch(js, "usage.completion_tokens", REPLY_EVAL_COUNT, FALSE);
+        json_stream_watch(js, "error.message", REPLY_ERROR, FALSE);
+    }
+}
+
+void reply_value(ReplyState *st, gint field, JsonValueType type,
+                 const gchar *text, gsize len)
+{
+    switch (field)
+    {
+        case REPLY_DONE:
+            st->done = (type == JSON_VALUE_TRUE);
+            break;
+        case REPLY_EVAL_COUNT:
+            if (type == JSON_VALUE_NUMBER)
+                st->eval_count = g_ascii_strtoll(text, NULL, 10);
+            break;
+        case REPLY_FINISH_REASON:
+            if (type == JSON_VALUE_STRING)
+            {
+                g_free(st->finish_reason);
+                st->finish_reason = g_strndup(text, len);
+            }
+            break;
+        case REPLY_ERROR:
+            st->failed = TRUE;
+            break;
+    }
+}
+
+gboolean reply_finished(const ReplyState *st)
+{
+    return st->done || st->finish_reason;
+}
+
+void reply_clear(ReplyState *st)
+{
+    g_free(st->finish_reason);
+    st->finish_reason = NULL;
+    st->done = FALSE;
+    st->eval_count = 0;
+    st->failed = FALSE;
+}
@@ -0,0 +1,42 @@
+/*
+ * reply.h — Fields of a chat reply for AI Chat plugin
+ */
+
+#ifndef REPLY_H
+#define REPLY_H
+
+#include "json_stream.h"
+
+/* Fields watched in each reply document (json_stream field ids) */
+enum
+{
+    REPLY_CONTENT,
+    REPLY_DONE,
+    REPLY_EVAL_COUNT,
+    REPLY_FINISH_REASON,
+    REPLY_ERROR
+};
+
+/* What the non-content fields said so far. Zero-initialise it. */
+typedef struct
+{
+    gboolean done;            /* Ollama "done" (or an SSE [DONE]) seen */
+    gint64   eval_count;      /* Generated tokens, when reported */
+    gchar   *finish_reason;   /* OpenAI */
+    gboolean failed;          /* Backend reported an error */
+} ReplyState;
+
+/* Watch on @js the fields of an Ollama (@ollama) or OpenAI-compatible reply */
+void reply_watch(JsonStream *js, gboolean ollama);
+
+/* Record a value reported for a non-content field */
+void reply_value(ReplyState *st, gint field, JsonValueType type,
+                 const gchar *text, gsize len);
+
+/* The reply said it was over: "done" or a finish_reason */
+gboolean reply_finished(const ReplyState *st);
+
+/* Back to a zeroed state (a retry starts a new reply) */
+void reply_clear(ReplyState *st);
+
+#endif /* REPLY_H */
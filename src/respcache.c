@@ -0,0 +1,217 @@
+/*
+ * respcache.c — On-disk cache of complete responses
+ *
+ * The directory is the cache: a file named after its key holds the reply
+ * text, and its modification time is the last use. The index in memory is
+ * rebuilt from a directory scan on first use, so entries survive restarts
+ * and a crash loses nothing but the LRU order of the last session.
+ */
+
+#include "respcache.h"
+#include <glib/gstdio.h>
+#include <string.h>
+
+#define KEY_LEN 64   /* Hex SHA-256 */
+
+typedef struct
+{
+    gchar *key;
+    gint64 size;
+    gint64 used;   /* µs since the epoch */
+} Entry;
+
+static GHashTable *index_tbl = NULL;   /* key -> Entry* */
+static gint64      total = 0;          /* Bytes in index_tbl */
+
+static void entry_free(gpointer p)
+{
+    Entry *e = (Entry *)p;
+    g_free(e->key);
+    g_free(e);
+}
+
+static gchar* cache_dir(void)
+{
+    return g_build_filename(g_get_user_config_dir(), "geany",
+                            "ai_chat_cache", NULL);
+}
+
+static gchar* entry_path(const gchar *key)
+{
+    gchar *dir = cache_dir();
+    gchar *path = g_build_filename(dir, key, NULL);
+    g_free(dir);
+    return path;
+}
+
+static gboolean is_key(const gchar *name)
+{
+    if (strlen(name) != KEY_LEN)
+        return FALSE;
+    for (const gchar *p = name; *p; p++)
+        if (!g_ascii_isxdigit(*p))
+            return FALSE;
+    return TRUE;
+}
+
+static void index_add(const gchar *key, gint64 size, gint64 used)
+{
+    Entry *e = g_hash_table_lookup(index_tbl, key);
+    if (e)
+        total -= e->size;
+    else
+    {
+        e = g_new0(Entry, 1);
+        e->key = g_strdup(key);
+        g_hash_table_insert(index_tbl, e->key, e);
+    }
+    e->size = size;
+    e->used = used;
+    total += size;
+}
+
+static void index_load(void)
+{
+    if (index_tbl)
+        return;
+    index_tbl = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, entry_free);
+    total = 0;
+
+    gchar *dir = cache_dir();
+    GDir *d = g_dir_open(dir, 0, NULL);
+    if (d)
+    {
+        const gchar *name;
+        while ((name = g_dir_read_name(d)) != NULL)
+        {
+            GStatBuf st;
+            if (!is_key(name))
+                continue;
+            gchar *path = g_build_filename(dir, name, NULL);
+            if (g_stat(path, &st) == 0)
+                index_add(name, (gint64)st.st_size,
+                          (gint64)st.st_mtime * G_USEC_PER_SEC);
+            g_free(path);
+        }
+        g_dir_close(d);
+    }
+    g_free(dir);
+}
+
+static void index_remove(Entry *e)
+{
+    gchar *path = entry_path(e->key);
+    g_unlink(path);
+    g_free(path);
+    total -= e->size;
+    g_hash_table_remove(index_tbl, e->key);
+}
+
+static gint by_use(gconstpointer a, gconstpointer b)
+{
+    const Entry *ea = *(const Entry * const *)a;
+    const Entry *eb = *(const Entry * const *)b;
+    return (ea->used > eb->used) - (ea->used < eb->used);
+}
+
+/* Drop least recently used entries until @max_bytes fit */
+static void evict(gint64 max_bytes)
+{
+    if (total <= max_bytes)
+        return;
+
+    GPtrArray *all = g_ptr_array_sized_new(g_hash_table_size(index_tbl));
+    GHashTableIter it;
+    gpointer v;
+    g_hash_table_iter_init(&it, index_tbl);
+    while (g_hash_table_iter_next(&it, NULL, &v))
+        g_ptr_array_add(all, v);
+    g_ptr_array_sort(all, by_use);
+
+    for (guint i = 0; i < all->len && total > max_bytes; i++)
+        index_remove(g_ptr_array_index(all, i));
+    g_ptr_array_free(all, TRUE);
+}
+
+/* --- Public API ---------------------------------------------------------- */
+
+gchar* respcache_key(const gchar *url, const gchar *prefix, gsize prefix_len,
+                     gdouble temperature)
+{
+    GChecksum *ck = g_checksum_new(G_CHECKSUM_SHA256);
+    gchar temp[G_ASCII_DTOSTR_BUF_SIZE];
+
+    /* NULs separate the fields: none of them can contain one */
+    g_checksum_update(ck, (const guchar *)url, (gssize)strlen(url) + 1);
+    g_checksum_update(ck, (const guchar *)prefix, (gssize)prefix_len);
+    g_checksum_update(ck, (const guchar *)"", 1);
+    g_ascii_formatd(temp, sizeof temp, "%.3f", temperature);
+    g_checksum_update(ck, (const guchar *)temp, -1);
+
+    gchar *key = g_strdup(g_checksum_get_string(ck));
+    g_checksum_free(ck);
+    return key;
+}
+
+gchar* respcache_lookup(const gchar *key)
+{
+    index_load();
+    Entry *e = g_hash_table_lookup(index_tbl, key);
+    if (!e)
+        return NULL;
+
+    gchar *path = entry_path(key);
+    gchar *text = NULL;
+    if (g_file_get_contents(path, &text, NULL, NULL))
+    {
+        /* The file's mtime carries the LRU order across sessions */
+        e->used = g_get_real_time();
+        g_utime(path, NULL);
+    }
+    else
+        index_remove(e);   /* Deleted behind our back */
+    g_free(path);
+    return text;
+}
+
+void respcache_store(const gchar *key, const gchar *text, gint64 max_bytes)
+{
+    gsize len = text ? strlen(text) : 0;
+
+    /* A reply larger than the whole cache would only evict everything */
+    if (len == 0 || (gint64)len > max_bytes)
+        return;
+    index_load();
+
+    gchar *dir = cache_dir();
+    g_mkdir_with_parents(dir, 0700);
+    g_free(dir);
+
+    gchar *path = entry_path(key);
+    if (g_file_set_contents(path, text, (gssize)len, NULL))
+    {
+        index_add(key, (gint64)len, g_get_real_time());
+        evict(max_bytes);
+    }
+    g_free(path);
+}
+
+gint64 respcache_usage(guint *entries)
+{
+    index_load();
+    if (entries)
+        *entries = g_hash_table_size(index_tbl);
+    return total;
+}
+
+void respcache_clear(void)
+{
+    index_load();
+    evict(-1);
+}
+
+void respcache_cleanup(void)
+{
+    g_clear_pointer(&index_tbl, g_hash_table_destroy);
+    total = 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * respcache.h — On-disk cache of complete responses
+ */
+
+#ifndef RESPCACHE_H
+#define RESPCACHE_H
+
+#include <glib.h>
+
+/*
+ * Entries live in ~/.config/geany/ai_chat_cache/, one file per key, and
+ * are evicted least recently used first. All functions run on the main
+ * thread.
+ */
+
+/*
+ * Key for a request: hex SHA-256 of @url, the @prefix_len first bytes
+ * of the payload (model and message list) and the temperature.
+ */
+gchar* respcache_key(const gchar *url, const gchar *prefix, gsize prefix_len,
+                     gdouble temperature);
+
+/* Cached response text for @key, or NULL (caller frees) */
+gchar* respcache_lookup(const gchar *key);
+
+/* Store @text under @key, then evict down to @max_bytes */
+void respcache_store(const gchar *key, const gchar *text, gint64 max_bytes);
+
+/* Bytes used and number of entries */
+gint64 respcache_usage(guint *entries);
+
+/* Delete every entry */
+void respcache_clear(void);
+
+/* Free the in-memory index */
+void respcache_cleanup(void);
+
+#endif /* RESPCACHE_H */
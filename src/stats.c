@@ -0,0 +1,494 @@
+/*
+ * stats.c — Transfer statistics for AI Chat plugin
+ *
+ * Counters are bumped from the I/O thread and read by the dialogs, so
+ * they sit behind one small lock.
+ */
+
+#include "stats.h"
+#include <curl/curl.h>
+
+typedef struct
+{
+    long  http_version;   /* Last negotiated, CURL_HTTP_VERSION_* */
+    guint transfers;
+    guint connects;       /* New connections opened */
+} BackendNet;
+
+typedef struct
+{
+    guint  count;
+    gint64 total;   /* µs */
+    gint64 best;
+} Ttfb;
+
+/* Requests kept per model for the rolling summary */
+#define MODEL_WINDOW 200
+/* Cancellations kept for the stop latency */
+#define STOP_WINDOW 100
+
+static GMutex      stats_lock;
+static WireStats   wire;
+static GHashTable *backends = NULL;   /* base_url -> BackendNet* */
+static Ttfb        ttfb_cold, ttfb_warm;
+static GHashTable *models = NULL;     /* model -> GQueue of ReqTiming* */
+static gint64      stops[STOP_WINDOW];   /* µs, ring */
+static guint       stops_n, stops_pos;
+
+/* --- Wire bytes ---------------------------------------------------------- */
+
+void stats_add_request(gsize raw, gsize wire_len)
+{
+    g_mutex_lock(&stats_lock);
+    wire.req_raw  += raw;
+    wire.req_wire += wire_len;
+    g_mutex_unlock(&stats_lock);
+}
+
+void stats_add_response(gsize raw, gsize wire_len)
+{
+    g_mutex_lock(&stats_lock);
+    wire.resp_raw  += raw;
+    wire.resp_wire += wire_len;
+    g_mutex_unlock(&stats_lock);
+}
+
+void stats_get_wire(WireStats *out)
+{
+    g_mutex_lock(&stats_lock);
+    *out = wire;
+    g_mutex_unlock(&stats_lock);
+}
+
+static gchar* format_saved(guint64 raw, guint64 sent)
+{
+    gchar *r = g_format_size(raw);
+    gchar *s = g_format_size(sent);
+    gchar *txt;
+
+    if (raw > sent)
+        txt = g_strdup_printf("%s → %s (-%.0f %%)", r, s,
+                              100.0 * (gdouble)(raw - sent) / (gdouble)raw);
+    else
+        txt = g_strdup_printf("%s", s);
+    g_free(r);
+    g_free(s);
+    return txt;
+}
+
+gchar* stats_format_wire(void)
+{
+    WireStats w;
+    stats_get_wire(&w);
+
+    gchar *req = format_saved(w.req_raw, w.req_wire);
+    gchar *resp = format_saved(w.resp_raw, w.resp_wire);
+    gchar *txt = g_strdup_printf("Envoyé : %s\nReçu (hors streaming) : %s",
+                                 req, resp);
+    g_free(req);
+    g_free(resp);
+    return txt;
+}
+
+/* --- Protocols ----------------------------------------------------------- */
+
+void stats_add_transfer(const gchar *base_url, long http_version, long new_conns)
+{
+    if (!base_url || http_version == 0)
+        return;
+
+    g_mutex_lock(&stats_lock);
+    if (!backends)
+        backends = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    BackendNet *b = g_hash_table_lookup(backends, base_url);
+    if (!b)
+    {
+        b = g_new0(BackendNet, 1);
+        g_hash_table_insert(backends, g_strdup(base_url), b);
+    }
+    b->http_version = http_version;
+    b->transfers++;
+    b->connects += (guint)MAX(new_conns, 0);
+    g_mutex_unlock(&stats_lock);
+}
+
+static const gchar* http_version_name(long v)
+{
+    switch (v)
+    {
+        case CURL_HTTP_VERSION_1_0: return "HTTP/1.0";
+        case CURL_HTTP_VERSION_1_1: return "HTTP/1.1";
+        case CURL_HTTP_VERSION_2_0: return "HTTP/2";
+#if LIBCURL_VERSION_NUM >= 0x074200
+        case CURL_HTTP_VERSION_3:   return "HTTP/3";
+#endif
+        default:                    return "?";
+    }
+}
+
+gchar* stats_format_protocols(void)
+{
+    GString *gs = g_string_new(NULL);
+
+    g_mutex_lock(&stats_lock);
+    if (backends)
+    {
+        GHashTableIter it;
+        gpointer key, value;
+        g_hash_table_iter_init(&it, backends);
+        while (g_hash_table_iter_next(&it, &key, &value))
+        {
+            BackendNet *b = (BackendNet *)value;
+            if (gs->len) g_string_append_c(gs, '\n');
+            g_string_append_printf(gs, "%s : %s, %u requête(s) sur %u connexion(s)",
+                                   (const gchar *)key,
+                                   http_version_name(b->http_version),
+                                   b->transfers, b->connects);
+        }
+    }
+    g_mutex_unlock(&stats_lock);
+
+    if (gs->len == 0)
+        g_string_append(gs, "Protocole : aucune requête pour l'instant");
+    return g_string_free(gs, FALSE);
+}
+
+/* --- Time to first byte ------------------------------------------------- */
+
+void stats_add_ttfb(gint64 usec, gboolean warm)
+{
+    if (usec <= 0)
+        return;
+
+    g_mutex_lock(&stats_lock);
+    Ttfb *t = warm ? &ttfb_warm : &ttfb_cold;
+    if (t->count == 0 || usec < t->best)
+        t->best = usec;
+    t->count++;
+    t->total += usec;
+    g_mutex_unlock(&stats_lock);
+}
+
+static void append_ttfb(GString *gs, const gchar *label, const Ttfb *t)
+{
+    if (t->count == 0)
+        g_string_append_printf(gs, "%s –", label);
+    else
+        g_string_append_printf(gs, "%s %.0f ms (min %.0f, %u req.)", label,
+                               (gdouble)t->total / t->count / 1000.0,
+                               (gdouble)t->best / 1000.0, t->count);
+}
+
+gchar* stats_format_ttfb(void)
+{
+    Ttfb cold, warm;
+    g_mutex_lock(&stats_lock);
+    cold = ttfb_cold;
+    warm = ttfb_warm;
+    g_mutex_unlock(&stats_lock);
+
+    GString *gs = g_string_new("Premier octet : ");
+    append_ttfb(gs, "à froid", &cold);
+    append_ttfb(gs, ", à chaud", &warm);
+    return g_string_free(gs, FALSE);
+}
+
+/* --- Per-request timings ------------------------------------------------ */
+
+static void timing_queue_free(gpointer data)
+{
+    g_queue_free_full((GQueue *)data, g_free);
+}
+
+static gint cmp_u32(gconstpointer a, gconstpointer b)
+{
+    guint32 x = *(const guint32 *)a, y = *(const guint32 *)b;
+    return x < y ? -1 : x > y;
+}
+
+static gint cmp_i64(gconstpointer a, gconstpointer b)
+{
+    gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank index of quantile @q in @n sorted values */
+static guint rank(guint n, gdouble q)
+{
+    guint r = (guint)(q * n + 0.999999);
+    return r == 0 ? 0 : MIN(r, n) - 1;
+}
+
+void stats_timing_set_gaps(ReqTiming *t, GArray *gaps)
+{
+    if (!gaps || gaps->len == 0)
+    {
+        t->gap_p50 = t->gap_p99 = -1;
+        return;
+    }
+    g_array_sort(gaps, cmp_u32);
+    t->gap_p50 = g_array_index(gaps, guint32, rank(gaps->len, 0.50));
+    t->gap_p99 = g_array_index(gaps, guint32, rank(gaps->len, 0.99));
+}
+
+void stats_add_timing(const gchar *model, const ReqTiming *t)
+{
+    if (!model)
+        return;
+
+    g_mutex_lock(&stats_lock);
+    if (!models)
+        models = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                       timing_queue_free);
+    GQueue *q = g_hash_table_lookup(models, model);
+    if (!q)
+    {
+        q = g_queue_new();
+        g_hash_table_insert(models, g_strdup(model), q);
+    }
+    g_queue_push_tail(q, g_memdup2(t, sizeof *t));
+    if (q->length > MODEL_WINDOW)
+        g_free(g_queue_pop_head(q));
+    g_mutex_unlock(&stats_lock);
+}
+
+/* "850 ms", "4,2 s" */
+static gchar* fmt_us(gint64 us)
+{
+    if (us < 0)
+        return g_strdup("–");
+    if (us < 10 * G_USEC_PER_SEC)
+        return g_strdup_printf("%.0f ms", us / 1000.0);
+    return g_strdup_printf("%.1f s", us / 1e6);
+}
+
+gchar* stats_format_timing(const ReqTiming *t)
+{
+    gchar *first = fmt_us(t->first_token);
+    gchar *total = fmt_us(t->total);
+    GString *gs = g_string_new(NULL);
+
+    g_string_append_printf(gs, "1er token %s · %" G_GINT64_FORMAT " tokens",
+                           first, t->tokens);
+    if (t->tokens_per_s > 0)
+        g_string_append_printf(gs, " · %.1f tok/s", t->tokens_per_s);
+    g_string_append_printf(gs, " · total %s", total);
+    if (t->gap_p50 >= 0)
+        g_string_append_printf(gs, " · écart p50 %.0f / p99 %.0f ms",
+                               t->gap_p50 / 1000.0, t->gap_p99 / 1000.0);
+    g_free(first);
+    g_free(total);
+    return g_string_free(gs, FALSE);
+}
+
+gchar* stats_format_timing_details(const ReqTiming *t)
+{
+    return g_strdup_printf("DNS : %.1f ms\nConnexion : %.1f ms\nTLS : %.1f ms\n"
+                           "Premier octet : %.1f ms\nPremier token : %.1f ms\n"
+                           "Total : %.1f ms",
+                           t->dns / 1000.0, t->connect / 1000.0, t->tls / 1000.0,
+                           t->ttfb / 1000.0, t->first_token / 1000.0,
+                           t->total / 1000.0);
+}
+
+/* Median of the gint64 at @offset in each ReqTiming of @q, skipping < 0 */
+static gint64 median_field(GQueue *q, gsize offset)
+{
+    GArray *v = g_array_sized_new(FALSE, FALSE, sizeof(gint64), q->length);
+    for (GList *l = q->head; l; l = l->next)
+    {
+        gint64 x = G_STRUCT_MEMBER(gint64, l->data, offset);
+        if (x >= 0)
+            g_array_append_val(v, x);
+    }
+    gint64 m = -1;
+    if (v->len > 0)
+    {
+        g_array_sort(v, cmp_i64);
+        m = g_array_index(v, gint64, rank(v->len, 0.50));
+    }
+    g_array_free(v, TRUE);
+    return m;
+}
+
+gint64 stats_first_token_quantile(const gchar *model, gdouble q,
+                                  guint last, guint min_count)
+{
+    GArray *v = g_array_sized_new(FALSE, FALSE, sizeof(gint64), last);
+    gint64 r = -1;
+
+    g_mutex_lock(&stats_lock);
+    GQueue *tq = models && model ? g_hash_table_lookup(models, model) : NULL;
+    for (GList *l = tq ? tq->tail : NULL; l && v->len < last; l = l->prev)
+    {
+        gint64 x = ((const ReqTiming *)l->data)->first_token;
+        if (x >= 0)
+            g_array_append_val(v, x);
+    }
+    g_mutex_unlock(&stats_lock);
+
+    if (v->len > 0 && v->len >= min_count)
+    {
+        g_array_sort(v, cmp_i64);
+        r = g_array_index(v, gint64, rank(v->len, q));
+    }
+    g_array_free(v, TRUE);
+    return r;
+}
+
+static gint cmp_summary(gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0(((const ModelSummary *)a)->model,
+                     ((const ModelSummary *)b)->model);
+}
+
+GList* stats_model_summaries(void)
+{
+    GList *out = NULL;
+
+    g_mutex_lock(&stats_lock);
+    if (models)
+    {
+        GHashTableIter it;
+        gpointer key, value;
+        g_hash_table_iter_init(&it, models);
+        while (g_hash_table_iter_next(&it, &key, &value))
+        {
+            GQueue *q = (GQueue *)value;
+            ModelSummary *m = g_new0(ModelSummary, 1);
+            m->model = g_strdup((const gchar *)key);
+            m->count = q->length;
+            m->ttfb_p50 = median_field(q, G_STRUCT_OFFSET(ReqTiming, ttfb));
+            m->first_token_p50 = median_field(q, G_STRUCT_OFFSET(ReqTiming, first_token));
+            m->total_p50 = median_field(q, G_STRUCT_OFFSET(ReqTiming, total));
+            m->gap_p50 = median_field(q, G_STRUCT_OFFSET(ReqTiming, gap_p50));
+            m->gap_p99 = median_field(q, G_STRUCT_OFFSET(ReqTiming, gap_p99));
+
+            guint n = 0;
+            for (GList *l = q->head; l; l = l->next)
+            {
+                const ReqTiming *t = (const ReqTiming *)l->data;
+                if (t->tokens_per_s > 0)
+                {
+                    m->tokens_per_s += t->tokens_per_s;
+                    n++;
+                }
+            }
+            if (n) m->tokens_per_s /= n;
+            out = g_list_prepend(out, m);
+        }
+    }
+    g_mutex_unlock(&stats_lock);
+
+    return g_list_sort(out, cmp_summary);
+}
+
+static void summary_free(gpointer data)
+{
+    ModelSummary *m = (ModelSummary *)data;
+    g_free(m->model);
+    g_free(m);
+}
+
+void stats_model_summaries_free(GList *list)
+{
+    g_list_free_full(list, summary_free);
+}
+
+static void csv_ms(GString *gs, gint64 us)
+{
+    if (us >= 0)
+        g_string_append_printf(gs, ",%.1f", us / 1000.0);
+    else
+        g_string_append_c(gs, ',');
+}
+
+gboolean stats_export_csv(const gchar *path, GError **error)
+{
+    GString *gs = g_string_new("time,model,dns_ms,connect_ms,tls_ms,ttfb_ms,"
+                               "first_token_ms,total_ms,tokens,tokens_per_s,"
+                               "gap_p50_ms,gap_p99_ms\n");
+
+    g_mutex_lock(&stats_lock);
+    if (models)
+    {
+        GHashTableIter it;
+        gpointer key, value;
+        g_hash_table_iter_init(&it, models);
+        while (g_hash_table_iter_next(&it, &key, &value))
+        {
+            gchar **parts = g_strsplit((const gchar *)key, "\"", -1);
+            gchar *quoted = g_strjoinv("\"\"", parts);
+            g_strfreev(parts);
+
+            for (GList *l = ((GQueue *)value)->head; l; l = l->next)
+            {
+                const ReqTiming *t = (const ReqTiming *)l->data;
+                GDateTime *dt = g_date_time_new_from_unix_local(t->when / G_USEC_PER_SEC);
+                gchar *when = dt ? g_date_time_format(dt, "%Y-%m-%d %H:%M:%S") : g_strdup("");
+                if (dt) g_date_time_unref(dt);
+
+                g_string_append_printf(gs, "%s,\"%s\"", when, quoted);
+                csv_ms(gs, t->dns);
+                csv_ms(gs, t->connect);
+                csv_ms(gs, t->tls);
+                csv_ms(gs, t->ttfb);
+                csv_ms(gs, t->first_token);
+                csv_ms(gs, t->total);
+                g_string_append_printf(gs, ",%" G_GINT64_FORMAT ",%.2f",
+                                       t->tokens, t->tokens_per_s);
+                csv_ms(gs, t->gap_p50);
+                csv_ms(gs, t->gap_p99);
+                g_string_append_c(gs, '\n');
+                g_free(when);
+            }
+            g_free(quoted);
+        }
+    }
+    g_mutex_unlock(&stats_lock);
+
+    gboolean ok = g_file_set_contents(path, gs->str, (gssize)gs->len, error);
+    g_string_free(gs, TRUE);
+    return ok;
+}
+
+/* --- Stop latency ------------------------------------------------------- */
+
+void stats_add_stop(gint64 usec)
+{
+    g_mutex_lock(&stats_lock);
+    stops[stops_pos] = MAX(usec, 0);
+    stops_pos = (stops_pos + 1) % STOP_WINDOW;
+    stops_n = MIN(stops_n + 1, STOP_WINDOW);
+    g_mutex_unlock(&stats_lock);
+}
+
+gchar* stats_format_stop(void)
+{
+    GArray *v = g_array_sized_new(FALSE, FALSE, sizeof(gint64), STOP_WINDOW);
+
+    g_mutex_lock(&stats_lock);
+    g_array_append_vals(v, stops, stops_n);
+    g_mutex_unlock(&stats_lock);
+
+    gchar *txt = NULL;
+    if (v->len > 0)
+    {
+        g_array_sort(v, cmp_i64);
+        txt = g_strdup_printf("Arrêt : %.1f ms médian, %.1f ms au pire entre Stop et "
+                              "la coupure de la connexion (%u dernière(s) annulation(s))",
+                              g_array_index(v, gint64, rank(v->len, 0.5)) / 1000.0,
+                              g_array_index(v, gint64, v->len - 1) / 1000.0, v->len);
+    }
+    g_array_free(v, TRUE);
+    return txt;
+}
+
+void stats_cleanup(void)
+{
+    g_mutex_lock(&stats_lock);
+    g_clear_pointer(&backends, g_hash_table_destroy);
+    g_clear_pointer(&models, g_hash_table_destroy);
+    stops_n = stops_pos = 0;
+    g_mutex_unlock(&stats_lock);
+}
@@ -0,0 +1,115 @@
+/*
+ * stats.h — Transfer statistics for AI Chat plugin
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <glib.h>
+
+/* Body bytes before and after content coding, since the plugin loaded */
+typedef struct
+{
+    guint64 req_raw;     /* Request bodies as built */
+    guint64 req_wire;    /* Request bodies as sent */
+    guint64 resp_raw;    /* Response bodies after decoding */
+    guint64 resp_wire;   /* Response bodies as received */
+} WireStats;
+
+/* Record one request body (any thread) */
+void stats_add_request(gsize raw, gsize wire);
+
+/* Record one response body with negotiated encoding (any thread) */
+void stats_add_response(gsize raw, gsize wire);
+
+/* Snapshot of the counters */
+void stats_get_wire(WireStats *out);
+
+/* One-line summary for the UI (caller frees) */
+gchar* stats_format_wire(void);
+
+/*
+ * Record a finished transfer to @base_url: the HTTP version it used
+ * (CURL_HTTP_VERSION_*) and how many new connections it had to open
+ * (0 when it reused or multiplexed onto an existing one).
+ */
+void stats_add_transfer(const gchar *base_url, long http_version, long new_conns);
+
+/* Negotiated protocol per backend, one line each (caller frees) */
+gchar* stats_format_protocols(void);
+
+/*
+ * Record the time to first byte of a chat reply; @warm when the request
+ * went out on an already open connection.
+ */
+void stats_add_ttfb(gint64 usec, gboolean warm);
+
+/* Cold / warm TTFB summary (caller frees) */
+gchar* stats_format_ttfb(void);
+
+/* --- Per-request timings --- */
+
+/* One chat request. Durations in µs; phases are 0 on a reused connection */
+typedef struct
+{
+    gint64  when;           /* Wall-clock end (g_get_real_time) */
+    gint64  dns;
+    gint64  connect;
+    gint64  tls;
+    gint64  ttfb;           /* Start to first response byte */
+    gint64  first_token;    /* Start to first content */
+    gint64  total;
+    gint64  tokens;         /* Reported by the backend, else content chunks */
+    gdouble tokens_per_s;
+    gint64  gap_p50;        /* Between content chunks, -1 if unknown */
+    gint64  gap_p99;
+} ReqTiming;
+
+/* Per-model summary over the last requests */
+typedef struct
+{
+    gchar  *model;
+    guint   count;
+    gint64  ttfb_p50;
+    gint64  first_token_p50;
+    gint64  total_p50;
+    gdouble tokens_per_s;   /* Mean */
+    gint64  gap_p50;        /* Medians of the per-request values, -1 if none */
+    gint64  gap_p99;
+} ModelSummary;
+
+/* Fill gap_p50 / gap_p99 from inter-chunk gaps in µs (guint32, sorted in place) */
+void stats_timing_set_gaps(ReqTiming *t, GArray *gaps);
+
+/* Add a finished request to its model's rolling window (any thread) */
+void stats_add_timing(const gchar *model, const ReqTiming *t);
+
+/*
+ * Quantile @q of the time to first token over the last @last requests to
+ * @model, in µs; -1 when fewer than @min_count of them got a token
+ */
+gint64 stats_first_token_quantile(const gchar *model, gdouble q,
+                                  guint last, guint min_count);
+
+/* Compact one-line footer and a multi-line breakdown (caller frees) */
+gchar* stats_format_timing(const ReqTiming *t);
+gchar* stats_format_timing_details(const ReqTiming *t);
+
+/* Summaries sorted by model name; free with stats_model_summaries_free() */
+GList* stats_model_summaries(void);
+void   stats_model_summaries_free(GList *list);
+
+/* Time from Stop to the cancelled transfer being torn down, µs (any thread) */
+void stats_add_stop(gint64 usec);
+
+/* Median and worst stop latency over the last cancellations, or NULL if
+ * none (caller frees) */
+gchar* stats_format_stop(void);
+
+/* Write every recorded request as CSV */
+gboolean stats_export_csv(const gchar *path, GError **error);
+
+/* Drop per-backend and per-model records (plugin unload) */
+void stats_cleanup(void);
+
+#endif /* STATS_H */
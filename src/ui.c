@@ -8,6 +8,11 @@
 #include "network.h"
 #include "ui_render.h"
 #include "models.h"
+#include "byte_ring.h"
+#include "stats.h"
+#include "respcache.h"
+#include "capture.h"
+#include "endpoints.h"
 #include <string.h>
 
 Ui ui;
@@ -68,19 +73,38 @@ static gboolean chat_event_blocker(GtkWidget *widget, GdkEvent *event, gpointer
 
 /* --- Autoscroll ---------------------------------------------------------- */
 
-static gboolean autoscroll_idle_cb(gpointer data)
+static void scroll_to_bottom(GtkWidget *scroll)
 {
-    (void)data;
-    if (!ui.scroll) return FALSE;
-    GtkAdjustment *vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(ui.scroll));
-    if (!vadj) return FALSE;
+    GtkAdjustment *vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scroll));
+    if (!vadj) return;
     gdouble max = gtk_adjustment_get_upper(vadj) - gtk_adjustment_get_page_size(vadj);
     if (max < 0) max = 0;
     gtk_adjustment_set_value(vadj, max);
+}
+
+static gboolean autoscroll_idle_cb(gpointer data)
+{
+    scroll_to_bottom(GTK_WIDGET(data));
     return FALSE;
 }
 
-void ui_autoscroll_soon(void) { g_idle_add(autoscroll_idle_cb, NULL); }
+static void autoscroll_widget_soon(GtkWidget *scroll)
+{
+    if (!scroll) return;
+    g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, autoscroll_idle_cb,
+                    g_object_ref(scroll), g_object_unref);
+}
+
+void ui_autoscroll_soon(ChatSession *s)
+{
+    if (s) autoscroll_widget_soon(s->scroll);
+}
+
+/* Autoscroll whichever session list the row lives in */
+static void autoscroll_row_soon(GtkWidget *row)
+{
+    autoscroll_widget_soon(gtk_widget_get_ancestor(row, GTK_TYPE_SCROLLED_WINDOW));
+}
 
 /* --- Clipboard ----------------------------------------------------------- */
 
@@ -90,6 +114,80 @@ void ui_copy_text_to_clipboard(const gchar *txt)
     gtk_clipboard_set_text(cb, txt ? txt : "", -1);
 }
 
+/* --- Stream delivery ----------------------------------------------------- */
+
+/*
+ * The I/O thread writes decoded text into a per-row ring; a tick callback
+ * on the stream view drains it once per frame with a single insert and a
+ * single scroll, however many tokens arrived in between.
+ */
+
+/* Several seconds of output from even the fastest local model */
+#define STREAM_RING_SIZE (256 * 1024)
+
+typedef struct
+{
+    ByteRing *ring;
+    GString  *pending;   /* Read from the ring, not inserted yet */
+    gboolean  scroll;    /* Text went in on the previous frame */
+} StreamTick;
+
+static void stream_tick_free(gpointer data)
+{
+    StreamTick *t = (StreamTick *)data;
+    byte_ring_unref(t->ring);
+    g_string_free(t->pending, TRUE);
+    g_free(t);
+}
+
+/* Length of @s without a UTF-8 sequence cut off at the end */
+static gsize utf8_complete_len(const gchar *s, gsize n)
+{
+    for (gsize i = n; i > 0 && n - i < 4; i--)
+    {
+        guchar c = (guchar)s[i - 1];
+        if ((c & 0xC0) == 0x80)
+            continue;
+        gsize need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return (n - (i - 1) >= need) ? n : i - 1;
+    }
+    return n;
+}
+
+static gboolean stream_tick_cb(GtkWidget *tv, GdkFrameClock *clock, gpointer data)
+{
+    StreamTick *t = (StreamTick *)data;
+    (void)clock;
+
+    /* Last frame's text has been laid out by now: follow it */
+    if (t->scroll)
+    {
+        GtkWidget *scroll = gtk_widget_get_ancestor(tv, GTK_TYPE_SCROLLED_WINDOW);
+        if (scroll) scroll_to_bottom(scroll);
+        t->scroll = FALSE;
+    }
+
+    byte_ring_read_all(t->ring, t->pending);
+    gsize n = utf8_complete_len(t->pending->str, t->pending->len);
+    if (n == 0)
+        return G_SOURCE_CONTINUE;
+
+    GtkTextBuffer *buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(tv));
+    GtkTextIter it;
+    gtk_text_buffer_get_end_iter(buf, &it);
+    if (g_utf8_validate(t->pending->str, (gssize)n, NULL))
+        gtk_text_buffer_insert(buf, &it, t->pending->str, (gint)n);
+    else
+    {
+        gchar *valid = g_utf8_make_valid(t->pending->str, (gssize)n);
+        gtk_text_buffer_insert(buf, &it, valid, -1);
+        g_free(valid);
+    }
+    g_string_erase(t->pending, 0, (gssize)n);
+    t->scroll = TRUE;
+    return G_SOURCE_CONTINUE;
+}
+
 /* --- Row helpers --------------------------------------------------------- */
 
 static GtkWidget* make_row_container(void)
@@ -100,7 +198,8 @@ static GtkWidget* make_row_container(void)
     return row;
 }
 
-void ui_add_user_row(const gchar *text)
+/* User row at @pos in the message list (-1 = at the end) */
+static void add_user_row_at(ChatSession *s, const gchar *text, gint pos)
 {
     GtkWidget *row = make_row_container();
     GtkWidget *outer = gtk_bin_get_child(GTK_BIN(row));
@@ -125,12 +224,37 @@ void ui_add_user_row(const gchar *text)
     gtk_box_pack_start(GTK_BOX(outer), hdr, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(outer), lbl, FALSE, FALSE, 0);
 
-    gtk_list_box_insert(GTK_LIST_BOX(ui.msg_list), row, -1);
+    gtk_list_box_insert(GTK_LIST_BOX(s->msg_list), row, pos);
     gtk_widget_show_all(row);
-    ui_autoscroll_soon();
+    ui_autoscroll_soon(s);
+}
+
+void ui_add_user_row(ChatSession *s, const gchar *text)
+{
+    add_user_row_at(s, text, -1);
 }
 
-GtkWidget* ui_add_assistant_stream_row(Req *req)
+/* Text view the stream of @req is drawn into, fed from its ring */
+static GtkWidget* make_stream_view(Req *req)
+{
+    GtkWidget *tv = gtk_text_view_new();
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(tv), GTK_WRAP_WORD_CHAR);
+    gtk_text_view_set_editable(GTK_TEXT_VIEW(tv), FALSE);
+    gtk_widget_set_name(tv, "stream-view");
+
+    StreamTick *t = g_new0(StreamTick, 1);
+    t->ring = byte_ring_new(STREAM_RING_SIZE);
+    t->pending = g_string_new(NULL);
+    gtk_widget_add_tick_callback(tv, stream_tick_cb, t, stream_tick_free);
+    g_object_set_data(G_OBJECT(tv), "stream-tick", t);
+
+    req->stream_view = tv;
+    req->stream_buf  = gtk_text_view_get_buffer(GTK_TEXT_VIEW(tv));
+    req->stream_ring = byte_ring_ref(t->ring);
+    return tv;
+}
+
+static GtkWidget* add_assistant_row_at(ChatSession *s, Req *req, gint pos)
 {
     GtkWidget *row = make_row_container();
     GtkWidget *outer = gtk_bin_get_child(GTK_BIN(row));
@@ -141,70 +265,55 @@ GtkWidget* ui_add_assistant_stream_row(Req *req)
     g_free(markup);
     gtk_label_set_xalign(GTK_LABEL(hdr), 0.0);
 
-    GtkWidget *tv = gtk_text_view_new();
-    GtkTextBuffer *buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(tv));
-    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(tv), GTK_WRAP_WORD_CHAR);
-    gtk_text_view_set_editable(GTK_TEXT_VIEW(tv), FALSE);
-    gtk_widget_set_name(tv, "stream-view");
-
     gtk_box_pack_start(GTK_BOX(outer), hdr, FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(outer), tv,  FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(outer), make_stream_view(req), FALSE, FALSE, 0);
 
-    gtk_list_box_insert(GTK_LIST_BOX(ui.msg_list), row, -1);
+    gtk_list_box_insert(GTK_LIST_BOX(s->msg_list), row, pos);
     gtk_widget_show_all(row);
-    ui_autoscroll_soon();
+    ui_autoscroll_soon(s);
 
     req->row = row;
-    req->stream_view = tv;
-    req->stream_buf  = buf;
     return row;
 }
 
-void ui_add_info_row(const gchar *text)
+GtkWidget* ui_add_assistant_stream_row(ChatSession *s, Req *req)
+{
+    return add_assistant_row_at(s, req, -1);
+}
+
+static void session_add_info_row(ChatSession *s, const gchar *text)
 {
     GtkWidget *row = make_row_container();
     GtkWidget *outer = gtk_bin_get_child(GTK_BIN(row));
     GtkWidget *lbl = gtk_label_new(text);
     gtk_box_pack_start(GTK_BOX(outer), lbl, FALSE, FALSE, 0);
-    gtk_list_box_insert(GTK_LIST_BOX(ui.msg_list), row, -1);
+    gtk_list_box_insert(GTK_LIST_BOX(s->msg_list), row, -1);
     gtk_widget_show_all(row);
-    ui_autoscroll_soon();
+    ui_autoscroll_soon(s);
 }
 
-/* --- Network callbacks for UI -------------------------------------------- */
-
-typedef struct {
-    GtkTextBuffer *buf;
-    gchar         *text;
-} AppendCtx;
-
-static gboolean append_idle_cb(gpointer data)
+void ui_add_info_row(const gchar *text)
 {
-    AppendCtx *ctx = (AppendCtx*)data;
-    if (ctx->buf && ctx->text)
-    {
-        GtkTextIter it;
-        gtk_text_buffer_get_end_iter(ctx->buf, &it);
-        gtk_text_buffer_insert(ctx->buf, &it, ctx->text, -1);
-        ui_autoscroll_soon();
-    }
-    g_free(ctx->text);
-    g_free(ctx);
-    return FALSE;
+    ChatSession *s = ui_current_session();
+    if (s) session_add_info_row(s, text);
 }
 
-static void ui_stream_append(Req *req, const char *text, gssize len)
+/* --- Network callbacks for UI -------------------------------------------- */
+
+/* Runs on the I/O thread */
+static gsize ui_stream_append(Req *req, const char *text, gssize len)
 {
-    if (!text) return;
-    AppendCtx *ctx = g_new0(AppendCtx, 1);
-    ctx->buf  = req->stream_buf;
-    ctx->text = len >= 0 ? g_strndup(text, (gsize)len) : g_strdup(text);
-    g_idle_add(append_idle_cb, ctx);
+    if (!text) return 0;
+    gsize n = len >= 0 ? (gsize)len : strlen(text);
+    if (!req->stream_ring) return n;
+    return byte_ring_write(req->stream_ring, text, n);
 }
 
 typedef struct {
     GtkWidget *row;
     gchar     *final_text;
+    ReqTiming  timing;
+    gboolean   has_timing;
 } ReplaceCtx;
 
 static void replace_row_child(GtkWidget *row, GtkWidget *new_child)
@@ -213,7 +322,26 @@ static void replace_row_child(GtkWidget *row, GtkWidget *new_child)
     if (old) gtk_container_remove(GTK_CONTAINER(row), old);
     gtk_container_add(GTK_CONTAINER(row), new_child);
     gtk_widget_show_all(row);
-    ui_autoscroll_soon();
+    autoscroll_row_soon(row);
+}
+
+/* Compact latency line under an answer; the breakdown is in the tooltip */
+static GtkWidget* make_timing_footer(const ReqTiming *t)
+{
+    gchar *txt = stats_format_timing(t);
+    gchar *markup = g_markup_printf_escaped("<small>%s</small>", txt);
+    GtkWidget *lbl = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(lbl), markup);
+    g_free(markup);
+    g_free(txt);
+
+    gchar *tip = stats_format_timing_details(t);
+    gtk_widget_set_tooltip_text(lbl, tip);
+    g_free(tip);
+
+    gtk_label_set_xalign(GTK_LABEL(lbl), 0.0);
+    gtk_style_context_add_class(gtk_widget_get_style_context(lbl), "dim-label");
+    return lbl;
 }
 
 static gboolean replace_row_idle_cb(gpointer data)
@@ -222,6 +350,9 @@ static gboolean replace_row_idle_cb(gpointer data)
     if (ctx->row)
     {
         GtkWidget *comp = build_assistant_composite_from_markdown(ctx->final_text ? ctx->final_text : "");
+        if (ctx->has_timing)
+            gtk_box_pack_start(GTK_BOX(comp), make_timing_footer(&ctx->timing),
+                               FALSE, FALSE, 0);
         replace_row_child(ctx->row, comp);
     }
     g_free(ctx->final_text);
@@ -229,31 +360,127 @@ static gboolean replace_row_idle_cb(gpointer data)
     return FALSE;
 }
 
-static void ui_replace_row(GtkWidget *row, const gchar *final_text)
+static void ui_replace_row(GtkWidget *row, const gchar *final_text,
+                           const ReqTiming *timing)
 {
+    /* Comparison columns keep their answer for "Garder" */
+    if (row && g_object_get_data(G_OBJECT(row), "fanout-col"))
+        g_object_set_data_full(G_OBJECT(row), "final-text",
+                               g_strdup(final_text), g_free);
+
     ReplaceCtx *ctx = g_new0(ReplaceCtx, 1);
     ctx->row = row;
     ctx->final_text = g_strdup(final_text);
+    if (timing)
+    {
+        ctx->timing = *timing;
+        ctx->has_timing = TRUE;
+    }
     g_idle_add(replace_row_idle_cb, ctx);
 }
 
-static gboolean set_busy_idle_cb(gpointer data)
+typedef struct {
+    GtkWidget *row;
+    gchar     *status;
+} RowStatusCtx;
+
+static gboolean row_status_idle_cb(gpointer data)
+{
+    RowStatusCtx *ctx = (RowStatusCtx *)data;
+    GtkWidget *outer = gtk_bin_get_child(GTK_BIN(ctx->row));
+
+    /* Status label at the bottom of the row's box, created on first use */
+    if (outer && GTK_IS_BOX(outer))
+    {
+        GtkWidget *lbl = g_object_get_data(G_OBJECT(outer), "row-status");
+        if (!lbl)
+        {
+            lbl = gtk_label_new(NULL);
+            gtk_label_set_xalign(GTK_LABEL(lbl), 0.0);
+            gtk_style_context_add_class(gtk_widget_get_style_context(lbl), "dim-label");
+            gtk_box_pack_start(GTK_BOX(outer), lbl, FALSE, FALSE, 0);
+            g_object_set_data(G_OBJECT(outer), "row-status", lbl);
+        }
+        gtk_label_set_text(GTK_LABEL(lbl), ctx->status ? ctx->status : "");
+        gtk_widget_set_visible(lbl, ctx->status != NULL);
+    }
+    g_object_unref(ctx->row);
+    g_free(ctx->status);
+    g_free(ctx);
+    return FALSE;
+}
+
+/* Any thread; queued behind a pending ui_replace_row() of the same row */
+static void ui_row_status(GtkWidget *row, const gchar *status)
+{
+    if (!row) return;
+    RowStatusCtx *ctx = g_new0(RowStatusCtx, 1);
+    ctx->row = g_object_ref(row);
+    ctx->status = g_strdup(status);
+    g_idle_add(row_status_idle_cb, ctx);
+}
+
+/* The answer starts over: drop what was shown or is still queued */
+static void ui_restart_row(Req *req)
+{
+    if (!req->stream_view)
+        return;
+    StreamTick *t = g_object_get_data(G_OBJECT(req->stream_view), "stream-tick");
+    if (t)
+    {
+        byte_ring_read_all(t->ring, t->pending);
+        g_string_truncate(t->pending, 0);
+    }
+    gtk_text_buffer_set_text(req->stream_buf, "", -1);
+}
+
+/* Shared buttons follow the busy state of the session on screen */
+static void sync_buttons_to_session(ChatSession *s)
 {
-    gboolean on = GPOINTER_TO_INT(data);
-    ui.busy = on;
-    gtk_widget_set_sensitive(ui.btn_send,     !on);
-    gtk_widget_set_sensitive(ui.btn_send_sel, !on);
+    gboolean on = s && s->busy;
+    /* Send stays available: while busy it queues the prompt */
+    gtk_widget_set_tooltip_text(ui.btn_send, on ? "Mettre la question en file : elle "
+                                "partira dès la fin de la réponse en cours" : NULL);
+    gtk_widget_set_sensitive(ui.btn_compare,  !on);
     gtk_widget_set_sensitive(ui.btn_clear,    !on);
     gtk_widget_set_sensitive(ui.btn_reset,    !on);
     gtk_widget_set_sensitive(ui.btn_copy_all, !on);
     gtk_widget_set_sensitive(ui.btn_export,   !on);
     gtk_widget_set_sensitive(ui.btn_stop,      on);
-    return FALSE;
 }
 
-static void ui_set_busy(gboolean busy)
+static void session_set_busy(ChatSession *s, gboolean on)
 {
-    g_idle_add(set_busy_idle_cb, GINT_TO_POINTER(busy));
+    s->busy = on;
+    gtk_widget_set_sensitive(s->tab_stop,  on);
+    gtk_widget_set_sensitive(s->tab_close, !on);
+    gtk_widget_set_visible(s->tab_spinner, on);
+    if (on)
+        gtk_spinner_start(GTK_SPINNER(s->tab_spinner));
+    else
+        gtk_spinner_stop(GTK_SPINNER(s->tab_spinner));
+    if (s == ui_current_session())
+        sync_buttons_to_session(s);
+}
+
+static void fanout_col_busy(Req *req, gboolean busy);
+static void queue_next(ChatSession *s);
+
+/* Called on the main thread by the network module */
+static void ui_set_busy(Req *req, gboolean busy)
+{
+    ChatSession *s = (ChatSession *)req->session;
+    if (!s) return;
+    if (req->column)
+    {
+        fanout_col_busy(req, busy);
+        return;
+    }
+    s->req = busy ? req : NULL;
+    session_set_busy(s, busy);
+    /* The answer is in the history by now: next queued prompt, if any */
+    if (!busy)
+        queue_next(s);
 }
 
 /* --- Preferences from UI ------------------------------------------------- */
@@ -285,17 +512,14 @@ static void save_prefs_from_vals(ApiMode mode, const gchar *base, const gchar *m
 
 /* --- Send prompt --------------------------------------------------------- */
 
-void ui_send_prompt(const gchar *prompt)
+/* Request for @prompt in @s with the settings on screen (saved as prefs) */
+static Req* prompt_req_new(ChatSession *s, const gchar *prompt)
 {
-    if (!prompt || !*prompt) return;
-
     ApiMode mode; gchar *base; gchar *model; gdouble temp;
     gchar *key; gboolean stream;
     read_prefs_from_ui(&mode, &base, &model, &temp, &key, &stream);
     save_prefs_from_vals(mode, base, model, temp, key, stream);
 
-    ui_add_user_row(prompt);
-
     Req *req = g_new0(Req, 1);
     req->prompt    = g_strdup(prompt);
     req->mode      = mode;
@@ -303,26 +527,253 @@ void ui_send_prompt(const gchar *prompt)
     req->model     = model;
     req->temp      = temp;
     req->api_key   = key;
+    req->unix_socket = g_strdup(prefs.unix_socket);
+    req->pool      = g_strdup(prefs.url_pool);
     req->streaming = stream;
+    req->gzip_request = prefs.gzip_request;
+    req->retry_max = prefs.retry_max;
+    req->stall_secs = prefs.stall_secs;
+    req->hedge_to  = g_strdup(prefs.hedge_backend);
+    req->hedge_ms  = prefs.hedge_ms;
     req->accum     = g_string_new(NULL);
+    req->history   = s->history;
+    req->session   = s;
     g_atomic_int_set(&req->cancel, 0);
+    return req;
+}
 
-    ui_add_assistant_stream_row(req);
+/* Show @req's prompt and answer rows from @pos (-1 = at the end) and send it */
+static void prompt_dispatch(ChatSession *s, Req *req, gint pos)
+{
+    add_user_row_at(s, req->prompt, pos);
+    s->turns++;
+    add_assistant_row_at(s, req, pos < 0 ? -1 : pos + 1);
     network_send_request(req);
 }
 
+/* --- Prompt queue -------------------------------------------------------- */
+
+/*
+ * A prompt sent while the session is answering waits in its queue as a
+ * pending row, where it can still be edited or removed. Its request is
+ * built and its prompt escaped right away, and the backend connection
+ * warmed, so the head goes out as soon as the answer before it is in the
+ * history. Stop holds the queue until the next Envoyer.
+ */
+
+typedef struct
+{
+    ChatSession *s;
+    Req         *req;       /* Built, not sent yet */
+    GtkWidget   *row;       /* Pending row, replaced when sent */
+    GtkWidget   *hdr;
+    GtkWidget   *lbl;
+    gboolean     editing;   /* Edit dialog open: not sent meanwhile */
+} Queued;
+
+static void queued_free(Queued *q, gboolean destroy_row)
+{
+    if (destroy_row)
+        gtk_widget_destroy(q->row);
+    if (q->req)
+        network_request_free(q->req);
+    g_free(q);
+}
+
+/* Headers of the pending rows tell where each prompt stands */
+static void queue_update(ChatSession *s)
+{
+    guint i = 0;
+    for (GList *l = s->queue->head; l; l = l->next, i++)
+    {
+        Queued *q = l->data;
+        gchar *markup;
+        if (s->held)
+            markup = g_markup_printf_escaped("<b>Vous</b> <i>— en pause, "
+                                             "Envoyer pour reprendre</i>");
+        else if (i == 0)
+            markup = g_markup_printf_escaped("<b>Vous</b> <i>— en attente, "
+                                             "part à la fin de la réponse</i>");
+        else
+            markup = g_markup_printf_escaped("<b>Vous</b> <i>— en attente (%u)</i>", i + 1);
+        gtk_label_set_markup(GTK_LABEL(q->hdr), markup);
+        g_free(markup);
+    }
+}
+
+static void on_queued_edit(GtkButton *b, gpointer user_data)
+{
+    (void)b;
+    Queued *q = (Queued *)user_data;
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Modifier la question",
+                        GTK_WINDOW(gtk_widget_get_toplevel(ui.root_box)),
+                        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                        "Annuler", GTK_RESPONSE_CANCEL,
+                        "Appliquer", GTK_RESPONSE_OK,
+                        NULL);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 500, 300);
+
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+    gtk_container_set_border_width(GTK_CONTAINER(area), 8);
+
+    GtkWidget *sw = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    GtkWidget *tv = gtk_text_view_new();
+    gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(tv), GTK_WRAP_WORD_CHAR);
+    GtkTextBuffer *buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(tv));
+    gtk_text_buffer_set_text(buf, q->req->prompt, -1);
+    gtk_container_add(GTK_CONTAINER(sw), tv);
+    gtk_box_pack_start(GTK_BOX(area), sw, TRUE, TRUE, 0);
+
+    gtk_widget_show_all(dlg);
+
+    q->editing = TRUE;
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_OK)
+    {
+        GtkTextIter a, z;
+        gtk_text_buffer_get_bounds(buf, &a, &z);
+        gchar *txt = gtk_text_buffer_get_text(buf, &a, &z, FALSE);
+        if (*txt)
+        {
+            g_free(q->req->prompt);
+            q->req->prompt = txt;
+            network_prepare_request(q->req);
+            gtk_label_set_text(GTK_LABEL(q->lbl), txt);
+        }
+        else
+            g_free(txt);
+    }
+    q->editing = FALSE;
+    gtk_widget_destroy(dlg);
+
+    /* The previous answer may have finished while the dialog was open */
+    queue_next(q->s);
+}
+
+static void on_queued_remove(GtkButton *b, gpointer user_data)
+{
+    (void)b;
+    Queued *q = (Queued *)user_data;
+    ChatSession *s = q->s;
+
+    g_queue_remove(s->queue, q);
+    queued_free(q, TRUE);
+    if (g_queue_is_empty(s->queue))
+        s->held = FALSE;
+    queue_update(s);
+}
+
+/* Queue @prompt in @s behind the answer in progress */
+static void queue_add(ChatSession *s, const gchar *prompt)
+{
+    Queued *q = g_new0(Queued, 1);
+    q->s = s;
+    q->req = prompt_req_new(s, prompt);
+    network_prepare_request(q->req);
+
+    q->row = make_row_container();
+    GtkWidget *outer = gtk_bin_get_child(GTK_BIN(q->row));
+
+    q->hdr = gtk_label_new(NULL);
+    gtk_label_set_xalign(GTK_LABEL(q->hdr), 0.0);
+
+    q->lbl = gtk_label_new(prompt);
+    gtk_label_set_xalign(GTK_LABEL(q->lbl), 0.0);
+    gtk_label_set_line_wrap(GTK_LABEL(q->lbl), TRUE);
+    gtk_label_set_selectable(GTK_LABEL(q->lbl), TRUE);
+
+    GtkWidget *btns = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
+    GtkWidget *btn_edit = gtk_button_new_with_label("Modifier…");
+    GtkWidget *btn_remove = gtk_button_new_with_label("Retirer");
+    g_signal_connect(btn_edit,   "clicked", G_CALLBACK(on_queued_edit), q);
+    g_signal_connect(btn_remove, "clicked", G_CALLBACK(on_queued_remove), q);
+    gtk_box_pack_start(GTK_BOX(btns), btn_edit,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(btns), btn_remove, FALSE, FALSE, 0);
+
+    gtk_box_pack_start(GTK_BOX(outer), q->hdr, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(outer), q->lbl, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(outer), btns,   FALSE, FALSE, 0);
+
+    gtk_list_box_insert(GTK_LIST_BOX(s->msg_list), q->row, -1);
+    gtk_widget_show_all(q->row);
+    ui_autoscroll_soon(s);
+
+    /* Comparison answers only count once one is kept: wait for Envoyer */
+    if (s->fanout)
+        s->held = TRUE;
+    g_queue_push_tail(s->queue, q);
+    queue_update(s);
+}
+
+/* Send the head of @s's queue in place of its pending row, if the session
+ * is free for it */
+static void queue_next(ChatSession *s)
+{
+    if (s->busy || s->held || s->fanout || g_queue_is_empty(s->queue))
+        return;
+    Queued *q = g_queue_peek_head(s->queue);
+    if (q->editing)
+        return;
+
+    g_queue_pop_head(s->queue);
+    gint pos = gtk_list_box_row_get_index(GTK_LIST_BOX_ROW(q->row));
+    Req *req = q->req;
+    q->req = NULL;
+    queued_free(q, TRUE);
+    prompt_dispatch(s, req, pos);
+    queue_update(s);
+}
+
+/* Drop everything queued in @s (@destroy_rows: FALSE when they are
+ * going away with the page) */
+static void queue_clear(ChatSession *s, gboolean destroy_rows)
+{
+    Queued *q;
+    while ((q = g_queue_pop_head(s->queue)))
+        queued_free(q, destroy_rows);
+    s->held = FALSE;
+}
+
+void ui_send_prompt(const gchar *prompt)
+{
+    if (!prompt || !*prompt) return;
+    ChatSession *s = ui_current_session();
+    if (!s) return;
+
+    /* Behind the answer in progress, or behind prompts already waiting */
+    if (s->busy || !g_queue_is_empty(s->queue))
+    {
+        queue_add(s, prompt);
+        return;
+    }
+    prompt_dispatch(s, prompt_req_new(s, prompt), -1);
+}
+
 /* --- Button callbacks ---------------------------------------------------- */
 
 static void on_send(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
-    if (ui.busy) return;
+    ChatSession *s = ui_current_session();
+    if (!s) return;
     GtkTextIter a, z;
     gtk_text_buffer_get_bounds(ui.input_buf, &a, &z);
     gchar *prompt = gtk_text_buffer_get_text(ui.input_buf, &a, &z, FALSE);
     ui_send_prompt(prompt);
     gtk_text_buffer_set_text(ui.input_buf, "", -1);
     g_free(prompt);
+
+    /* Envoyer also resumes a queue held by Stop; while the stopped answer
+     * is still winding down, ui_set_busy sends the next one once it ends.
+     * A comparison holds the queue until it is over and one answer kept */
+    if (s->held && !s->fanout)
+    {
+        s->held = FALSE;
+        queue_update(s);
+        queue_next(s);
+    }
 }
 
 static void on_send_selection(GtkButton *b, gpointer u)
@@ -359,7 +810,10 @@ static void on_send_selection(GtkButton *b, gpointer u)
 static void on_clear(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
-    GList *children = gtk_container_get_children(GTK_CONTAINER(ui.msg_list));
+    ChatSession *s = ui_current_session();
+    queue_clear(s, FALSE);
+    history_clear_transcript(s->history);
+    GList *children = gtk_container_get_children(GTK_CONTAINER(s->msg_list));
     for (GList *l = children; l; l = l->next)
         gtk_widget_destroy(GTK_WIDGET(l->data));
     g_list_free(children);
@@ -368,153 +822,379 @@ static void on_clear(GtkButton *b, gpointer u)
 static void on_reset(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
-    history_init();
+    history_reset(ui_current_session()->history);
     ui_add_info_row("[Historique réinitialisé]");
 }
 
+/* Mark the stream of @req and stop it */
+static void stop_request(Req *req)
+{
+    GtkTextIter it;
+    network_cancel_request(req);
+    gtk_text_buffer_get_end_iter(req->stream_buf, &it);
+    gtk_text_buffer_insert(req->stream_buf, &it, "\n[Stop demandé]\n", -1);
+}
+
+static void fanout_stop(Fanout *fo);
+
+static void session_stop(ChatSession *s)
+{
+    /* Queued prompts wait for the next Envoyer rather than go out now */
+    if (s && !g_queue_is_empty(s->queue))
+    {
+        s->held = TRUE;
+        queue_update(s);
+    }
+    if (s && s->fanout)
+        fanout_stop(s->fanout);
+    else if (s && s->req)
+        stop_request(s->req);
+}
+
 static void on_stop(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
-    if (current_req)
+    session_stop(ui_current_session());
+}
+
+/* --- Comparison (fan-out) ------------------------------------------------ */
+
+/*
+ * "Comparer…" sends one prompt to several backend presets at once. The
+ * answers stream side by side in a single row, each column with its own
+ * Stop and timing footer. Every request answers on a private copy of the
+ * history: the conversation goes on only with the answer kept.
+ */
+
+typedef struct
+{
+    Fanout    *fo;
+    Req       *req;        /* In flight, NULL once finished */
+    gchar     *name;       /* Backend preset */
+    GtkWidget *frame;      /* req->row: the stream, then the answer */
+    GtkWidget *btn_stop;
+    GtkWidget *btn_keep;
+} FanoutCol;
+
+struct Fanout
+{
+    ChatSession *s;
+    gchar       *prompt;
+    FanoutCol   *cols;
+    guint        n_cols;
+    guint        running;   /* Columns still answering */
+    guint        turn;      /* s->turns when sent */
+    gboolean     kept;
+};
+
+static void fanout_free(gpointer data)
+{
+    Fanout *fo = (Fanout *)data;
+    for (guint i = 0; i < fo->n_cols; i++)
+        g_free(fo->cols[i].name);
+    g_free(fo->cols);
+    g_free(fo->prompt);
+    g_free(fo);
+}
+
+static void fanout_stop(Fanout *fo)
+{
+    for (guint i = 0; i < fo->n_cols; i++)
+        if (fo->cols[i].req)
+            stop_request(fo->cols[i].req);
+}
+
+/* The session stays busy until every column is done */
+static void fanout_col_busy(Req *req, gboolean busy)
+{
+    FanoutCol *c = (FanoutCol *)req->column;
+    Fanout *fo = c->fo;
+
+    if (busy)
+    {
+        c->req = req;
+        fo->running++;
+        return;
+    }
+
+    const gchar *text = g_object_get_data(G_OBJECT(c->frame), "final-text");
+    c->req = NULL;
+    gtk_widget_set_sensitive(c->btn_stop, FALSE);
+    gtk_widget_set_sensitive(c->btn_keep, !fo->kept && text && *text);
+    if (--fo->running == 0)
+    {
+        fo->s->fanout = NULL;
+        session_set_busy(fo->s, FALSE);
+        queue_next(fo->s);
+    }
+}
+
+static void on_fanout_stop(GtkButton *b, gpointer user_data)
+{
+    (void)b;
+    FanoutCol *c = (FanoutCol *)user_data;
+    if (c->req)
+        stop_request(c->req);
+}
+
+static void on_fanout_keep(GtkButton *b, gpointer user_data)
+{
+    FanoutCol *c = (FanoutCol *)user_data;
+    Fanout *fo = c->fo;
+    const gchar *text = g_object_get_data(G_OBJECT(c->frame), "final-text");
+
+    if (fo->kept || !text || !*text)
+        return;
+    if (fo->turn != fo->s->turns)
+    {
+        session_add_info_row(fo->s, "[Info] La conversation a continué depuis : "
+                                    "cette réponse ne peut plus être gardée.");
+        return;
+    }
+
+    fo->kept = TRUE;
+    history_add(fo->s->history, "user", fo->prompt);
+    history_add(fo->s->history, "assistant", text);
+    for (guint i = 0; i < fo->n_cols; i++)
+        gtk_widget_set_sensitive(fo->cols[i].btn_keep, FALSE);
+    gtk_button_set_label(b, "✓ Gardée");
+
+    gchar *msg = g_strdup_printf("[Réponse de %s gardée dans l'historique]", c->name);
+    session_add_info_row(fo->s, msg);
+    g_free(msg);
+}
+
+/* A request for @prompt with the settings of preset @b */
+static Req* fanout_req_new(ChatSession *s, const BackendPreset *b,
+                           const gchar *prompt, gboolean stream)
+{
+    Req *req = g_new0(Req, 1);
+    req->prompt    = g_strdup(prompt);
+    req->mode      = b->api_mode;
+    req->base      = g_strdup(b->base_url);
+    req->model     = g_strdup(b->model);
+    req->temp      = b->temperature;
+    req->api_key   = g_strdup(b->api_key);
+    req->unix_socket = g_strdup(b->unix_socket);
+    req->pool      = g_strdup(b->url_pool);
+    req->streaming = stream;
+    req->gzip_request = b->gzip_request;
+    req->retry_max = b->retry_max;
+    req->stall_secs = b->stall_secs;
+    req->accum     = g_string_new(NULL);
+    req->history   = history_context_copy(s->history);
+    req->own_history = TRUE;
+    req->session   = s;
+    g_atomic_int_set(&req->cancel, 0);
+    return req;
+}
+
+static GtkWidget* fanout_column(FanoutCol *c, Req *req, const BackendPreset *b)
+{
+    gchar *title = g_strdup_printf("%s · %s", b->name, b->model);
+    c->frame = gtk_frame_new(title);
+    g_free(title);
+    GtkWidget *inner = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+    gtk_box_pack_start(GTK_BOX(inner), make_stream_view(req), FALSE, FALSE, 0);
+    gtk_container_add(GTK_CONTAINER(c->frame), inner);
+    g_object_set_data(G_OBJECT(c->frame), "fanout-col", c);
+
+    c->btn_stop = gtk_button_new_with_label("Stop");
+    c->btn_keep = gtk_button_new_with_label("Garder");
+    gtk_widget_set_tooltip_text(c->btn_keep,
+        "Ajoute la question et cette réponse à l'historique de la conversation.");
+    gtk_widget_set_sensitive(c->btn_keep, FALSE);
+    g_signal_connect(c->btn_stop, "clicked", G_CALLBACK(on_fanout_stop), c);
+    g_signal_connect(c->btn_keep, "clicked", G_CALLBACK(on_fanout_keep), c);
+
+    GtkWidget *btns = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    gtk_box_pack_start(GTK_BOX(btns), c->btn_stop, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(btns), c->btn_keep, FALSE, FALSE, 0);
+
+    GtkWidget *col = gtk_box_new(GTK_ORIENTATION_VERTICAL, 4);
+    gtk_box_pack_start(GTK_BOX(col), c->frame, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(col), btns, FALSE, FALSE, 0);
+
+    req->row = c->frame;
+    req->column = c;
+    return col;
+}
+
+/* Send @prompt to each BackendPreset* of @backends in session @s */
+static void fanout_send(ChatSession *s, const gchar *prompt, GPtrArray *backends)
+{
+    gboolean stream = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(ui.chk_stream));
+
+    ui_add_user_row(s, prompt);
+
+    Fanout *fo = g_new0(Fanout, 1);
+    fo->s = s;
+    fo->prompt = g_strdup(prompt);
+    fo->turn = ++s->turns;
+    fo->n_cols = backends->len;
+    fo->cols = g_new0(FanoutCol, fo->n_cols);
+
+    GtkWidget *row = make_row_container();
+    GtkWidget *outer = gtk_bin_get_child(GTK_BIN(row));
+    g_object_set_data_full(G_OBJECT(row), "fanout", fo, fanout_free);
+
+    GtkWidget *hdr = gtk_label_new(NULL);
+    gchar *markup = g_markup_printf_escaped("<b>Comparaison</b> — %u backend%s",
+                                            fo->n_cols, fo->n_cols > 1 ? "s" : "");
+    gtk_label_set_markup(GTK_LABEL(hdr), markup);
+    g_free(markup);
+    gtk_label_set_xalign(GTK_LABEL(hdr), 0.0);
+
+    GtkWidget *cols = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
+    gtk_box_set_homogeneous(GTK_BOX(cols), TRUE);
+    GPtrArray *reqs = g_ptr_array_new();
+    for (guint i = 0; i < fo->n_cols; i++)
+    {
+        const BackendPreset *b = g_ptr_array_index(backends, i);
+        FanoutCol *c = &fo->cols[i];
+        c->fo = fo;
+        c->name = g_strdup(b->name);
+        Req *req = fanout_req_new(s, b, prompt, stream);
+        gtk_box_pack_start(GTK_BOX(cols), fanout_column(c, req, b), TRUE, TRUE, 0);
+        g_ptr_array_add(reqs, req);
+    }
+
+    gtk_box_pack_start(GTK_BOX(outer), hdr, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(outer), cols, FALSE, FALSE, 0);
+    gtk_list_box_insert(GTK_LIST_BOX(s->msg_list), row, -1);
+    gtk_widget_show_all(row);
+    ui_autoscroll_soon(s);
+
+    s->fanout = fo;
+    session_set_busy(s, TRUE);
+    for (guint i = 0; i < reqs->len; i++)
+        network_send_request(g_ptr_array_index(reqs, i));
+    g_ptr_array_free(reqs, TRUE);
+}
+
+/* Backend presets ticked in the dialog (BackendPreset*, borrowed from
+ * prefs), or NULL if cancelled */
+static GPtrArray* choose_backends(void)
+{
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Comparer des backends",
+                        GTK_WINDOW(gtk_widget_get_toplevel(ui.root_box)),
+                        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                        "Annuler", GTK_RESPONSE_CANCEL,
+                        "Comparer", GTK_RESPONSE_OK,
+                        NULL);
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+    gtk_container_set_border_width(GTK_CONTAINER(area), 12);
+    gtk_box_set_spacing(GTK_BOX(area), 4);
+
+    GtkWidget *lbl = gtk_label_new("Envoyer la question à :");
+    gtk_label_set_xalign(GTK_LABEL(lbl), 0.0);
+    gtk_box_pack_start(GTK_BOX(area), lbl, FALSE, FALSE, 0);
+
+    GPtrArray *checks = g_ptr_array_new();
+    for (GList *l = prefs.backend_presets; l; l = l->next)
+    {
+        BackendPreset *b = (BackendPreset *)l->data;
+        gchar *txt = g_strdup_printf("%s (%s)", b->name, b->model);
+        GtkWidget *chk = gtk_check_button_new_with_label(txt);
+        g_free(txt);
+        gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(chk), TRUE);
+        g_object_set_data(G_OBJECT(chk), "backend", b);
+        gtk_box_pack_start(GTK_BOX(area), chk, FALSE, FALSE, 0);
+        g_ptr_array_add(checks, chk);
+    }
+    gtk_widget_show_all(dlg);
+
+    GPtrArray *picked = NULL;
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_OK)
+    {
+        picked = g_ptr_array_new();
+        for (guint i = 0; i < checks->len; i++)
+        {
+            GtkWidget *chk = g_ptr_array_index(checks, i);
+            if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk)))
+                g_ptr_array_add(picked, g_object_get_data(G_OBJECT(chk), "backend"));
+        }
+    }
+    g_ptr_array_free(checks, TRUE);
+    gtk_widget_destroy(dlg);
+    return picked;
+}
+
+static void on_compare(GtkButton *b, gpointer u)
+{
+    (void)b; (void)u;
+    ChatSession *s = ui_current_session();
+    if (!s || s->busy) return;
+
+    if (!prefs.backend_presets)
+    {
+        ui_add_info_row("[Info] Aucun backend enregistré : créez-en avec Backends….");
+        return;
+    }
+    GtkTextIter a, z;
+    gtk_text_buffer_get_bounds(ui.input_buf, &a, &z);
+    gchar *prompt = gtk_text_buffer_get_text(ui.input_buf, &a, &z, FALSE);
+    if (!*g_strstrip(prompt))
+    {
+        ui_add_info_row("[Info] Écrivez d'abord la question à comparer.");
+        g_free(prompt);
+        return;
+    }
+
+    GPtrArray *picked = choose_backends();
+    if (picked && picked->len > 0)
     {
-        g_atomic_int_set(&current_req->cancel, 1);
-        GtkTextIter it;
-        gtk_text_buffer_get_end_iter(current_req->stream_buf, &it);
-        gtk_text_buffer_insert(current_req->stream_buf, &it, "\n[Stop demandé]\n", -1);
+        fanout_send(s, prompt, picked);
+        gtk_text_buffer_set_text(ui.input_buf, "", -1);
     }
+    if (picked)
+        g_ptr_array_free(picked, TRUE);
+    g_free(prompt);
+}
+
+/* Header of a transcript message, NULL for the system prompt */
+static const gchar* message_speaker(const ChatMessage *m)
+{
+    if (g_strcmp0(m->role, "user") == 0)
+        return "Vous";
+    if (g_strcmp0(m->role, "assistant") == 0)
+        return "Assistant";
+    return NULL;
 }
 
 static void on_copy_all(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
+    ChatHistory *h = ui_current_session()->history;
     GString *out = g_string_new("");
-    GList *rows = gtk_container_get_children(GTK_CONTAINER(ui.msg_list));
-    for (GList *r = rows; r; r = r->next)
+    for (guint i = 0; i < history_transcript_len(h); i++)
     {
-        GtkWidget *outer = gtk_bin_get_child(GTK_BIN(r->data));
-        GList *kids = gtk_container_get_children(GTK_CONTAINER(outer));
-        for (GList *k = kids; k; k = k->next)
-        {
-            if (GTK_IS_LABEL(k->data))
-            {
-                const gchar *t = gtk_label_get_text(GTK_LABEL(k->data));
-                if (t) g_string_append_printf(out, "%s\n", t);
-            }
-            else if (GTK_IS_BOX(k->data))
-            {
-                GList *bb = gtk_container_get_children(GTK_CONTAINER(k->data));
-                if (bb && bb->next && GTK_SOURCE_IS_VIEW(bb->next->data))
-                {
-                    GtkTextBuffer *tb = gtk_text_view_get_buffer(GTK_TEXT_VIEW(bb->next->data));
-                    GtkTextIter a, z;
-                    gtk_text_buffer_get_bounds(tb, &a, &z);
-                    gchar *ct = gtk_text_buffer_get_text(tb, &a, &z, FALSE);
-                    const gchar *lang_hint = "";
-                    if (GTK_SOURCE_IS_BUFFER(tb))
-                    {
-                        GtkSourceLanguage *sl = gtk_source_buffer_get_language(GTK_SOURCE_BUFFER(tb));
-                        if (sl)
-                        {
-                            const gchar *id = gtk_source_language_get_id(sl);
-                            if (id && *id) lang_hint = id;
-                            else
-                            {
-                                const gchar *nm = gtk_source_language_get_name(sl);
-                                if (nm && *nm) lang_hint = nm;
-                            }
-                        }
-                    }
-                    if (lang_hint && *lang_hint)
-                        g_string_append_printf(out, "```%s\n", lang_hint);
-                    else
-                        g_string_append(out, "```\n");
-                    g_string_append(out, ct);
-                    g_string_append(out, "\n```\n");
-                    g_free(ct);
-                }
-                if (bb) g_list_free(bb);
-            }
-        }
-        if (kids) g_list_free(kids);
+        const ChatMessage *m = history_transcript_nth(h, i);
+        const gchar *who = message_speaker(m);
+        if (who)
+            g_string_append_printf(out, "%s\n%s\n", who, m->content);
     }
-    if (rows) g_list_free(rows);
     ui_copy_text_to_clipboard(out->str);
     g_string_free(out, TRUE);
 }
 
 static gchar* generate_conversation_markdown(void)
 {
+    ChatHistory *h = ui_current_session()->history;
     GString *out = g_string_new("# Conversation AI Chat\n\n");
-    GList *rows = gtk_container_get_children(GTK_CONTAINER(ui.msg_list));
 
-    for (GList *r = rows; r; r = r->next)
+    for (guint i = 0; i < history_transcript_len(h); i++)
     {
-        GtkWidget *outer = gtk_bin_get_child(GTK_BIN(r->data));
-        GList *kids = gtk_container_get_children(GTK_CONTAINER(outer));
-        gboolean is_first = TRUE;
-
-        for (GList *k = kids; k; k = k->next)
-        {
-            if (GTK_IS_LABEL(k->data))
-            {
-                const gchar *t = gtk_label_get_text(GTK_LABEL(k->data));
-                if (t && *t)
-                {
-                    /* Check if it's a header (Vous/Assistant) */
-                    if (is_first && (g_str_has_prefix(t, "Vous") || g_str_has_prefix(t, "Assistant")))
-                    {
-                        g_string_append_printf(out, "## %s\n\n", t);
-                    }
-                    else if (is_first && g_str_has_prefix(t, "["))
-                    {
-                        /* Info message */
-                        g_string_append_printf(out, "*%s*\n\n", t);
-                    }
-                    else
-                    {
-                        g_string_append_printf(out, "%s\n\n", t);
-                    }
-                    is_first = FALSE;
-                }
-            }
-            else if (GTK_IS_BOX(k->data))
-            {
-                GList *bb = gtk_container_get_children(GTK_CONTAINER(k->data));
-                if (bb && bb->next && GTK_SOURCE_IS_VIEW(bb->next->data))
-                {
-                    GtkTextBuffer *tb = gtk_text_view_get_buffer(GTK_TEXT_VIEW(bb->next->data));
-                    GtkTextIter a, z;
-                    gtk_text_buffer_get_bounds(tb, &a, &z);
-                    gchar *ct = gtk_text_buffer_get_text(tb, &a, &z, FALSE);
-                    const gchar *lang_hint = "";
-
-                    if (GTK_SOURCE_IS_BUFFER(tb))
-                    {
-                        GtkSourceLanguage *sl = gtk_source_buffer_get_language(GTK_SOURCE_BUFFER(tb));
-                        if (sl)
-                        {
-                            const gchar *id = gtk_source_language_get_id(sl);
-                            if (id && *id) lang_hint = id;
-                        }
-                    }
-
-                    if (lang_hint && *lang_hint)
-                        g_string_append_printf(out, "```%s\n", lang_hint);
-                    else
-                        g_string_append(out, "```\n");
-                    g_string_append(out, ct);
-                    if (ct[strlen(ct)-1] != '\n')
-                        g_string_append(out, "\n");
-                    g_string_append(out, "```\n\n");
-                    g_free(ct);
-                }
-                if (bb) g_list_free(bb);
-            }
-        }
-        if (kids) g_list_free(kids);
-        g_string_append(out, "---\n\n");
+        const ChatMessage *m = history_transcript_nth(h, i);
+        const gchar *who = message_speaker(m);
+        if (!who)
+            continue;
+        /* Raw Markdown, code fences and their language included */
+        g_string_append_printf(out, "## %s\n\n%s", who, m->content);
+        if (!g_str_has_suffix(m->content, "\n"))
+            g_string_append_c(out, '\n');
+        g_string_append(out, "\n---\n\n");
     }
-    if (rows) g_list_free(rows);
 
     return g_string_free(out, FALSE);
 }
@@ -583,7 +1263,7 @@ static void on_toggle_dark(GtkToggleButton *tb, gpointer user_data)
     prefs.dark_theme = gtk_toggle_button_get_active(tb);
     prefs_save();
     apply_theme_css();
-    update_code_schemes_in_widget(ui.msg_list);
+    update_code_schemes_in_widget(ui.notebook);
 }
 
 static void on_toggle_links(GtkToggleButton *tb, gpointer user_data)
@@ -832,7 +1512,7 @@ static void on_context_clicked(GtkButton *b, gpointer u)
 
         g_free(txt);
         prefs_save();
-        history_init();
+        history_reset(ui_current_session()->history);
         ui_add_info_row("[Contexte système mis à jour]");
     }
 
@@ -842,6 +1522,25 @@ static void on_context_clicked(GtkButton *b, gpointer u)
 
 /* --- Network settings dialog --------------------------------------------- */
 
+static void cache_button_update(GtkWidget *btn)
+{
+    guint n = 0;
+    gint64 bytes = respcache_usage(&n);
+    gchar *size = g_format_size((guint64)bytes);
+    gchar *text = g_strdup_printf("Vider (%u réponse(s), %s)", n, size);
+    gtk_button_set_label(GTK_BUTTON(btn), text);
+    gtk_widget_set_sensitive(btn, n > 0);
+    g_free(text);
+    g_free(size);
+}
+
+static void on_cache_clear(GtkButton *b, gpointer u)
+{
+    (void)u;
+    respcache_clear();
+    cache_button_update(GTK_WIDGET(b));
+}
+
 static void on_network_clicked(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
@@ -882,14 +1581,189 @@ static void on_network_clicked(GtkButton *b, gpointer u)
     gtk_grid_attach(GTK_GRID(grid), lbl_proxy, 0, 1, 1, 1);
     gtk_grid_attach(GTK_GRID(grid), ent_proxy, 1, 1, 1, 1);
 
+    /* Local backend socket (saved with the backend preset) */
+    GtkWidget *lbl_unix = gtk_label_new("Socket Unix :");
+    gtk_widget_set_halign(lbl_unix, GTK_ALIGN_END);
+    GtkWidget *ent_unix = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(ent_unix), prefs.unix_socket ? prefs.unix_socket : "");
+    gtk_entry_set_placeholder_text(GTK_ENTRY(ent_unix), "/run/ollama.sock (vide = TCP)");
+    gtk_widget_set_tooltip_text(ent_unix,
+        "Pour un backend local : la connexion passe par ce fichier au lieu\n"
+        "de TCP (pas de proxy). L'URL de base fixe toujours le chemin et\n"
+        "l'en-tête Host. Utilisé pour le chat et la liste des modèles.");
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_unix, 0, 2, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), ent_unix, 1, 2, 1, 1);
+
+    /* Load balancing (saved with the backend preset) */
+    GtkWidget *lbl_pool = gtk_label_new("Autres URL (pool) :");
+    gtk_widget_set_halign(lbl_pool, GTK_ALIGN_END);
+    GtkWidget *ent_pool = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(ent_pool), prefs.url_pool ? prefs.url_pool : "");
+    gtk_entry_set_placeholder_text(GTK_ENTRY(ent_pool), "http://box2:11434 http://box3:11434");
+    gtk_widget_set_tooltip_text(ent_pool,
+        "Autres serveurs identiques à l'URL de base, séparés par des espaces.\n"
+        "Chaque requête va au moins chargé (requêtes en cours × délai récent\n"
+        "avant le premier octet) ; un serveur qui échoue deux fois de suite\n"
+        "est écarté puis testé à nouveau. La liste des modèles réunit celles\n"
+        "de tous les serveurs. Ignoré avec un socket Unix.");
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_pool, 0, 3, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), ent_pool, 1, 3, 1, 1);
+
+    /* Retry policy (saved with the backend preset) */
+    GtkWidget *lbl_retry = gtk_label_new("Nouvelles tentatives :");
+    gtk_widget_set_halign(lbl_retry, GTK_ALIGN_END);
+    GtkWidget *spin_retry = gtk_spin_button_new_with_range(0, 10, 1);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_retry), prefs.retry_max);
+    gtk_widget_set_tooltip_text(spin_retry,
+        "Sur HTTP 429/502/503/504, coupure ou blocage du flux.\n"
+        "Délai exponentiel avec gigue, Retry-After respecté. 0 = jamais.");
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_retry, 0, 4, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), spin_retry, 1, 4, 1, 1);
+
+    GtkWidget *lbl_stall = gtk_label_new("Flux bloqué après (s) :");
+    gtk_widget_set_halign(lbl_stall, GTK_ALIGN_END);
+    GtkWidget *spin_stall = gtk_spin_button_new_with_range(0, 600, 10);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_stall), prefs.stall_secs);
+    gtk_widget_set_tooltip_text(spin_stall,
+        "Un flux sans aucune donnée pendant ce délai est relancé.\n"
+        "0 = pas de détection.");
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_stall, 0, 5, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), spin_stall, 1, 5, 1, 1);
+
+    /* Hedging (saved with the backend preset) */
+    GtkWidget *lbl_hedge = gtk_label_new("Relance (hedging) :");
+    gtk_widget_set_halign(lbl_hedge, GTK_ALIGN_END);
+    GtkWidget *hedge_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *cmb_hedge = gtk_combo_box_text_new();
+    gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(cmb_hedge), "", "Aucune");
+    GList *names = prefs_get_backend_names();
+    for (GList *l = names; l; l = l->next)
+        gtk_combo_box_text_append(GTK_COMBO_BOX_TEXT(cmb_hedge), l->data, l->data);
+    g_list_free(names);
+    gtk_combo_box_set_active_id(GTK_COMBO_BOX(cmb_hedge),
+                                prefs.hedge_backend ? prefs.hedge_backend : "");
+    if (gtk_combo_box_get_active(GTK_COMBO_BOX(cmb_hedge)) < 0)
+        gtk_combo_box_set_active(GTK_COMBO_BOX(cmb_hedge), 0);   /* Preset gone */
+    gtk_widget_set_tooltip_text(cmb_hedge,
+        "Sans premier token dans le délai, la même requête part aussi\n"
+        "vers ce backend ; le premier qui répond l'emporte, l'autre est\n"
+        "annulé. La bulle indique quel backend a répondu.");
+    GtkWidget *lbl_hedge_ms = gtk_label_new("après (ms) :");
+    GtkWidget *spin_hedge = gtk_spin_button_new_with_range(0, 60000, 250);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_hedge), prefs.hedge_ms);
+    gtk_widget_set_tooltip_text(spin_hedge,
+        "0 = appris : 95e centile des derniers délais avant le premier\n"
+        "token du modèle (4 s tant qu'il y a moins de 5 mesures).");
+    gtk_box_pack_start(GTK_BOX(hedge_box), cmb_hedge, TRUE, TRUE, 0);
+    gtk_box_pack_start(GTK_BOX(hedge_box), lbl_hedge_ms, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hedge_box), spin_hedge, FALSE, FALSE, 0);
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_hedge, 0, 6, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), hedge_box, 1, 6, 1, 1);
+
+    /* Request compression (saved with the backend preset) */
+    GtkWidget *chk_gzip = gtk_check_button_new_with_label("Compresser les requêtes (gzip)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(chk_gzip), prefs.gzip_request);
+    gtk_widget_set_tooltip_text(chk_gzip,
+        "Envoie le corps avec Content-Encoding: gzip.\n"
+        "À n'activer que si le backend ou la passerelle l'accepte.");
+
+    gtk_grid_attach(GTK_GRID(grid), chk_gzip, 1, 7, 1, 1);
+
+    GtkWidget *chk_warm = gtk_check_button_new_with_label("Préchauffer la connexion pendant la saisie");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(chk_warm), prefs.prewarm);
+    gtk_widget_set_tooltip_text(chk_warm,
+        "Ouvre la connexion (DNS, TLS) dès que la zone de saisie a le focus,\n"
+        "pour réduire le délai avant le premier token.");
+
+    gtk_grid_attach(GTK_GRID(grid), chk_warm, 1, 8, 1, 1);
+
+    /* Response cache */
+    GtkWidget *chk_cache = gtk_check_button_new_with_label("Cache des réponses");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(chk_cache), prefs.cache_enabled);
+    gtk_widget_set_tooltip_text(chk_cache,
+        "Une requête identique (backend, modèle, messages) à température 0\n"
+        "est servie depuis le disque ; une requête identique à une requête\n"
+        "déjà en cours partage son flux.");
+
+    gtk_grid_attach(GTK_GRID(grid), chk_cache, 1, 9, 1, 1);
+
+    GtkWidget *lbl_cache = gtk_label_new("Taille du cache (Mo) :");
+    gtk_widget_set_halign(lbl_cache, GTK_ALIGN_END);
+    GtkWidget *cache_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *spin_cache = gtk_spin_button_new_with_range(1, 4096, 16);
+    gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_cache), prefs.cache_max_mb);
+    gtk_widget_set_tooltip_text(spin_cache,
+        "Au-delà, les réponses les moins récemment utilisées sont effacées.");
+    GtkWidget *btn_cache = gtk_button_new();
+    cache_button_update(btn_cache);
+    g_signal_connect(btn_cache, "clicked", G_CALLBACK(on_cache_clear), NULL);
+    gtk_box_pack_start(GTK_BOX(cache_box), spin_cache, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(cache_box), btn_cache, FALSE, FALSE, 0);
+
+    gtk_grid_attach(GTK_GRID(grid), lbl_cache, 0, 10, 1, 1);
+    gtk_grid_attach(GTK_GRID(grid), cache_box, 1, 10, 1, 1);
+
+    /* Raw response recording, for "Rejouer une capture…" in Stats… */
+    GtkWidget *chk_capture = gtk_check_button_new_with_label("Enregistrer les réponses brutes (diagnostic)");
+    gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(chk_capture), prefs.capture_enabled);
+    gchar *cap_dir = capture_dir();
+    gchar *cap_tip = g_strdup_printf(
+        "Chaque réponse est enregistrée octet pour octet, avec l'heure\n"
+        "d'arrivée de chaque paquet, dans %s\n"
+        "(les %d dernières), pour être rejouée depuis Stats….",
+        cap_dir, CAPTURE_KEEP);
+    gtk_widget_set_tooltip_text(chk_capture, cap_tip);
+    g_free(cap_tip);
+    g_free(cap_dir);
+
+    gtk_grid_attach(GTK_GRID(grid), chk_capture, 1, 11, 1, 1);
+
     /* Info */
     GtkWidget *info = gtk_label_new("Le proxy supporte HTTP/HTTPS/SOCKS5.");
     gtk_label_set_xalign(GTK_LABEL(info), 0.0);
     gtk_widget_set_margin_top(info, 8);
     gtk_style_context_add_class(gtk_widget_get_style_context(info), "dim-label");
 
+    /* Bytes on the wire so far */
+    gchar *wire = stats_format_wire();
+    GtkWidget *lbl_wire = gtk_label_new(wire);
+    g_free(wire);
+    gtk_label_set_xalign(GTK_LABEL(lbl_wire), 0.0);
+    gtk_style_context_add_class(gtk_widget_get_style_context(lbl_wire), "dim-label");
+
+    gchar *ttfb = stats_format_ttfb();
+    GtkWidget *lbl_ttfb = gtk_label_new(ttfb);
+    g_free(ttfb);
+    gtk_label_set_xalign(GTK_LABEL(lbl_ttfb), 0.0);
+    gtk_style_context_add_class(gtk_widget_get_style_context(lbl_ttfb), "dim-label");
+
+    gchar *protos = stats_format_protocols();
+    GtkWidget *lbl_proto = gtk_label_new(protos);
+    g_free(protos);
+    gtk_label_set_xalign(GTK_LABEL(lbl_proto), 0.0);
+    gtk_style_context_add_class(gtk_widget_get_style_context(lbl_proto), "dim-label");
+
     gtk_box_pack_start(GTK_BOX(area), grid, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(area), info, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(area), lbl_wire, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(area), lbl_ttfb, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(area), lbl_proto, FALSE, FALSE, 0);
+
+    /* Members of the current backend's pool, if it has one */
+    gchar *pool = endpoints_format(prefs.base_url, prefs.url_pool);
+    if (pool)
+    {
+        GtkWidget *lbl_pool_state = gtk_label_new(pool);
+        gtk_label_set_xalign(GTK_LABEL(lbl_pool_state), 0.0);
+        gtk_style_context_add_class(gtk_widget_get_style_context(lbl_pool_state), "dim-label");
+        gtk_box_pack_start(GTK_BOX(area), lbl_pool_state, FALSE, FALSE, 0);
+        g_free(pool);
+    }
 
     gtk_widget_show_all(dlg);
 
@@ -898,6 +1772,20 @@ static void on_network_clicked(GtkButton *b, gpointer u)
         prefs.timeout = (gint) gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_timeout));
         g_free(prefs.proxy);
         prefs.proxy = g_strdup(gtk_entry_get_text(GTK_ENTRY(ent_proxy)));
+        g_free(prefs.unix_socket);
+        prefs.unix_socket = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(ent_unix))));
+        g_free(prefs.url_pool);
+        prefs.url_pool = g_strstrip(g_strdup(gtk_entry_get_text(GTK_ENTRY(ent_pool))));
+        prefs.gzip_request = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk_gzip));
+        prefs.prewarm = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk_warm));
+        prefs.retry_max = (gint) gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_retry));
+        prefs.stall_secs = (gint) gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_stall));
+        g_free(prefs.hedge_backend);
+        prefs.hedge_backend = g_strdup(gtk_combo_box_get_active_id(GTK_COMBO_BOX(cmb_hedge)));
+        prefs.hedge_ms = (gint) gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_hedge));
+        prefs.cache_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk_cache));
+        prefs.cache_max_mb = (gint) gtk_spin_button_get_value(GTK_SPIN_BUTTON(spin_cache));
+        prefs.capture_enabled = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(chk_capture));
         prefs_save();
         ui_add_info_row("[Paramètres réseau mis à jour]");
     }
@@ -905,6 +1793,234 @@ static void on_network_clicked(GtkButton *b, gpointer u)
     gtk_widget_destroy(dlg);
 }
 
+/* --- Statistics dialog -------------------------------------------------- */
+
+#define RESPONSE_EXPORT 1
+#define RESPONSE_REPLAY 2
+
+static ChatSession* session_new(void);
+
+static GtkWidget* stats_cell(const gchar *text, gboolean header)
+{
+    GtkWidget *lbl = gtk_label_new(NULL);
+    if (header)
+    {
+        gchar *markup = g_markup_printf_escaped("<b>%s</b>", text);
+        gtk_label_set_markup(GTK_LABEL(lbl), markup);
+        g_free(markup);
+    }
+    else
+        gtk_label_set_text(GTK_LABEL(lbl), text);
+    gtk_label_set_xalign(GTK_LABEL(lbl), header ? 0.0 : 1.0);
+    return lbl;
+}
+
+static gchar* stats_ms(gint64 us)
+{
+    return us < 0 ? g_strdup("–") : g_strdup_printf("%.0f ms", us / 1000.0);
+}
+
+static void export_stats_csv(GtkWidget *parent)
+{
+    GtkWidget *dlg = gtk_file_chooser_dialog_new(
+        "Exporter les statistiques",
+        GTK_WINDOW(parent),
+        GTK_FILE_CHOOSER_ACTION_SAVE,
+        "Annuler", GTK_RESPONSE_CANCEL,
+        "Enregistrer", GTK_RESPONSE_ACCEPT,
+        NULL);
+
+    gtk_file_chooser_set_do_overwrite_confirmation(GTK_FILE_CHOOSER(dlg), TRUE);
+    gtk_file_chooser_set_current_name(GTK_FILE_CHOOSER(dlg), "ai_chat_stats.csv");
+
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT)
+    {
+        gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+        GError *err = NULL;
+        gchar *msg;
+
+        if (stats_export_csv(filename, &err))
+            msg = g_strdup_printf("[Statistiques exportées: %s]", filename);
+        else
+        {
+            msg = g_strdup_printf("[Erreur export: %s]", err->message);
+            g_error_free(err);
+        }
+        ui_add_info_row(msg);
+        g_free(msg);
+        g_free(filename);
+    }
+
+    gtk_widget_destroy(dlg);
+}
+
+/* Play @path back in a new tab at @speed times its pace (0: no waiting) */
+static void replay_capture(const gchar *path, gdouble speed)
+{
+    GError *err = NULL;
+    CaptureFile *cap = capture_load(path, &err);
+    if (!cap)
+    {
+        gchar *msg = g_strdup_printf("[Erreur rejeu: %s]", err->message);
+        ui_add_info_row(msg);
+        g_free(msg);
+        g_error_free(err);
+        return;
+    }
+
+    ChatSession *s = session_new();
+    gtk_label_set_text(GTK_LABEL(s->tab_label), "Rejeu");
+    gchar *name = g_path_get_basename(path);
+    gchar *info = speed > 0
+        ? g_strdup_printf("[Rejeu de %s — %s, ×%g]", name, cap->model, speed)
+        : g_strdup_printf("[Rejeu de %s — %s, sans attente]", name, cap->model);
+    session_add_info_row(s, info);
+    g_free(info);
+    g_free(name);
+
+    Req *req = g_new0(Req, 1);
+    req->mode      = cap->mode;
+    req->model     = g_strdup_printf("%s (rejeu)", cap->model);
+    req->streaming = cap->streaming;
+    req->accum     = g_string_new(NULL);
+    req->history   = s->history;
+    req->session   = s;
+    g_atomic_int_set(&req->cancel, 0);
+
+    ui_add_assistant_stream_row(s, req);
+    network_replay(req, cap, speed);
+}
+
+/* TRUE if a replay was started */
+static gboolean choose_capture(GtkWidget *parent)
+{
+    static const gdouble speeds[] = { 1, 4, 16, 0 };
+    GtkWidget *dlg = gtk_file_chooser_dialog_new(
+        "Rejouer une capture",
+        GTK_WINDOW(parent),
+        GTK_FILE_CHOOSER_ACTION_OPEN,
+        "Annuler", GTK_RESPONSE_CANCEL,
+        "Rejouer", GTK_RESPONSE_ACCEPT,
+        NULL);
+
+    gchar *dir = capture_dir();
+    gtk_file_chooser_set_current_folder(GTK_FILE_CHOOSER(dlg), dir);
+    g_free(dir);
+    GtkFileFilter *filter = gtk_file_filter_new();
+    gtk_file_filter_set_name(filter, "Captures (*.aicap)");
+    gtk_file_filter_add_pattern(filter, "*.aicap");
+    gtk_file_chooser_add_filter(GTK_FILE_CHOOSER(dlg), filter);
+
+    GtkWidget *box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+    GtkWidget *cmb_speed = gtk_combo_box_text_new();
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cmb_speed), "×1 (temps réel)");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cmb_speed), "×4");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cmb_speed), "×16");
+    gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(cmb_speed), "Sans attente");
+    gtk_combo_box_set_active(GTK_COMBO_BOX(cmb_speed), 0);
+    gtk_box_pack_start(GTK_BOX(box), gtk_label_new("Vitesse :"), FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(box), cmb_speed, FALSE, FALSE, 0);
+    gtk_widget_show_all(box);
+    gtk_file_chooser_set_extra_widget(GTK_FILE_CHOOSER(dlg), box);
+
+    gboolean started = FALSE;
+    if (gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_ACCEPT)
+    {
+        gchar *filename = gtk_file_chooser_get_filename(GTK_FILE_CHOOSER(dlg));
+        gint i = gtk_combo_box_get_active(GTK_COMBO_BOX(cmb_speed));
+        replay_capture(filename, speeds[CLAMP(i, 0, 3)]);
+        g_free(filename);
+        started = TRUE;
+    }
+
+    gtk_widget_destroy(dlg);
+    return started;
+}
+
+static void on_stats_clicked(GtkButton *b, gpointer u)
+{
+    (void)b; (void)u;
+
+    GtkWidget *dlg = gtk_dialog_new_with_buttons("Statistiques par modèle",
+                        GTK_WINDOW(gtk_widget_get_toplevel(ui.root_box)),
+                        GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+                        "Rejouer une capture…", RESPONSE_REPLAY,
+                        "Exporter CSV…", RESPONSE_EXPORT,
+                        "Fermer", GTK_RESPONSE_CLOSE,
+                        NULL);
+
+    GtkWidget *area = gtk_dialog_get_content_area(GTK_DIALOG(dlg));
+    gtk_container_set_border_width(GTK_CONTAINER(area), 12);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 16);
+
+    static const gchar *heads[] = {
+        "Modèle", "Req.", "1er octet", "1er token", "Total",
+        "tok/s", "Écart p50", "Écart p99"
+    };
+    for (guint c = 0; c < G_N_ELEMENTS(heads); c++)
+        gtk_grid_attach(GTK_GRID(grid), stats_cell(heads[c], TRUE), c, 0, 1, 1);
+
+    GList *list = stats_model_summaries();
+    gint row = 1;
+    for (GList *l = list; l; l = l->next, row++)
+    {
+        ModelSummary *m = (ModelSummary *)l->data;
+        gchar *cells[8];
+        cells[0] = g_strdup(m->model);
+        cells[1] = g_strdup_printf("%u", m->count);
+        cells[2] = stats_ms(m->ttfb_p50);
+        cells[3] = stats_ms(m->first_token_p50);
+        cells[4] = stats_ms(m->total_p50);
+        cells[5] = g_strdup_printf("%.1f", m->tokens_per_s);
+        cells[6] = stats_ms(m->gap_p50);
+        cells[7] = stats_ms(m->gap_p99);
+        for (gint c = 0; c < 8; c++)
+        {
+            GtkWidget *cell = stats_cell(cells[c], FALSE);
+            if (c == 0) gtk_label_set_xalign(GTK_LABEL(cell), 0.0);
+            gtk_grid_attach(GTK_GRID(grid), cell, c, row, 1, 1);
+            g_free(cells[c]);
+        }
+    }
+    stats_model_summaries_free(list);
+
+    GtkWidget *info = gtk_label_new(row == 1
+        ? "Aucune requête terminée pour l'instant."
+        : "Médianes sur les 200 dernières requêtes de chaque modèle ; tok/s en moyenne.");
+    gtk_label_set_xalign(GTK_LABEL(info), 0.0);
+    gtk_widget_set_margin_top(info, 8);
+    gtk_style_context_add_class(gtk_widget_get_style_context(info), "dim-label");
+
+    gtk_box_pack_start(GTK_BOX(area), grid, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(area), info, FALSE, FALSE, 0);
+
+    gchar *stop = stats_format_stop();
+    if (stop)
+    {
+        GtkWidget *lbl_stop = gtk_label_new(stop);
+        gtk_label_set_xalign(GTK_LABEL(lbl_stop), 0.0);
+        gtk_style_context_add_class(gtk_widget_get_style_context(lbl_stop), "dim-label");
+        gtk_box_pack_start(GTK_BOX(area), lbl_stop, FALSE, FALSE, 0);
+        g_free(stop);
+    }
+    gtk_widget_show_all(dlg);
+
+    gint resp;
+    while ((resp = gtk_dialog_run(GTK_DIALOG(dlg))) == RESPONSE_EXPORT ||
+           resp == RESPONSE_REPLAY)
+    {
+        if (resp == RESPONSE_EXPORT)
+            export_stats_csv(dlg);
+        else if (choose_capture(dlg))
+            break;   /* Let the replay be watched */
+    }
+
+    gtk_widget_destroy(dlg);
+}
+
 /* --- Backends dialog ----------------------------------------------------- */
 
 typedef struct {
@@ -999,7 +2115,7 @@ static void on_backend_load(GtkButton *btn, gpointer user_data)
     prefs_apply_backend(data->editing_backend);
     prefs_save();
     sync_ui_to_prefs();
-    history_init();
+    history_reset(ui_current_session()->history);
     ui_add_info_row("[Backend chargé, historique réinitialisé]");
 }
 
@@ -1084,7 +2200,7 @@ static void on_backends_clicked(GtkButton *b, gpointer u)
     /* Info */
     GtkWidget *info = gtk_label_new(
         "Sauvegardez et chargez des configurations complètes\n"
-        "(API, URL, modèle, température, clé).");
+        "(API, URL, modèle, température, clé, réseau).");
     gtk_label_set_xalign(GTK_LABEL(info), 0.0);
     gtk_widget_set_margin_bottom(info, 12);
 
@@ -1166,20 +2282,38 @@ static void on_emoji_click(GtkButton *b, gpointer u)
 
 /* --- Input key handler --------------------------------------------------- */
 
+/* Open the backend connection while the prompt is being typed */
+static void prewarm_backend(void)
+{
+    if (prefs.prewarm)
+        network_prewarm(gtk_entry_get_text(GTK_ENTRY(ui.ent_url)),
+                        prefs.unix_socket);
+}
+
+static gboolean on_input_focus_in(GtkWidget *w, GdkEventFocus *e, gpointer u)
+{
+    (void)w; (void)e; (void)u;
+    prewarm_backend();
+    return FALSE;
+}
+
 static gboolean on_input_key(GtkWidget *w, GdkEventKey *e, gpointer u)
 {
     (void)w; (void)u;
 
-    /* Enter (without Shift) = send */
+    /* First keystroke of a new prompt */
+    if (gtk_text_buffer_get_char_count(ui.input_buf) == 0)
+        prewarm_backend();
+
+    /* Enter (without Shift) = send, or queue while busy */
     if (e->keyval == GDK_KEY_Return && !(e->state & GDK_SHIFT_MASK))
     {
-        if (!ui.busy)
-            g_signal_emit_by_name(ui.btn_send, "clicked");
+        g_signal_emit_by_name(ui.btn_send, "clicked");
         return TRUE;
     }
 
     /* Escape = stop (when busy) */
-    if (e->keyval == GDK_KEY_Escape && ui.busy)
+    if (e->keyval == GDK_KEY_Escape && ui_current_session()->busy)
     {
         g_signal_emit_by_name(ui.btn_stop, "clicked");
         return TRUE;
@@ -1213,7 +2347,25 @@ static GtkWidget *make_labeled_entry(const gchar *label, GtkWidget **entry_out)
 
 /* --- Models list refresh ------------------------------------------------- */
 
-static void on_models_fetched(GList *models, gpointer user_data)
+/* Size, quantization and context length of the chosen model */
+static void update_model_tooltip(void)
+{
+    ApiMode mode = (ApiMode) gtk_combo_box_get_active(GTK_COMBO_BOX(ui.cmb_api));
+    GtkWidget *entry = gtk_bin_get_child(GTK_BIN(ui.cmb_model));
+    const ModelInfo *m = models_lookup(mode, gtk_entry_get_text(GTK_ENTRY(ui.ent_url)),
+                                       gtk_entry_get_text(GTK_ENTRY(entry)));
+    gchar *desc = models_describe(m);
+    gtk_widget_set_tooltip_text(ui.cmb_model, desc);
+    g_free(desc);
+}
+
+static void on_model_changed(GtkComboBox *combo, gpointer u)
+{
+    (void)combo; (void)u;
+    update_model_tooltip();
+}
+
+static void on_models_fetched(const GPtrArray *models, gpointer user_data)
 {
     (void)user_data;
 
@@ -1228,10 +2380,10 @@ static void on_models_fetched(GList *models, gpointer user_data)
     gtk_combo_box_text_remove_all(GTK_COMBO_BOX_TEXT(ui.cmb_model));
 
     /* Add fetched models */
-    for (GList *l = models; l != NULL; l = l->next)
+    for (guint i = 0; i < models->len; i++)
     {
-        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ui.cmb_model),
-                                       (const gchar *)l->data);
+        const ModelInfo *m = g_ptr_array_index(models, i);
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(ui.cmb_model), m->name);
     }
 
     /* Restore current text (or set first model if empty) */
@@ -1239,37 +2391,137 @@ static void on_models_fetched(GList *models, gpointer user_data)
     {
         gtk_entry_set_text(GTK_ENTRY(entry), saved);
     }
-    else if (models)
+    else if (models->len > 0)
     {
-        gtk_entry_set_text(GTK_ENTRY(entry), (const gchar *)models->data);
+        const ModelInfo *m = g_ptr_array_index(models, 0);
+        gtk_entry_set_text(GTK_ENTRY(entry), m->name);
     }
 
     g_free(saved);
-    g_list_free_full(models, g_free);
+    update_model_tooltip();
 }
 
-static void refresh_models_list(void)
+/* @force: ask the backend even if the cached list is recent */
+static void refresh_models_list(gboolean force)
 {
     ApiMode mode = (ApiMode) gtk_combo_box_get_active(GTK_COMBO_BOX(ui.cmb_api));
     const gchar *base = gtk_entry_get_text(GTK_ENTRY(ui.ent_url));
     const gchar *key = gtk_entry_get_text(GTK_ENTRY(ui.ent_key));
 
-    models_fetch_async(mode, base, key, on_models_fetched, NULL);
+    models_fetch_async(mode, base, key, prefs.unix_socket, prefs.url_pool, force,
+                       on_models_fetched, NULL);
 }
 
 static void on_refresh_clicked(GtkButton *b, gpointer u)
 {
     (void)b; (void)u;
-    refresh_models_list();
+    refresh_models_list(TRUE);
 }
 
 static void on_api_changed(GtkComboBox *combo, gpointer u)
 {
     (void)combo; (void)u;
     /* Reset history and refresh models list when API changes */
-    history_init();
+    history_reset(ui_current_session()->history);
     ui_add_info_row("[Historique réinitialisé]");
-    refresh_models_list();
+    refresh_models_list(FALSE);
+}
+
+/* --- Chat sessions ------------------------------------------------------- */
+
+ChatSession* ui_current_session(void)
+{
+    if (!ui.notebook) return NULL;
+    gint n = gtk_notebook_get_current_page(GTK_NOTEBOOK(ui.notebook));
+    if (n < 0) return NULL;
+    GtkWidget *page = gtk_notebook_get_nth_page(GTK_NOTEBOOK(ui.notebook), n);
+    return page ? (ChatSession *)g_object_get_data(G_OBJECT(page), "session") : NULL;
+}
+
+static void on_session_destroy(GtkWidget *page, gpointer user_data)
+{
+    (void)page;
+    ChatSession *s = (ChatSession *)user_data;
+    queue_clear(s, FALSE);
+    g_queue_free(s->queue);
+    history_free(s->history);
+    g_free(s);
+}
+
+static void on_tab_stop(GtkButton *b, gpointer user_data)
+{
+    (void)b;
+    session_stop((ChatSession *)user_data);
+}
+
+static void on_tab_close(GtkButton *b, gpointer user_data)
+{
+    (void)b;
+    ChatSession *s = (ChatSession *)user_data;
+    if (s->busy) return;
+    gtk_widget_destroy(s->page);
+    /* Always keep one conversation open */
+    if (gtk_notebook_get_n_pages(GTK_NOTEBOOK(ui.notebook)) == 0)
+        session_new();
+}
+
+static void on_new_tab(GtkButton *b, gpointer u)
+{
+    (void)b; (void)u;
+    session_new();
+}
+
+static void on_switch_page(GtkNotebook *nb, GtkWidget *page, guint num, gpointer u)
+{
+    (void)nb; (void)num; (void)u;
+    sync_buttons_to_session((ChatSession *)g_object_get_data(G_OBJECT(page), "session"));
+}
+
+static GtkWidget* make_tab_button(const gchar *label, const gchar *tooltip)
+{
+    GtkWidget *btn = gtk_button_new_with_label(label);
+    gtk_button_set_relief(GTK_BUTTON(btn), GTK_RELIEF_NONE);
+    gtk_widget_set_tooltip_text(btn, tooltip);
+    return btn;
+}
+
+static ChatSession* session_new(void)
+{
+    ChatSession *s = g_new0(ChatSession, 1);
+    s->history = history_new();
+    s->queue = g_queue_new();
+
+    s->scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(s->scroll),
+                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    s->msg_list = gtk_list_box_new();
+    gtk_container_add(GTK_CONTAINER(s->scroll), s->msg_list);
+    s->page = s->scroll;
+    g_object_set_data(G_OBJECT(s->page), "session", s);
+    g_signal_connect(s->page, "destroy", G_CALLBACK(on_session_destroy), s);
+
+    GtkWidget *tab = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 2);
+    gchar *title = g_strdup_printf("Chat %d", ++ui.session_seq);
+    s->tab_label = gtk_label_new(title);
+    g_free(title);
+    s->tab_spinner = gtk_spinner_new();
+    gtk_widget_set_no_show_all(s->tab_spinner, TRUE);
+    s->tab_stop  = make_tab_button("■", "Arrêter cette conversation");
+    s->tab_close = make_tab_button("×", "Fermer l'onglet");
+    g_signal_connect(s->tab_stop,  "clicked", G_CALLBACK(on_tab_stop), s);
+    g_signal_connect(s->tab_close, "clicked", G_CALLBACK(on_tab_close), s);
+    gtk_box_pack_start(GTK_BOX(tab), s->tab_label,   FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(tab), s->tab_spinner, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(tab), s->tab_stop,    FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(tab), s->tab_close,   FALSE, FALSE, 0);
+    gtk_widget_show_all(tab);
+
+    gtk_widget_show_all(s->page);
+    gint n = gtk_notebook_append_page(GTK_NOTEBOOK(ui.notebook), s->page, tab);
+    gtk_notebook_set_tab_reorderable(GTK_NOTEBOOK(ui.notebook), s->page, TRUE);
+    session_set_busy(s, FALSE);
+    gtk_notebook_set_current_page(GTK_NOTEBOOK(ui.notebook), n);
+    return s;
 }
 
 /* --- Build UI ------------------------------------------------------------ */
@@ -1279,7 +2531,8 @@ void ui_build(GeanyPlugin *plugin)
     g_plugin = plugin;
 
     /* Register network callbacks */
-    network_set_callbacks(ui_stream_append, ui_replace_row, ui_set_busy);
+    network_set_callbacks(ui_stream_append, ui_replace_row, ui_set_busy, ui_row_status,
+                          ui_restart_row);
 
     GtkWidget *nb = plugin->geany_data->main_widgets->message_window_notebook;
 
@@ -1338,6 +2591,9 @@ void ui_build(GeanyPlugin *plugin)
     g_signal_connect(ui.btn_network, "clicked", G_CALLBACK(on_network_clicked), NULL);
     ui.btn_backends = gtk_button_new_with_label("Backends…");
     g_signal_connect(ui.btn_backends, "clicked", G_CALLBACK(on_backends_clicked), NULL);
+    ui.btn_stats = gtk_button_new_with_label("Stats…");
+    gtk_widget_set_tooltip_text(ui.btn_stats, "Latence et débit par modèle");
+    g_signal_connect(ui.btn_stats, "clicked", G_CALLBACK(on_stats_clicked), NULL);
 
     GtkWidget *key_box = make_labeled_entry("Clé", &ui.ent_key);
     gtk_entry_set_text(GTK_ENTRY(ui.ent_key), prefs.api_key);
@@ -1352,14 +2608,17 @@ void ui_build(GeanyPlugin *plugin)
     gtk_box_pack_start(GTK_BOX(opts), ui.btn_ctx, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(opts), ui.btn_network, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(opts), ui.btn_backends, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(opts), ui.btn_stats, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(opts), key_box, TRUE, TRUE, 0);
 
-    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
-    ui.scroll = scroll;
-    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll),
-                                   GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-    ui.msg_list = gtk_list_box_new();
-    gtk_container_add(GTK_CONTAINER(scroll), ui.msg_list);
+    ui.notebook = gtk_notebook_new();
+    gtk_notebook_set_scrollable(GTK_NOTEBOOK(ui.notebook), TRUE);
+    ui.btn_new_tab = gtk_button_new_with_label("+");
+    gtk_button_set_relief(GTK_BUTTON(ui.btn_new_tab), GTK_RELIEF_NONE);
+    gtk_widget_set_tooltip_text(ui.btn_new_tab, "Nouvelle conversation");
+    g_signal_connect(ui.btn_new_tab, "clicked", G_CALLBACK(on_new_tab), NULL);
+    gtk_widget_show(ui.btn_new_tab);
+    gtk_notebook_set_action_widget(GTK_NOTEBOOK(ui.notebook), ui.btn_new_tab, GTK_PACK_END);
 
     GtkWidget *input_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     ui.btn_emoji = gtk_button_new_with_label("🙂");
@@ -1373,6 +2632,7 @@ void ui_build(GeanyPlugin *plugin)
     gtk_text_view_set_wrap_mode(GTK_TEXT_VIEW(ui.input_view), GTK_WRAP_WORD_CHAR);
     ui.input_buf = gtk_text_view_get_buffer(GTK_TEXT_VIEW(ui.input_view));
     g_signal_connect(ui.input_view, "key-press-event", G_CALLBACK(on_input_key), NULL);
+    g_signal_connect(ui.input_view, "focus-in-event", G_CALLBACK(on_input_focus_in), NULL);
     gtk_container_add(GTK_CONTAINER(input_scroll), ui.input_view);
 
     gtk_box_pack_start(GTK_BOX(input_row), ui.btn_emoji, FALSE, FALSE, 0);
@@ -1381,6 +2641,9 @@ void ui_build(GeanyPlugin *plugin)
     GtkWidget *btns = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
     ui.btn_send      = gtk_button_new_with_label("Envoyer (Entrée)");
     ui.btn_send_sel  = gtk_button_new_with_label("Envoyer sélection");
+    ui.btn_compare   = gtk_button_new_with_label("Comparer…");
+    gtk_widget_set_tooltip_text(ui.btn_compare,
+        "Envoyer la question à plusieurs backends et comparer les réponses");
     ui.btn_stop      = gtk_button_new_with_label("Stop");
     ui.btn_clear     = gtk_button_new_with_label("Effacer");
     ui.btn_reset     = gtk_button_new_with_label("Réinit. histo");
@@ -1389,6 +2652,7 @@ void ui_build(GeanyPlugin *plugin)
 
     g_signal_connect(ui.btn_send,     "clicked", G_CALLBACK(on_send), NULL);
     g_signal_connect(ui.btn_send_sel, "clicked", G_CALLBACK(on_send_selection), NULL);
+    g_signal_connect(ui.btn_compare,  "clicked", G_CALLBACK(on_compare), NULL);
     g_signal_connect(ui.btn_stop,     "clicked", G_CALLBACK(on_stop), NULL);
     g_signal_connect(ui.btn_clear,    "clicked", G_CALLBACK(on_clear), NULL);
     g_signal_connect(ui.btn_reset,    "clicked", G_CALLBACK(on_reset), NULL);
@@ -1397,9 +2661,11 @@ void ui_build(GeanyPlugin *plugin)
 
     g_signal_connect(ui.cmb_api, "changed", G_CALLBACK(on_api_changed), NULL);
     g_signal_connect(ui.cmb_model, "changed", G_CALLBACK(on_reset), NULL);
+    g_signal_connect(ui.cmb_model, "changed", G_CALLBACK(on_model_changed), NULL);
 
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_send,     FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_send_sel, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(btns), ui.btn_compare,  FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_stop,     FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_clear,    FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_reset,    FALSE, FALSE, 0);
@@ -1407,15 +2673,26 @@ void ui_build(GeanyPlugin *plugin)
     gtk_box_pack_start(GTK_BOX(btns), ui.btn_export,   FALSE, FALSE, 0);
 
     gtk_box_pack_start(GTK_BOX(ui.root_box), opts,   FALSE, FALSE, 0);
-    gtk_box_pack_start(GTK_BOX(ui.root_box), scroll, TRUE,  TRUE,  0);
+    gtk_box_pack_start(GTK_BOX(ui.root_box), ui.notebook, TRUE, TRUE, 0);
     gtk_box_pack_start(GTK_BOX(ui.root_box), input_row, FALSE, FALSE, 0);
     gtk_box_pack_start(GTK_BOX(ui.root_box), btns,   FALSE, FALSE, 0);
 
+    session_new();
+    g_signal_connect(ui.notebook, "switch-page", G_CALLBACK(on_switch_page), NULL);
+
     gtk_notebook_append_page(GTK_NOTEBOOK(nb), ui.root_box, gtk_label_new("Chat IA"));
     gtk_widget_show_all(ui.root_box);
 
-    gtk_widget_set_sensitive(ui.btn_stop, FALSE);
+    sync_buttons_to_session(ui_current_session());
 
-    /* Load models list on startup */
-    refresh_models_list();
+    /* Models list on startup: from the cache at once, then revalidated */
+    refresh_models_list(FALSE);
+}
+
+void ui_cleanup(void)
+{
+    if (!ui.root_box) return;
+    g_signal_handlers_disconnect_by_func(ui.notebook, G_CALLBACK(on_switch_page), NULL);
+    gtk_widget_destroy(ui.root_box);
+    memset(&ui, 0, sizeof(ui));
 }
@@ -8,20 +8,46 @@
 #include <gtk/gtk.h>
 #include <geanyplugin.h>
 #include "network.h"
+#include "history.h"
+
+/* Answers of one prompt from several backends, side by side (ui.c) */
+typedef struct Fanout Fanout;
+
+/* One conversation tab: own messages, history, request and busy state */
+typedef struct ChatSession
+{
+    GtkWidget    *page;          /* Notebook page */
+    GtkWidget    *msg_list;      /* GtkListBox for message bubbles */
+    GtkWidget    *scroll;        /* Scrolled window for autoscroll */
+
+    GtkWidget    *tab_label;
+    GtkWidget    *tab_spinner;
+    GtkWidget    *tab_stop;      /* Per-tab Stop button */
+    GtkWidget    *tab_close;
+
+    ChatHistory  *history;
+    Req          *req;           /* In-flight request or NULL */
+    Fanout       *fanout;        /* Comparison in flight or NULL */
+    guint         turns;         /* Prompts sent so far */
+    gboolean      busy;
+    GQueue       *queue;         /* Prompts waiting for the answer (ui.c) */
+    gboolean      held;          /* Queue stopped until the next Envoyer */
+} ChatSession;
 
 /* UI structure holding all widgets */
 typedef struct
 {
     GtkWidget    *root_box;
 
-    GtkWidget    *msg_list;      /* GtkListBox for message bubbles */
-    GtkWidget    *scroll;        /* Scrolled window for autoscroll */
+    GtkWidget    *notebook;      /* One page per ChatSession */
+    GtkWidget    *btn_new_tab;
 
     GtkWidget    *input_view;
     GtkTextBuffer*input_buf;
 
     GtkWidget    *btn_send;
     GtkWidget    *btn_send_sel;
+    GtkWidget    *btn_compare;
     GtkWidget    *btn_stop;
     GtkWidget    *btn_clear;
     GtkWidget    *btn_reset;
@@ -41,8 +67,9 @@ typedef struct
     GtkWidget    *btn_ctx;
     GtkWidget    *btn_network;
     GtkWidget    *btn_backends;
+    GtkWidget    *btn_stats;
 
-    gboolean      busy;
+    gint          session_seq;   /* Numbering for new tab titles */
 } Ui;
 
 /* Global UI instance */
@@ -51,22 +78,29 @@ extern Ui ui;
 /* Build the complete UI and attach to Geany */
 void ui_build(GeanyPlugin *plugin);
 
+/* Destroy the chat tab and all sessions */
+void ui_cleanup(void);
+
+/* Session shown in the notebook (never NULL once the UI is built) */
+ChatSession* ui_current_session(void);
+
 /* Add a user message row */
-void ui_add_user_row(const gchar *text);
+void ui_add_user_row(ChatSession *s, const gchar *text);
 
 /* Add an assistant streaming row (returns the row, sets up req) */
-GtkWidget* ui_add_assistant_stream_row(Req *req);
+GtkWidget* ui_add_assistant_stream_row(ChatSession *s, Req *req);
 
-/* Add an info row */
+/* Add an info row to the current session */
 void ui_add_info_row(const gchar *text);
 
-/* Autoscroll message list to bottom */
-void ui_autoscroll_soon(void);
+/* Autoscroll a session's message list to bottom */
+void ui_autoscroll_soon(ChatSession *s);
 
 /* Copy text to clipboard */
 void ui_copy_text_to_clipboard(const gchar *txt);
 
-/* Send a prompt (creates request and starts network) */
+/* Send a prompt in the current session (creates request and starts network);
+ * while it is answering, the prompt is queued behind the answer */
 void ui_send_prompt(const gchar *prompt);
 
 #endif /* UI_H */
@@ -0,0 +1,986 @@
+/*
+ * mock_llm.c — Local stand-in for Ollama and OpenAI-compatible servers
+ *
+ * Answers /api/chat, /api/tags, /api/show, /v1/chat/completions and
+ * /v1/models over HTTP/1.1 (keep-alive, chunked streaming), so the
+ * plugin's network path can be exercised without a GPU box. Replies are
+ * made of tokens with quotes, backslashes, newlines, accents and emoji,
+ * or of the request body itself (--echo), at a set rate; failures are
+ * injected at will. With --seed the same request number gets the same
+ * tokens and the same injected faults.
+ *
+ * Build: make mock-server
+ * Run:   tools/mock_llm --port 11435 --rate 40 --split 7
+ *        then point the plugin at http://127.0.0.1:11435
+ *        (or --unix /tmp/mock.sock with that path as the backend socket)
+ *
+ * Plain POSIX and zlib (for gzip request bodies), no GLib: it must build
+ * on any Linux box.
+ */
+
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <getopt.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#define MAX_HEADER 65536
+#define MAX_BODY   (64 << 20)
+
+/* --- Options ------------------------------------------------------------- */
+
+typedef struct
+{
+    int      port;
+    char    *unix_path;    /* Listen on this Unix socket instead of TCP */
+    double   rate;         /* Tokens per second, 0 = no pacing */
+    int      tokens;       /* Tokens per reply */
+    int      split;        /* Write events in pieces of this many bytes */
+    int      latency_ms;   /* Before the response headers */
+    int      jitter_ms;    /* Random extra delay per token */
+    double   p429;         /* Probability of a 429 */
+    double   p500;         /* Probability of a 500 */
+    double   pdrop;        /* Probability of a mid-stream drop */
+    int      fail_first;   /* First N chat requests fail with fail_code */
+    int      fail_code;
+    int      drop_first;   /* First N chat requests are cut */
+    int      drop_after;   /* Tokens sent before a cut */
+    int      echo;         /* Reply with the request body */
+    unsigned seed;
+    char    *models;       /* Comma-separated */
+    int      verbose;
+} Options;
+
+static Options opt = {
+    .port = 11435, .rate = 50, .tokens = 200, .fail_code = 503,
+    .drop_after = -1, .seed = 1, .models = "mock-small,mock-large"
+};
+
+static unsigned long chat_count = 0;   /* Chat requests so far */
+
+/* --- Small helpers ------------------------------------------------------- */
+
+typedef struct
+{
+    char  *p;
+    size_t n, cap;
+} Buf;
+
+static void buf_add(Buf *b, const char *s, size_t n)
+{
+    if (b->n + n + 1 > b->cap)
+    {
+        b->cap = (b->n + n + 1) * 2;
+        b->p = realloc(b->p, b->cap);
+        if (!b->p)
+            abort();
+    }
+    memcpy(b->p + b->n, s, n);
+    b->n += n;
+    b->p[b->n] = 0;
+}
+
+static void buf_str(Buf *b, const char *s)
+{
+    buf_add(b, s, strlen(s));
+}
+
+static void buf_printf(Buf *b, const char *fmt, ...)
+{
+    char tmp[1024];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(tmp, sizeof tmp, fmt, ap);
+    va_end(ap);
+    buf_add(b, tmp, n < (int)sizeof tmp ? (size_t)n : sizeof tmp - 1);
+}
+
+static void buf_json(Buf *b, const char *s, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        unsigned char c = (unsigned char)s[i];
+        switch (c)
+        {
+            case '"':  buf_str(b, "\\\""); break;
+            case '\\': buf_str(b, "\\\\"); break;
+            case '\n': buf_str(b, "\\n");  break;
+            case '\r': buf_str(b, "\\r");  break;
+            case '\t': buf_str(b, "\\t");  break;
+            default:
+                if (c < 0x20)
+                    buf_printf(b, "\\u%04x", c);
+                else
+                    buf_add(b, (const char *)&c, 1);
+        }
+    }
+}
+
+static void sleep_us(long long us)
+{
+    if (us <= 0)
+        return;
+    struct timespec ts = { (time_t)(us / 1000000), (long)(us % 1000000) * 1000 };
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+        ;
+}
+
+/* splitmix64: a deterministic stream per request */
+static uint64_t rng_next(uint64_t *s)
+{
+    uint64_t z = (*s += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static double rng_unit(uint64_t *s)
+{
+    return (double)(rng_next(s) >> 11) / (double)(1ULL << 53);
+}
+
+/* --- Connection I/O ------------------------------------------------------ */
+
+typedef struct
+{
+    int    fd;
+    char  *in;        /* Received, not yet consumed */
+    size_t in_len, in_cap;
+} Conn;
+
+static int write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0)
+    {
+        ssize_t w = send(fd, p, n, MSG_NOSIGNAL);
+        if (w < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/*
+ * Send @n bytes, in --split pieces when set. With TCP_NODELAY and a pause
+ * between pieces they reach the client in separate reads, cutting JSON
+ * tokens, escapes and UTF-8 sequences anywhere.
+ */
+static int send_split(int fd, const char *p, size_t n)
+{
+    if (opt.split <= 0)
+        return write_all(fd, p, n);
+    while (n > 0)
+    {
+        size_t k = n < (size_t)opt.split ? n : (size_t)opt.split;
+        if (write_all(fd, p, k) < 0)
+            return -1;
+        p += k;
+        n -= k;
+        if (n > 0)
+            sleep_us(500);
+    }
+    return 0;
+}
+
+static int send_chunk(int fd, const char *p, size_t n)
+{
+    Buf b = { 0 };
+    buf_printf(&b, "%zx\r\n", n);
+    buf_add(&b, p, n);
+    buf_str(&b, "\r\n");
+    int rc = send_split(fd, b.p, b.n);
+    free(b.p);
+    return rc;
+}
+
+/* Read more input; -1 on EOF or error */
+static int conn_fill(Conn *c)
+{
+    if (c->in_cap - c->in_len < 4096)
+    {
+        c->in_cap = c->in_cap ? c->in_cap * 2 : 8192;
+        c->in = realloc(c->in, c->in_cap);
+        if (!c->in)
+            abort();
+    }
+    ssize_t r;
+    do
+        r = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len - 1, 0);
+    while (r < 0 && errno == EINTR);
+    if (r <= 0)
+        return -1;
+    c->in_len += (size_t)r;
+    c->in[c->in_len] = 0;
+    return 0;
+}
+
+static void conn_consume(Conn *c, size_t n)
+{
+    memmove(c->in, c->in + n, c->in_len - n);
+    c->in_len -= n;
+    c->in[c->in_len] = 0;
+}
+
+/* --- Requests ------------------------------------------------------------ */
+
+typedef struct
+{
+    char   method[16];
+    char   path[512];
+    char   if_none_match[256];
+    int    keep_alive;
+    int    gzip;
+    char  *body;
+    size_t body_len;
+} Request;
+
+static void header_value(const char *line, const char *end, char *out, size_t cap)
+{
+    const char *v = memchr(line, ':', (size_t)(end - line));
+    out[0] = 0;
+    if (!v)
+        return;
+    v++;
+    while (v < end && (*v == ' ' || *v == '\t'))
+        v++;
+    size_t n = (size_t)(end - v);
+    if (n >= cap)
+        n = cap - 1;
+    memcpy(out, v, n);
+    out[n] = 0;
+}
+
+static int gunzip(Request *rq)
+{
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    if (inflateInit2(&zs, 15 + 32) != Z_OK)
+        return -1;
+
+    Buf out = { 0 };
+    char tmp[65536];
+    int rc;
+    zs.next_in = (Bytef *)rq->body;
+    zs.avail_in = (uInt)rq->body_len;
+    do
+    {
+        zs.next_out = (Bytef *)tmp;
+        zs.avail_out = sizeof tmp;
+        rc = inflate(&zs, Z_NO_FLUSH);
+        buf_add(&out, tmp, sizeof tmp - zs.avail_out);
+    } while (rc == Z_OK && out.n < MAX_BODY);
+    inflateEnd(&zs);
+    if (rc != Z_STREAM_END)
+    {
+        free(out.p);
+        return -1;
+    }
+    free(rq->body);
+    rq->body = out.p ? out.p : calloc(1, 1);
+    rq->body_len = out.n;
+    return 0;
+}
+
+/* 0: request read; -1: connection closed or unusable */
+static int read_request(Conn *c, Request *rq)
+{
+    char *end;
+    memset(rq, 0, sizeof *rq);
+
+    while ((end = c->in ? strstr(c->in, "\r\n\r\n") : NULL) == NULL)
+    {
+        if (c->in_len > MAX_HEADER || conn_fill(c) < 0)
+            return -1;
+    }
+    size_t head_len = (size_t)(end - c->in) + 4;
+
+    const char *line = c->in;
+    const char *eol = strstr(line, "\r\n");
+    char version[16] = "";
+    if (sscanf(line, "%15s %511s %15s", rq->method, rq->path, version) != 3)
+        return -1;
+    rq->keep_alive = strcmp(version, "HTTP/1.1") == 0;
+
+    size_t content_length = 0;
+    int expect = 0;
+    char val[256];
+    for (line = eol + 2; line < end; line = eol + 2)
+    {
+        eol = strstr(line, "\r\n");
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+        {
+            header_value(line, eol, val, sizeof val);
+            content_length = strtoul(val, NULL, 10);
+        }
+        else if (strncasecmp(line, "Connection:", 11) == 0)
+        {
+            header_value(line, eol, val, sizeof val);
+            if (strcasecmp(val, "close") == 0)
+                rq->keep_alive = 0;
+            else if (strcasecmp(val, "keep-alive") == 0)
+                rq->keep_alive = 1;
+        }
+        else if (strncasecmp(line, "Expect:", 7) == 0)
+            expect = 1;
+        else if (strncasecmp(line, "Content-Encoding:", 17) == 0)
+        {
+            header_value(line, eol, val, sizeof val);
+            rq->gzip = strcasecmp(val, "gzip") == 0;
+        }
+        else if (strncasecmp(line, "If-None-Match:", 14) == 0)
+            header_value(line, eol, rq->if_none_match, sizeof rq->if_none_match);
+    }
+    conn_consume(c, head_len);
+
+    if (content_length > MAX_BODY)
+        return -1;
+    if (expect && c->in_len < content_length)
+        write_all(c->fd, "HTTP/1.1 100 Continue\r\n\r\n", 25);
+    while (c->in_len < content_length)
+        if (conn_fill(c) < 0)
+            return -1;
+
+    rq->body = malloc(content_length + 1);
+    memcpy(rq->body, c->in, content_length);
+    rq->body[content_length] = 0;
+    rq->body_len = content_length;
+    conn_consume(c, content_length);
+
+    if (rq->gzip && gunzip(rq) < 0)
+    {
+        free(rq->body);
+        return -1;
+    }
+    return 0;
+}
+
+/* String value of "key" in a JSON body (first match; enough for a mock) */
+static char* json_string(const char *body, const char *key)
+{
+    char pat[64];
+    snprintf(pat, sizeof pat, "\"%s\"", key);
+    const char *p = strstr(body, pat);
+    if (!p)
+        return NULL;
+    p += strlen(pat);
+    while (*p == ' ' || *p == ':')
+        p++;
+    if (*p != '"')
+        return NULL;
+    const char *q = ++p;
+    while (*q && *q != '"')
+        q += (*q == '\\' && q[1]) ? 2 : 1;
+    return strndup(p, (size_t)(q - p));
+}
+
+/* "stream" flag of a chat body, @def when absent */
+static int json_stream_flag(const char *body, int def)
+{
+    const char *p = strstr(body, "\"stream\"");
+    if (!p)
+        return def;
+    p += 8;
+    while (*p == ' ' || *p == ':')
+        p++;
+    return *p == 't';
+}
+
+/* --- Responses ----------------------------------------------------------- */
+
+static int respond(int fd, int status, const char *reason, const char *ctype,
+                   const char *extra, const char *body, size_t len, int keep_alive)
+{
+    Buf b = { 0 };
+    buf_printf(&b, "HTTP/1.1 %d %s\r\n", status, reason);
+    if (ctype)
+        buf_printf(&b, "Content-Type: %s\r\n", ctype);
+    if (extra)
+        buf_str(&b, extra);
+    buf_printf(&b, "Content-Length: %zu\r\n", len);
+    buf_str(&b, keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    if (body)
+        buf_add(&b, body, len);
+    int rc = write_all(fd, b.p, b.n);
+    free(b.p);
+    return rc;
+}
+
+static int respond_json(int fd, int status, const char *reason, const char *extra,
+                        const Buf *body, int keep_alive)
+{
+    return respond(fd, status, reason, "application/json", extra,
+                   body->p, body->n, keep_alive);
+}
+
+static int start_chunked(int fd, const char *ctype, int keep_alive)
+{
+    Buf b = { 0 };
+    buf_str(&b, "HTTP/1.1 200 OK\r\n");
+    buf_printf(&b, "Content-Type: %s\r\n", ctype);
+    buf_str(&b, "Transfer-Encoding: chunked\r\n");
+    buf_str(&b, keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
+    int rc = write_all(fd, b.p, b.n);
+    free(b.p);
+    return rc;
+}
+
+static int end_chunked(int fd)
+{
+    return send_split(fd, "0\r\n\r\n", 5);
+}
+
+/* --- Catalog ------------------------------------------------------------- */
+
+/* FNV-1a of the model list: the catalog's ETag */
+static unsigned long catalog_etag(void)
+{
+    unsigned long h = 2166136261UL;
+    for (const char *p = opt.models; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619UL;
+    return h & 0xffffffffUL;
+}
+
+static int serve_catalog(int fd, const Request *rq, int ollama)
+{
+    char etag[64];
+    snprintf(etag, sizeof etag, "\"mock-%08lx\"", catalog_etag());
+    char extra[128];
+    snprintf(extra, sizeof extra, "ETag: %s\r\n", etag);
+
+    if (strcmp(rq->if_none_match, etag) == 0)
+        return respond(fd, 304, "Not Modified", NULL, extra, NULL, 0, rq->keep_alive);
+
+    Buf b = { 0 };
+    buf_str(&b, ollama ? "{\"models\":[" : "{\"object\":\"list\",\"data\":[");
+    char *list = strdup(opt.models), *save = NULL;
+    int i = 0;
+    for (char *m = strtok_r(list, ",", &save); m; m = strtok_r(NULL, ",", &save), i++)
+    {
+        if (i) buf_str(&b, ",");
+        if (ollama)
+        {
+            buf_str(&b, "{\"name\":\"");
+            buf_json(&b, m, strlen(m));
+            buf_printf(&b, "\",\"size\":%lld,\"digest\":\"sha256:%064d\","
+                       "\"details\":{\"parameter_size\":\"%dB\","
+                       "\"quantization_level\":\"Q4_K_M\"}}",
+                       (long long)(i + 1) * 4200000000LL, i, (i + 1) * 7);
+        }
+        else
+        {
+            buf_str(&b, "{\"id\":\"");
+            buf_json(&b, m, strlen(m));
+            buf_printf(&b, "\",\"object\":\"model\",\"owned_by\":\"mock\","
+                       "\"context_length\":%d}", 8192 << i);
+        }
+    }
+    free(list);
+    buf_str(&b, "]}");
+    int rc = respond_json(fd, 200, "OK", extra, &b, rq->keep_alive);
+    free(b.p);
+    return rc;
+}
+
+static int serve_show(int fd, const Request *rq)
+{
+    char *model = json_string(rq->body, "model");
+    if (!model)
+        model = json_string(rq->body, "name");
+    Buf b = { 0 };
+    buf_str(&b, "{\"details\":{\"parameter_size\":\"7B\",\"quantization_level\":\"Q4_K_M\"},"
+                "\"model_info\":{\"general.architecture\":\"llama\","
+                "\"llama.context_length\":8192},\"modelfile\":\"# ");
+    if (model)
+        buf_json(&b, model, strlen(model));
+    buf_str(&b, "\"}");
+    int rc = respond_json(fd, 200, "OK", NULL, &b, rq->keep_alive);
+    free(b.p);
+    free(model);
+    return rc;
+}
+
+/* --- Chat ---------------------------------------------------------------- */
+
+static const char *const words[] = {
+    "Le", " code", " \"cité\"", " compile", ".\n", " Voici", " un", " exemple",
+    " :\n\n```c\n", "int", " main", "(void)", " {", "\n\treturn", " 0;",
+    "\n}\n```\n", " C:\\chemin", " déjà", " vu", " 😀", " — ", "naïve",
+    " été", " \\n", " fin", ".", " ", "\n"
+};
+
+typedef struct
+{
+    char  **tok;
+    int     n;
+} Tokens;
+
+/* Cut @s into pieces of about @size bytes, never inside a UTF-8 sequence */
+static void tokens_from_text(Tokens *t, const char *s, size_t len, size_t size)
+{
+    t->tok = calloc(len / size + 2, sizeof *t->tok);
+    t->n = 0;
+    size_t i = 0;
+    while (i < len)
+    {
+        size_t k = i + size < len ? i + size : len;
+        while (k < len && ((unsigned char)s[k] & 0xC0) == 0x80)
+            k++;
+        t->tok[t->n++] = strndup(s + i, k - i);
+        i = k;
+    }
+}
+
+static void tokens_make(Tokens *t, const Request *rq, uint64_t *rng)
+{
+    if (opt.echo)
+    {
+        tokens_from_text(t, rq->body, rq->body_len, 4);
+        return;
+    }
+    t->tok = calloc((size_t)opt.tokens + 1, sizeof *t->tok);
+    t->n = opt.tokens;
+    for (int i = 0; i < t->n; i++)
+        t->tok[i] = strdup(words[rng_next(rng) % (sizeof words / sizeof *words)]);
+}
+
+static void tokens_free(Tokens *t)
+{
+    for (int i = 0; i < t->n; i++)
+        free(t->tok[i]);
+    free(t->tok);
+}
+
+static void pace(uint64_t *rng)
+{
+    long long us = opt.rate > 0 ? (long long)(1e6 / opt.rate) : 0;
+    if (opt.jitter_ms > 0)
+        us += (long long)(rng_next(rng) % ((uint64_t)opt.jitter_ms * 1000 + 1));
+    sleep_us(us);
+}
+
+typedef enum { FAULT_NONE, FAULT_STATUS, FAULT_DROP } Fault;
+
+/* Decide what goes wrong with chat request number @n */
+static Fault pick_fault(unsigned long n, uint64_t *rng, int *status)
+{
+    double r = rng_unit(rng);
+    if (n < (unsigned long)opt.fail_first)
+    {
+        *status = opt.fail_code;
+        return FAULT_STATUS;
+    }
+    if (r < opt.p429)
+    {
+        *status = 429;
+        return FAULT_STATUS;
+    }
+    if (r < opt.p429 + opt.p500)
+    {
+        *status = 500;
+        return FAULT_STATUS;
+    }
+    if (n < (unsigned long)opt.fail_first + (unsigned long)opt.drop_first ||
+        rng_unit(rng) < opt.pdrop)
+        return FAULT_DROP;
+    return FAULT_NONE;
+}
+
+static const char* reason_of(int status)
+{
+    switch (status)
+    {
+        case 429: return "Too Many Requests";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default:  return "Error";
+    }
+}
+
+static int serve_error(int fd, const Request *rq, int status, int ollama)
+{
+    Buf b = { 0 };
+    if (ollama)
+        buf_printf(&b, "{\"error\":\"mock: injected HTTP %d\"}", status);
+    else
+        buf_printf(&b, "{\"error\":{\"message\":\"mock: injected HTTP %d\","
+                   "\"type\":\"mock_error\"}}", status);
+    const char *extra = (status == 429 || status == 503) ? "Retry-After: 1\r\n" : NULL;
+    int rc = respond_json(fd, status, reason_of(status), extra, &b, rq->keep_alive);
+    free(b.p);
+    return rc;
+}
+
+/* One streamed event: an Ollama JSON line or an OpenAI SSE event */
+static void event_token(Buf *b, int ollama, const char *model, const char *tok)
+{
+    b->n = 0;
+    if (ollama)
+    {
+        buf_str(b, "{\"model\":\"");
+        buf_json(b, model, strlen(model));
+        buf_str(b, "\",\"created_at\":\"2025-01-01T00:00:00Z\","
+                   "\"message\":{\"role\":\"assistant\",\"content\":\"");
+        buf_json(b, tok, strlen(tok));
+        buf_str(b, "\"},\"done\":false}\n");
+    }
+    else
+    {
+        buf_str(b, "data: {\"id\":\"chatcmpl-mock\",\"object\":\"chat.completion.chunk\","
+                   "\"model\":\"");
+        buf_json(b, model, strlen(model));
+        buf_str(b, "\",\"choices\":[{\"index\":0,\"delta\":{\"content\":\"");
+        buf_json(b, tok, strlen(tok));
+        buf_str(b, "\"},\"finish_reason\":null}]}\n\n");
+    }
+}
+
+static void event_end(Buf *b, int ollama, const char *model, int n)
+{
+    b->n = 0;
+    if (ollama)
+    {
+        buf_str(b, "{\"model\":\"");
+        buf_json(b, model, strlen(model));
+        buf_printf(b, "\",\"created_at\":\"2025-01-01T00:00:00Z\","
+                   "\"message\":{\"role\":\"assistant\",\"content\":\"\"},"
+                   "\"done_reason\":\"stop\",\"done\":true,\"eval_count\":%d}\n", n);
+    }
+    else
+    {
+        buf_str(b, "data: {\"id\":\"chatcmpl-mock\",\"object\":\"chat.completion.chunk\","
+                   "\"choices\":[{\"index\":0,\"delta\":{},\"finish_reason\":\"stop\"}],");
+        buf_printf(b, "\"usage\":{\"completion_tokens\":%d}}\n\ndata: [DONE]\n\n", n);
+    }
+}
+
+/* -1: connection must be closed */
+static int serve_chat(int fd, const Request *rq, int ollama)
+{
+    unsigned long n = __atomic_fetch_add(&chat_count, 1, __ATOMIC_SEQ_CST);
+    uint64_t rng = opt.seed ^ (n * 0x2545F4914F6CDD1DULL);
+    int status = 0;
+    Fault fault = pick_fault(n, &rng, &status);
+
+    if (fault == FAULT_STATUS)
+        return serve_error(fd, rq, status, ollama);
+
+    char *model = json_string(rq->body, "model");
+    if (!model)
+        model = strdup("mock");
+    int streaming = json_stream_flag(rq->body, ollama);
+    Tokens t;
+    tokens_make(&t, rq, &rng);
+    int cut = fault == FAULT_DROP
+              ? (opt.drop_after >= 0 ? opt.drop_after : t.n / 2) : -1;
+    int rc = 0;
+    Buf b = { 0 };
+
+    if (opt.verbose)
+        fprintf(stderr, "#%lu %s %s %d tokens%s\n", n, rq->path,
+                streaming ? "stream" : "whole", t.n, cut >= 0 ? ", cut" : "");
+
+    if (streaming)
+    {
+        rc = start_chunked(fd, ollama ? "application/x-ndjson" : "text/event-stream",
+                           rq->keep_alive);
+        for (int i = 0; rc == 0 && i < t.n; i++)
+        {
+            if (i == cut)
+            {
+                rc = -1;   /* Mid-stream drop: no terminating chunk */
+                break;
+            }
+            pace(&rng);
+            event_token(&b, ollama, model, t.tok[i]);
+            rc = send_chunk(fd, b.p, b.n);
+        }
+        if (rc == 0)
+        {
+            event_end(&b, ollama, model, t.n);
+            rc = send_chunk(fd, b.p, b.n);
+        }
+        if (rc == 0)
+            rc = end_chunked(fd);
+    }
+    else
+    {
+        Buf text = { 0 };
+        for (int i = 0; i < t.n; i++)
+        {
+            pace(&rng);
+            buf_str(&text, t.tok[i]);
+        }
+        if (ollama)
+        {
+            buf_str(&b, "{\"model\":\"");
+            buf_json(&b, model, strlen(model));
+            buf_str(&b, "\",\"message\":{\"role\":\"assistant\",\"content\":\"");
+            buf_json(&b, text.p ? text.p : "", text.n);
+            buf_printf(&b, "\"},\"done_reason\":\"stop\",\"done\":true,\"eval_count\":%d}", t.n);
+        }
+        else
+        {
+            buf_str(&b, "{\"id\":\"chatcmpl-mock\",\"object\":\"chat.completion\",\"model\":\"");
+            buf_json(&b, model, strlen(model));
+            buf_str(&b, "\",\"choices\":[{\"index\":0,\"message\":{\"role\":\"assistant\",\"content\":\"");
+            buf_json(&b, text.p ? text.p : "", text.n);
+            buf_printf(&b, "\"},\"finish_reason\":\"stop\"}],\"usage\":{\"completion_tokens\":%d}}", t.n);
+        }
+        if (cut >= 0)
+        {
+            /* Headers and half the body, then the connection goes away */
+            Buf head = { 0 };
+            buf_printf(&head, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %zu\r\n\r\n", b.n);
+            write_all(fd, head.p, head.n);
+            send_split(fd, b.p, b.n / 2);
+            free(head.p);
+            rc = -1;
+        }
+        else
+        {
+            Buf head = { 0 };
+            buf_printf(&head, "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n"
+                       "Content-Length: %zu\r\n%s\r\n\r\n", b.n,
+                       rq->keep_alive ? "Connection: keep-alive" : "Connection: close");
+            rc = write_all(fd, head.p, head.n);
+            if (rc == 0)
+                rc = send_split(fd, b.p, b.n);
+            free(head.p);
+        }
+        free(text.p);
+    }
+
+    free(b.p);
+    free(model);
+    tokens_free(&t);
+    return rc;
+}
+
+/* --- Dispatch ------------------------------------------------------------ */
+
+static int serve(int fd, const Request *rq)
+{
+    const char *p = rq->path;
+    int get = strcmp(rq->method, "GET") == 0;
+    int post = strcmp(rq->method, "POST") == 0;
+
+    if (strcmp(rq->method, "HEAD") == 0 || (get && strcmp(p, "/") == 0))
+        return respond(fd, 200, "OK", "text/plain", NULL,
+                       get ? "Ollama is running" : NULL, get ? 17 : 0, rq->keep_alive);
+
+    sleep_us((long long)opt.latency_ms * 1000);
+
+    if (get && strcmp(p, "/api/tags") == 0)
+        return serve_catalog(fd, rq, 1);
+    if (get && strcmp(p, "/v1/models") == 0)
+        return serve_catalog(fd, rq, 0);
+    if (post && strcmp(p, "/api/show") == 0)
+        return serve_show(fd, rq);
+    if (post && strcmp(p, "/api/chat") == 0)
+        return serve_chat(fd, rq, 1);
+    if (post && strcmp(p, "/v1/chat/completions") == 0)
+        return serve_chat(fd, rq, 0);
+
+    return respond(fd, 404, "Not Found", "text/plain", NULL, "not found", 9, rq->keep_alive);
+}
+
+static void* conn_thread(void *data)
+{
+    Conn c = { .fd = (int)(intptr_t)data };
+    Request rq;
+
+    while (read_request(&c, &rq) == 0)
+    {
+        int rc = serve(c.fd, &rq);
+        if (opt.verbose > 1)
+            fprintf(stderr, "%s %s (%zu bytes)\n", rq.method, rq.path, rq.body_len);
+        free(rq.body);
+        if (rc < 0 || !rq.keep_alive)
+            break;
+    }
+    close(c.fd);
+    free(c.in);
+    return NULL;
+}
+
+/* --- Main ---------------------------------------------------------------- */
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  --port N          TCP port on 127.0.0.1 (default 11435; 0: any free\n"
+        "                    port, printed on stdout once listening)\n"
+        "  --unix PATH       listen on a Unix socket instead of TCP\n"
+        "  --rate TPS        tokens per second, 0 = unpaced (default 50)\n"
+        "  --tokens N        tokens per reply (default 200)\n"
+        "  --split N         write each event in N-byte pieces (default: whole)\n"
+        "  --latency MS      delay before answering (default 0)\n"
+        "  --jitter MS       random extra delay per token (default 0)\n"
+        "  --p429 P          probability of a 429 with Retry-After: 1\n"
+        "  --p500 P          probability of a 500\n"
+        "  --pdrop P         probability of a mid-stream connection drop\n"
+        "  --fail-first N    first N chat requests fail (see --fail-code)\n"
+        "  --fail-code C     status of --fail-first failures (default 503)\n"
+        "  --drop-first N    the next N chat requests are cut mid-stream\n"
+        "  --drop-after N    tokens sent before a cut (default: half)\n"
+        "  --echo            reply with the request body, in 4-byte tokens\n"
+        "  --models A,B      model names in the catalogs\n"
+        "  --seed N          seed of the per-request random streams (default 1)\n"
+        "  -v, --verbose     log requests (twice: every request)\n", argv0);
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longopts[] = {
+        { "port", required_argument, NULL, 'p' },
+        { "rate", required_argument, NULL, 'r' },
+        { "tokens", required_argument, NULL, 'n' },
+        { "split", required_argument, NULL, 's' },
+        { "latency", required_argument, NULL, 'l' },
+        { "jitter", required_argument, NULL, 'j' },
+        { "p429", required_argument, NULL, 1 },
+        { "p500", required_argument, NULL, 2 },
+        { "pdrop", required_argument, NULL, 3 },
+        { "fail-first", required_argument, NULL, 4 },
+        { "fail-code", required_argument, NULL, 5 },
+        { "drop-first", required_argument, NULL, 6 },
+        { "drop-after", required_argument, NULL, 7 },
+        { "echo", no_argument, NULL, 'e' },
+        { "models", required_argument, NULL, 'm' },
+        { "seed", required_argument, NULL, 8 },
+        { "unix", required_argument, NULL, 9 },
+        { "verbose", no_argument, NULL, 'v' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+    int c;
+
+    while ((c = getopt_long(argc, argv, "p:r:n:s:l:j:em:vh", longopts, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'p': opt.port = atoi(optarg); break;
+            case 'r': opt.rate = atof(optarg); break;
+            case 'n': opt.tokens = atoi(optarg); break;
+            case 's': opt.split = atoi(optarg); break;
+            case 'l': opt.latency_ms = atoi(optarg); break;
+            case 'j': opt.jitter_ms = atoi(optarg); break;
+            case 1:   opt.p429 = atof(optarg); break;
+            case 2:   opt.p500 = atof(optarg); break;
+            case 3:   opt.pdrop = atof(optarg); break;
+            case 4:   opt.fail_first = atoi(optarg); break;
+            case 5:   opt.fail_code = atoi(optarg); break;
+            case 6:   opt.drop_first = atoi(optarg); break;
+            case 7:   opt.drop_after = atoi(optarg); break;
+            case 'e': opt.echo = 1; break;
+            case 'm': opt.models = optarg; break;
+            case 8:   opt.seed = (unsigned)strtoul(optarg, NULL, 10); break;
+            case 9:   opt.unix_path = optarg; break;
+            case 'v': opt.verbose++; break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 2;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    int ls, one = 1, bound;
+    if (opt.unix_path)
+    {
+        struct sockaddr_un un;
+        memset(&un, 0, sizeof un);
+        un.sun_family = AF_UNIX;
+        if (strlen(opt.unix_path) >= sizeof un.sun_path)
+        {
+            fprintf(stderr, "mock_llm: socket path too long\n");
+            return 2;
+        }
+        strcpy(un.sun_path, opt.unix_path);
+        unlink(opt.unix_path);   /* Left over from a previous run */
+        ls = socket(AF_UNIX, SOCK_STREAM, 0);
+        bound = ls >= 0 && bind(ls, (struct sockaddr *)&un, sizeof un) == 0;
+    }
+    else
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons((uint16_t)opt.port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ls = socket(AF_INET, SOCK_STREAM, 0);
+        if (ls >= 0)
+            setsockopt(ls, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        bound = ls >= 0 && bind(ls, (struct sockaddr *)&addr, sizeof addr) == 0;
+    }
+    if (!bound || listen(ls, 64) < 0)
+    {
+        perror("mock_llm: listen");
+        return 1;
+    }
+    if (!opt.unix_path && opt.port == 0)
+    {
+        /* Tell the caller which port the kernel picked */
+        struct sockaddr_in got;
+        socklen_t len = sizeof got;
+        if (getsockname(ls, (struct sockaddr *)&got, &len) < 0)
+        {
+            perror("mock_llm: getsockname");
+            return 1;
+        }
+        opt.port = ntohs(got.sin_port);
+        printf("%d\n", opt.port);
+        fflush(stdout);
+    }
+    if (opt.unix_path)
+        fprintf(stderr, "mock_llm: unix:%s (%.0f tok/s, %d tokens%s)\n",
+                opt.unix_path, opt.rate, opt.tokens, opt.echo ? ", echo" : "");
+    else
+        fprintf(stderr, "mock_llm: http://127.0.0.1:%d (%.0f tok/s, %d tokens%s)\n",
+                opt.port, opt.rate, opt.tokens, opt.echo ? ", echo" : "");
+
+    for (;;)
+    {
+        int fd = accept(ls, NULL, NULL);
+        if (fd < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            perror("mock_llm: accept");
+            return 1;
+        }
+        if (!opt.unix_path)
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+
+        pthread_t th;
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&th, &attr, conn_thread, (void *)(intptr_t)fd) != 0)
+            close(fd);
+        pthread_attr_destroy(&attr);
+    }
+}